@@ -0,0 +1,35 @@
+#include "common/MappedFile.h"
+
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Speckle {
+
+MappedFile::MappedFile(int fd)
+	: m_data(nullptr), m_size(0)
+{
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		throw std::runtime_error("Unable to get the size of the file to map");
+	}
+	if (st.st_size == 0) {
+		return;
+	}
+	m_size = st.st_size;
+	void * data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		throw std::runtime_error("Unable to map file");
+	}
+	// The file is usually read from start to end, so ask for readahead
+	madvise(data, m_size, MADV_SEQUENTIAL);
+	m_data = static_cast<const uint8_t*>(data);
+}
+
+MappedFile::~MappedFile() {
+	if (m_data) {
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	}
+}
+
+} // namespace
@@ -0,0 +1,51 @@
+#ifndef SPECKLE_MAPPEDFILE_H
+#define SPECKLE_MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Speckle {
+
+/**
+ * A read-only memory mapping of a whole file. The data is paged in from
+ * the page cache on demand, so large files can be used immediately.
+ */
+class MappedFile {
+public:
+	/**
+	 * Map the file open on the given descriptor. The descriptor may be
+	 * closed afterwards. Throw std::runtime_error on failure.
+	 */
+	explicit MappedFile(int fd);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+
+	const uint8_t * getData() const {
+		return m_data;
+	}
+
+	size_t getSize() const {
+		return m_size;
+	}
+
+	/**
+	 * Get a pointer to the given range of the file, or null if it is
+	 * outside the file
+	 */
+	const uint8_t * getRange(uint64_t offset, uint64_t length) const {
+		if (offset > m_size || length > m_size - offset) {
+			return nullptr;
+		}
+		return m_data + offset;
+	}
+
+private:
+	const uint8_t * m_data;
+	size_t m_size;
+};
+
+} // namespace
+
+#endif
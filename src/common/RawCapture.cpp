@@ -0,0 +1,248 @@
+#include "common/RawCapture.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace Speckle {
+
+namespace {
+
+const char MAGIC[8] = {'S', 'P', 'K', 'L', 'R', 'A', 'W', '1'};
+
+// Distinguishes the host byte order from a foreign one
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// The alignment of the frames and the index
+const uint64_t ALIGNMENT = 4096;
+
+enum {
+	FLAG_BAYER = 1
+};
+
+struct Header {
+	char magic[8];
+	uint32_t byteOrderMark;
+	uint32_t headerSize;
+	uint32_t width;
+	uint32_t height;
+	uint32_t samplesPerPixel;
+	uint32_t bitsPerSample;
+	uint32_t flags;
+	uint32_t reserved;
+	uint64_t frameSize;
+	uint64_t frameStride;
+
+	// These are zero until the file is closed
+	uint64_t frameCount;
+	uint64_t indexOffset;
+};
+
+static_assert(sizeof(Header) == 72, "Header must have no padding");
+
+uint64_t alignUp(uint64_t size) {
+	return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+Header makeHeader(const RawCaptureFormat & format, uint64_t frameStride) {
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.byteOrderMark = BYTE_ORDER_MARK;
+	header.headerSize = ALIGNMENT;
+	header.width = format.width;
+	header.height = format.height;
+	header.samplesPerPixel = format.samplesPerPixel;
+	header.bitsPerSample = format.bitsPerSample;
+	header.flags = format.bayer ? FLAG_BAYER : 0;
+	header.frameSize = format.getFrameSize();
+	header.frameStride = frameStride;
+	return header;
+}
+
+} // namespace
+
+RawCaptureWriter::RawCaptureWriter(const std::string & fileName,
+		const RawCaptureFormat & format)
+	: m_file(nullptr),
+	m_format(format),
+	m_frameStride(alignUp(format.getFrameSize())),
+	m_padding(m_frameStride - format.getFrameSize())
+{
+	if (format.width <= 0 || format.height <= 0 || format.samplesPerPixel <= 0
+		|| format.bitsPerSample <= 0 || format.bitsPerSample > 16)
+	{
+		throw std::runtime_error("Invalid raw capture format");
+	}
+	m_file = std::fopen(fileName.c_str(), "wb");
+	if (!m_file) {
+		throw std::runtime_error("Unable to open raw capture file for writing");
+	}
+
+	// The header has no frame count or index until the file is closed
+	Header header = makeHeader(format, m_frameStride);
+	std::vector<uint8_t> block(ALIGNMENT);
+	std::memcpy(&block[0], &header, sizeof(header));
+	write(&block[0], block.size());
+}
+
+RawCaptureWriter::~RawCaptureWriter() {
+	if (m_file) {
+		try {
+			close();
+		} catch (std::runtime_error & e) {
+		}
+	}
+}
+
+void RawCaptureWriter::writeFrame(const void * data, size_t length, uint64_t timestamp) {
+	if (length != m_format.getFrameSize()) {
+		throw std::runtime_error("Invalid frame length");
+	}
+	RawCaptureFrame frame;
+	frame.offset = ALIGNMENT + m_index.size() * m_frameStride;
+	frame.timestamp = timestamp;
+	write(data, length);
+	if (m_padding.size()) {
+		write(&m_padding[0], m_padding.size());
+	}
+	m_index.push_back(frame);
+}
+
+void RawCaptureWriter::close() {
+	if (!m_file) {
+		return;
+	}
+	std::FILE * file = m_file;
+	try {
+		if (m_index.size()) {
+			write(&m_index[0], m_index.size() * sizeof(RawCaptureFrame));
+		}
+
+		Header header = makeHeader(m_format, m_frameStride);
+		header.frameCount = m_index.size();
+		header.indexOffset = ALIGNMENT + m_index.size() * m_frameStride;
+		if (std::fseek(file, 0, SEEK_SET) != 0) {
+			throw std::runtime_error("Error seeking in raw capture file");
+		}
+		write(&header, sizeof(header));
+	} catch (...) {
+		m_file = nullptr;
+		std::fclose(file);
+		throw;
+	}
+	m_file = nullptr;
+	if (std::fclose(file) != 0) {
+		throw std::runtime_error("Error closing raw capture file");
+	}
+}
+
+void RawCaptureWriter::write(const void * data, size_t length) {
+	if (std::fwrite(data, 1, length, m_file) != length) {
+		throw std::runtime_error("Error writing raw capture file");
+	}
+}
+
+RawCaptureReader::RawCaptureReader(const std::string & fileName)
+	: m_headerSize(0), m_frameStride(0), m_frameCount(0), m_index(nullptr)
+{
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Unable to open raw capture file");
+	}
+	try {
+		m_file.reset(new MappedFile(fd));
+	} catch (...) {
+		::close(fd);
+		throw;
+	}
+	::close(fd);
+
+	const uint8_t * headerData = m_file->getRange(0, sizeof(Header));
+	if (!headerData) {
+		throw std::runtime_error("Raw capture file is too short");
+	}
+	Header header;
+	std::memcpy(&header, headerData, sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC))) {
+		throw std::runtime_error("Not a raw capture file");
+	}
+	if (header.byteOrderMark != BYTE_ORDER_MARK) {
+		throw std::runtime_error("Raw capture file has a foreign byte order");
+	}
+
+	m_format.width = header.width;
+	m_format.height = header.height;
+	m_format.samplesPerPixel = header.samplesPerPixel;
+	m_format.bitsPerSample = header.bitsPerSample;
+	m_format.bayer = (header.flags & FLAG_BAYER) != 0;
+	m_headerSize = header.headerSize;
+	m_frameStride = header.frameStride;
+	if (header.frameSize != m_format.getFrameSize()
+		|| m_frameStride < header.frameSize
+		|| m_headerSize < sizeof(Header))
+	{
+		throw std::runtime_error("Invalid raw capture header");
+	}
+
+	if (header.indexOffset) {
+		// The index must be within the file and every frame it points to
+		// must be too. The frame count is checked before finding the
+		// index size, which could otherwise overflow.
+		if (header.indexOffset > m_file->getSize() || header.frameCount
+			> (m_file->getSize() - header.indexOffset) / sizeof(RawCaptureFrame))
+		{
+			throw std::runtime_error("Invalid raw capture index");
+		}
+		const uint8_t * index = m_file->getRange(header.indexOffset,
+			header.frameCount * sizeof(RawCaptureFrame));
+		if (!index || header.indexOffset % alignof(RawCaptureFrame)) {
+			throw std::runtime_error("Invalid raw capture index");
+		}
+		m_index = reinterpret_cast<const RawCaptureFrame*>(index);
+		m_frameCount = header.frameCount;
+		for (size_t i = 0; i < m_frameCount; i++) {
+			if (!m_file->getRange(m_index[i].offset, header.frameSize)) {
+				throw std::runtime_error("Invalid raw capture index");
+			}
+		}
+	} else if (m_file->getSize() > m_headerSize && m_frameStride) {
+		// Not closed: recover the complete frames
+		m_frameCount = (m_file->getSize() - m_headerSize) / m_frameStride;
+	}
+}
+
+bool RawCaptureReader::isRawCapture(const std::string & fileName) {
+	std::FILE * file = std::fopen(fileName.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+	char magic[sizeof(MAGIC)];
+	bool result = std::fread(magic, sizeof(magic), 1, file) == 1
+		&& !std::memcmp(magic, MAGIC, sizeof(MAGIC));
+	std::fclose(file);
+	return result;
+}
+
+const uint8_t * RawCaptureReader::getFrame(size_t index) const {
+	checkIndex(index);
+	if (m_index) {
+		return m_file->getData() + m_index[index].offset;
+	} else {
+		return m_file->getData() + m_headerSize + index * m_frameStride;
+	}
+}
+
+uint64_t RawCaptureReader::getTimestamp(size_t index) const {
+	checkIndex(index);
+	return m_index ? m_index[index].timestamp : 0;
+}
+
+void RawCaptureReader::checkIndex(size_t index) const {
+	if (index >= m_frameCount) {
+		throw std::runtime_error("Raw capture frame index out of range");
+	}
+}
+
+} // namespace
@@ -0,0 +1,173 @@
+#ifndef SPECKLE_RAWCAPTURE_H
+#define SPECKLE_RAWCAPTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/MappedFile.h"
+
+namespace Speckle {
+
+/**
+ * The sample format of the frames in a raw capture
+ */
+struct RawCaptureFormat {
+	RawCaptureFormat()
+		: width(0), height(0), samplesPerPixel(1), bitsPerSample(8), bayer(false)
+	{}
+
+	size_t getFrameSize() const {
+		return (size_t)width * height * samplesPerPixel * bitsPerSample / 8;
+	}
+
+	bool operator==(const RawCaptureFormat & other) const {
+		return width == other.width
+			&& height == other.height
+			&& samplesPerPixel == other.samplesPerPixel
+			&& bitsPerSample == other.bitsPerSample
+			&& bayer == other.bayer;
+	}
+
+	bool operator!=(const RawCaptureFormat & other) const {
+		return !(*this == other);
+	}
+
+	int width;
+	int height;
+	int samplesPerPixel;
+
+	// Samples narrower than 16 bits are packed MSB first, as in Unpack
+	int bitsPerSample;
+
+	// True if the samples are a GRBG Bayer mosaic, as delivered by
+	// libfreenect
+	bool bayer;
+};
+
+/**
+ * An entry in the index of a raw capture
+ */
+struct RawCaptureFrame {
+	// The file offset of the frame data
+	uint64_t offset;
+
+	// The device timestamp of the frame
+	uint64_t timestamp;
+};
+
+/**
+ * Write a raw capture file. This is an append-only container for frames
+ * of a fixed format, designed for recording at full frame rate and for
+ * reading through a memory mapping.
+ *
+ * The file starts with a header padded to 4096 bytes. The frames follow,
+ * each padded to a multiple of 4096 bytes so that frame N is at a fixed
+ * offset and is page aligned. When the file is
+ * closed, an index of frame offsets and timestamps is appended, and its
+ * location written to the header. A capture which was not closed can still
+ * be read, without timestamps.
+ *
+ * Integers are stored in the byte order of the host.
+ */
+class RawCaptureWriter {
+public:
+	/**
+	 * Create the file. Throw std::runtime_error on failure.
+	 */
+	RawCaptureWriter(const std::string & fileName, const RawCaptureFormat & format);
+
+	/**
+	 * Close the file if close() was not called. Errors are ignored.
+	 */
+	~RawCaptureWriter();
+
+	RawCaptureWriter(const RawCaptureWriter &) = delete;
+	RawCaptureWriter & operator=(const RawCaptureWriter &) = delete;
+
+	/**
+	 * Append a frame of format.getFrameSize() bytes
+	 */
+	void writeFrame(const void * data, size_t length, uint64_t timestamp);
+
+	/**
+	 * Write the index and the final header, and close the file
+	 */
+	void close();
+
+	size_t getFrameCount() const {
+		return m_index.size();
+	}
+
+private:
+	void write(const void * data, size_t length);
+
+	std::FILE * m_file;
+	RawCaptureFormat m_format;
+	uint64_t m_frameStride;
+	std::vector<RawCaptureFrame> m_index;
+	std::vector<uint8_t> m_padding;
+};
+
+/**
+ * Read a raw capture file written by RawCaptureWriter. The file is mapped,
+ * and frames are returned as pointers into the mapping, so seeking to any
+ * frame takes constant time and no data is copied.
+ */
+class RawCaptureReader {
+public:
+	/**
+	 * Open and map the file. Throw std::runtime_error if it can't be opened
+	 * or is not a valid raw capture.
+	 */
+	explicit RawCaptureReader(const std::string & fileName);
+
+	/**
+	 * Determine whether the given file starts with the raw capture magic
+	 * number
+	 */
+	static bool isRawCapture(const std::string & fileName);
+
+	const RawCaptureFormat & getFormat() const {
+		return m_format;
+	}
+
+	size_t getFrameCount() const {
+		return m_frameCount;
+	}
+
+	/**
+	 * Get a pointer to the data of the given frame, which is
+	 * getFormat().getFrameSize() bytes long
+	 */
+	const uint8_t * getFrame(size_t index) const;
+
+	/**
+	 * Get the device timestamp of the given frame, or 0 if the capture was
+	 * not closed and so has no index
+	 */
+	uint64_t getTimestamp(size_t index) const;
+
+	/**
+	 * Determine whether the capture was closed properly and has an index
+	 */
+	bool hasIndex() const {
+		return m_index != nullptr;
+	}
+
+private:
+	void checkIndex(size_t index) const;
+
+	std::unique_ptr<MappedFile> m_file;
+	RawCaptureFormat m_format;
+	uint64_t m_headerSize;
+	uint64_t m_frameStride;
+	size_t m_frameCount;
+	const RawCaptureFrame * m_index;
+};
+
+} // namespace
+
+#endif
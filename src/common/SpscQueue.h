@@ -0,0 +1,85 @@
+#ifndef SPECKLE_SPSCQUEUE_H
+#define SPECKLE_SPSCQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace Speckle {
+
+/**
+ * A bounded lock-free queue with a single producer thread and a single
+ * consumer thread.
+ */
+template <class T>
+class SpscQueue {
+public:
+	explicit SpscQueue(size_t capacity)
+		: m_items(capacity), m_head(0), m_tail(0)
+	{}
+
+	/**
+	 * Add an item to the queue. Return false if the queue is full. Only
+	 * call this from the producer thread.
+	 */
+	bool tryPush(const T & item) {
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) >= m_items.size()) {
+			return false;
+		}
+		m_items[tail % m_items.size()] = item;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Remove an item from the queue. Return false if the queue is empty.
+	 * Only call this from the consumer thread.
+	 */
+	bool tryPop(T & item) {
+		size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = m_items[head % m_items.size()];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Get the number of items in the queue. This may be called from any
+	 * thread, but the answer may be out of date by the time it is used.
+	 */
+	size_t size() const {
+		size_t head = m_head.load(std::memory_order_acquire);
+		size_t tail = m_tail.load(std::memory_order_acquire);
+		return tail >= head ? tail - head : 0;
+	}
+
+private:
+	std::vector<T> m_items;
+
+	// Keep the producer and consumer counters in separate cache lines
+	std::atomic<size_t> m_head;
+	char m_padding[64];
+	std::atomic<size_t> m_tail;
+};
+
+/**
+ * Wait for the thread at the other end of a queue to make progress, without
+ * using much CPU if it takes a while. The caller should reset idleCount to
+ * zero after it makes progress.
+ */
+inline void backoff(int & idleCount) {
+	if (idleCount++ < 64) {
+		std::this_thread::yield();
+	} else {
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+}
+
+} // namespace
+
+#endif
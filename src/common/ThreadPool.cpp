@@ -0,0 +1,93 @@
+#include "common/ThreadPool.h"
+
+namespace Speckle {
+
+ThreadPool::ThreadPool(int numWorkers)
+	: m_task(nullptr),
+	m_count(0),
+	m_next(0),
+	m_running(0),
+	m_generation(0),
+	m_stopping(false)
+{
+	for (int i = 0; i < numWorkers; i++) {
+		m_workers.emplace_back([this] {
+			workerMain();
+		});
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_startCond.notify_all();
+	for (auto & worker : m_workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::run(int count, const std::function<void(int)> & task) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_task = &task;
+	m_count = count;
+	m_next = 0;
+	m_exception = nullptr;
+	m_generation++;
+	m_startCond.notify_all();
+
+	doTasks(lock);
+	m_doneCond.wait(lock, [this] {
+		return m_next >= m_count && m_running == 0;
+	});
+	m_task = nullptr;
+
+	if (m_exception) {
+		std::rethrow_exception(m_exception);
+	}
+}
+
+void ThreadPool::workerMain() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	unsigned int generation = m_generation;
+	while (true) {
+		m_startCond.wait(lock, [&] {
+			return m_stopping || m_generation != generation;
+		});
+		if (m_stopping) {
+			return;
+		}
+		generation = m_generation;
+		doTasks(lock);
+	}
+}
+
+/**
+ * Claim and run tasks until there are none left. The lock is held on entry
+ * and exit, but released while the task runs.
+ */
+void ThreadPool::doTasks(std::unique_lock<std::mutex> & lock) {
+	while (m_task && m_next < m_count) {
+		int index = m_next++;
+		const std::function<void(int)> & task = *m_task;
+		m_running++;
+		lock.unlock();
+		try {
+			task(index);
+		} catch (...) {
+			lock.lock();
+			if (!m_exception) {
+				m_exception = std::current_exception();
+			}
+			lock.unlock();
+		}
+		lock.lock();
+		m_running--;
+	}
+	if (m_running == 0) {
+		m_doneCond.notify_all();
+	}
+}
+
+} // namespace
@@ -0,0 +1,55 @@
+#ifndef SPECKLE_THREADPOOL_H
+#define SPECKLE_THREADPOOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Speckle {
+
+/**
+ * A persistent pool of worker threads for running a batch of indexed tasks
+ * in parallel.
+ */
+class ThreadPool {
+public:
+	/**
+	 * Start a pool with the given number of worker threads. The thread which
+	 * calls run() also does work, so the concurrency is one more than this.
+	 */
+	explicit ThreadPool(int numWorkers);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool & operator=(const ThreadPool &) = delete;
+
+	/**
+	 * Call task(i) for each i in [0, count) and wait for all calls to
+	 * finish. If a task throws, the first exception is rethrown here.
+	 */
+	void run(int count, const std::function<void(int)> & task);
+
+private:
+	void workerMain();
+	void doTasks(std::unique_lock<std::mutex> & lock);
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_startCond;
+	std::condition_variable m_doneCond;
+
+	const std::function<void(int)> * m_task;
+	int m_count;
+	int m_next;
+	int m_running;
+	unsigned int m_generation;
+	bool m_stopping;
+	std::exception_ptr m_exception;
+};
+
+} // namespace
+
+#endif
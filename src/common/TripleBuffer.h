@@ -0,0 +1,78 @@
+#ifndef SPECKLE_TRIPLEBUFFER_H
+#define SPECKLE_TRIPLEBUFFER_H
+
+#include <atomic>
+
+namespace Speckle {
+
+/**
+ * A lock-free triple buffer, for passing the latest value from a single
+ * producer thread to a single consumer thread. The producer never waits:
+ * if the consumer has not picked up the previous value, it is replaced.
+ */
+template <class T>
+class TripleBuffer {
+public:
+	TripleBuffer()
+		: m_write(0), m_pending(1), m_read(2)
+	{}
+
+	/**
+	 * Get the buffer which the producer may fill. Only call this from the
+	 * producer thread.
+	 */
+	T & getWriteBuffer() {
+		return m_buffers[m_write];
+	}
+
+	/**
+	 * Make the write buffer available to the consumer, and get a new write
+	 * buffer. Return false if a value which the consumer had not yet seen
+	 * was discarded. Only call this from the producer thread.
+	 */
+	bool publish() {
+		int previous = m_pending.exchange(m_write | FRESH, std::memory_order_acq_rel);
+		m_write = previous & INDEX_MASK;
+		return !(previous & FRESH);
+	}
+
+	/**
+	 * If a new value has been published, swap it into the read buffer and
+	 * return true. Only call this from the consumer thread.
+	 */
+	bool update() {
+		if (!(m_pending.load(std::memory_order_relaxed) & FRESH)) {
+			return false;
+		}
+		m_read = m_pending.exchange(m_read, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+	/**
+	 * Get the value most recently received by update(). Only call this from
+	 * the consumer thread.
+	 */
+	T & getReadBuffer() {
+		return m_buffers[m_read];
+	}
+
+private:
+	enum {
+		INDEX_MASK = 3,
+		FRESH = 4
+	};
+
+	T m_buffers[3];
+
+	// Keep the producer's index, the shared index and the consumer's index
+	// in separate cache lines
+	int m_write;
+	char m_padding1[64];
+	std::atomic<int> m_pending;
+	char m_padding2[64];
+	int m_read;
+};
+
+} // namespace
+
+#endif
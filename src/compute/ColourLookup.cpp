@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+#include "compute/ColourLookup.h"
+#include "compute/ColourMap.h"
+
+namespace Speckle {
+
+// The buckets cover bucketOctaves powers of two below the end of the last
+// branch of the solver, with 2^bucketBits buckets in each
+static const int bucketOctaves = 26;
+static const int bucketBits = 8;
+static const int bucketShift = 52 - bucketBits;
+
+static uint64_t getBits(double value) {
+	uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+/**
+ * Find the smallest double in [lo, hi) for which pred is true, given that
+ * pred is false and then true over that interval. If there is none,
+ * return hi.
+ */
+static double findFirst(double lo, double hi, const std::function<bool(double)> & pred) {
+	if (pred(lo)) {
+		return lo;
+	}
+	double last = std::nextafter(hi, lo);
+	if (!pred(last)) {
+		return hi;
+	}
+	hi = last;
+	while (true) {
+		double mid = lo + (hi - lo) / 2;
+		if (mid <= lo || mid >= hi) {
+			return hi;
+		}
+		if (pred(mid)) {
+			hi = mid;
+		} else {
+			lo = mid;
+		}
+	}
+}
+
+ColourLookup::ColourLookup(const CorrelationTime & correlationTime,
+	const Visualize & visualize)
+{
+	// Solve as the pipeline does, so that the colours are the same as
+	// those of its solve-then-visualize path
+	auto solve = [&](double kSq) {
+		double x;
+		correlationTime.computeRow(&kSq, &x, 1);
+		return x;
+	};
+	auto getIndex = [&](double kSq) {
+		return visualize.getColourIndex(solve(kSq));
+	};
+
+	// Below this correlation time, the colour index is at least 2, unless
+	// it wraps around to 0 because 1/x overflows, or x is negative
+	const double smallX = 128 * visualize.getMinX();
+
+	// Within each branch of the solver, the correlation time is
+	// non-increasing, so the colour index is non-decreasing, until it wraps
+	// to 0 when the correlation time is close to zero or negative.
+	const int lastBranch = correlationTime.getTableSize();
+	const double lastStart = findFirst(0, std::numeric_limits<double>::max(), [&](double kSq) {
+		return correlationTime.getBranch(kSq) == lastBranch;
+	});
+	double start = 0;
+	while (true) {
+		const int branch = correlationTime.getBranch(start);
+		if (branch == lastBranch) {
+			// The solution is constant from here on
+			addSegment(start, getIndex(start));
+			break;
+		}
+		double end = findFirst(start, lastStart, [&](double kSq) {
+			return correlationTime.getBranch(kSq) > branch;
+		});
+		double wrap = findFirst(start, end, [&](double kSq) {
+			return solve(kSq) < smallX && getIndex(kSq) == 0;
+		});
+
+		double kSq = start;
+		int index = getIndex(kSq);
+		addSegment(kSq, index);
+		while (true) {
+			kSq = findFirst(kSq, wrap, [&](double kSq) {
+				return getIndex(kSq) > index;
+			});
+			if (kSq >= wrap) {
+				break;
+			}
+			index = getIndex(kSq);
+			addSegment(kSq, index);
+		}
+		if (wrap < end) {
+			addSegment(wrap, 0);
+		}
+		start = end;
+	}
+
+	if (m_indexes.size() > std::numeric_limits<uint16_t>::max()) {
+		throw std::runtime_error("Too many colour lookup segments");
+	}
+	m_starts.push_back(std::numeric_limits<double>::infinity());
+
+	m_minKSq = std::ldexp(1.0, std::ilogb(lastStart) + 1 - bucketOctaves);
+	m_minBits = getBits(m_minKSq);
+	m_buckets.resize(bucketOctaves << bucketBits);
+	size_t segment = 0;
+	for (size_t i = 1; i < m_buckets.size(); i++) {
+		double bucketStart;
+		uint64_t bits = m_minBits + ((uint64_t)i << bucketShift);
+		std::memcpy(&bucketStart, &bits, sizeof(bits));
+		while (m_starts[segment + 1] <= bucketStart) {
+			segment++;
+		}
+		m_buckets[i] = segment;
+	}
+
+	for (size_t i = 0; i < m_indexes.size(); i++) {
+		const uint8_t * rgb = ColourMap::plasma[m_indexes[i]];
+		m_colours3.push_back(cv::Vec3b(rgb[2], rgb[1], rgb[0]));
+		m_colours4.push_back(cv::Vec4b(rgb[2], rgb[1], rgb[0], 0xff));
+	}
+}
+
+void ColourLookup::addSegment(double start, int index) {
+	if (!m_indexes.empty() && m_indexes.back() == index) {
+		return;
+	}
+	m_starts.push_back(start);
+	m_indexes.push_back(index);
+}
+
+/**
+ * Find the last segment which starts at or before kSq. K² is not negative,
+ * but if it were, the first segment would be used.
+ */
+inline int ColourLookup::findSegment(double kSq) const {
+	size_t bucket = 0;
+	if (kSq >= m_minKSq) {
+		bucket = std::min((getBits(kSq) - m_minBits) >> bucketShift,
+			(uint64_t)m_buckets.size() - 1);
+	}
+	int segment = m_buckets[bucket];
+	while (m_starts[segment + 1] <= kSq) {
+		segment++;
+	}
+	return segment;
+}
+
+void ColourLookup::computeRow(const double * kSq, cv::Vec3b * output, int count) const {
+	for (int i = 0; i < count; i++) {
+		output[i] = m_colours3[findSegment(kSq[i])];
+	}
+}
+
+void ColourLookup::computeRow(const double * kSq, cv::Vec4b * output, int count) const {
+	for (int i = 0; i < count; i++) {
+		output[i] = m_colours4[findSegment(kSq[i])];
+	}
+}
+
+} // namespace
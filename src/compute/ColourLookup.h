@@ -0,0 +1,69 @@
+#ifndef SPECKLE_COLOURLOOKUP_H
+#define SPECKLE_COLOURLOOKUP_H
+
+#include <cstdint>
+#include <vector>
+
+#include "common/OpenCvTypes.h"
+#include "compute/CorrelationTime.h"
+#include "compute/Visualize.h"
+
+namespace Speckle {
+
+/**
+ * Map K² directly to the colour which Visualize gives for its correlation
+ * time, without solving for the correlation time.
+ *
+ * The K² axis is divided into segments of constant colour, with boundaries
+ * found by bisection over the solver, so the result is the same as
+ * CorrelationTime::computeRow() followed by Visualize::computeRow(). Each pixel
+ * is then a lookup in a table of buckets indexed by the exponent and
+ * leading mantissa bits of K², followed by a short scan over the segments
+ * starting in that bucket.
+ *
+ * Construction takes a few milliseconds, so a new lookup can be made
+ * whenever beta or the scale change.
+ */
+class ColourLookup {
+public:
+	ColourLookup(const CorrelationTime & correlationTime, const Visualize & visualize);
+
+	/**
+	 * Colourise count K² values, writing BGR pixels
+	 */
+	void computeRow(const double * kSq, cv::Vec3b * output, int count) const;
+
+	/**
+	 * Colourise count K² values, writing opaque BGRA pixels
+	 */
+	void computeRow(const double * kSq, cv::Vec4b * output, int count) const;
+
+	/**
+	 * Get the number of segments of constant colour
+	 */
+	int getSegmentCount() const {
+		return m_colours3.size();
+	}
+
+private:
+	void addSegment(double start, int index);
+	int findSegment(double kSq) const;
+
+	// The start of each segment, followed by infinity
+	std::vector<double> m_starts;
+	std::vector<int> m_indexes;
+
+	// The first segment which may contain each bucket's K² values. Bucket
+	// 0 is also used for K² below m_minKSq.
+	std::vector<uint16_t> m_buckets;
+	double m_minKSq;
+	uint64_t m_minBits;
+
+	// The colour of each segment
+	std::vector<cv::Vec3b> m_colours3;
+	std::vector<cv::Vec4b> m_colours4;
+};
+
+} // namespace
+
+#endif
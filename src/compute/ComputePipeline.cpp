@@ -1,56 +1,617 @@
 #include "ComputePipeline.h"
 
+#include <algorithm>
+
 namespace Speckle {
 
+ComputePipeline::Band::Band(const Options & options, int startRow, int endRow)
+	: startRow(startRow),
+	endRow(endRow),
+	unpack(options.frameSize, options.bitsPerPixel),
+	inputRow(options.width),
+	kSqRow(options.width),
+	xRow(options.width),
+	kSqSum(0)
+{
+	if (options.contrastMode == SPATIAL_CONTRAST) {
+		if (SpatialWindow::fits(options.bitsPerPixel, options.spatialWindow)) {
+			spatialWindow.reset(new SpatialWindow(options.spatialWindow, options.width));
+		} else {
+			wideSpatialWindow.reset(new WideSpatialWindow(options.spatialWindow,
+				options.width));
+		}
+	} else if (options.contrastMode == SPATIOTEMPORAL_CONTRAST) {
+		spatioTemporalWindow.reset(new SpatioTemporalWindow(options.spatialWindow,
+			options.temporalWindow, options.width));
+	}
+}
+
 ComputePipeline::ComputePipeline(const Options & options)
 	: m_options(options),
-	m_unpack(m_options.frameSize, m_options.bitsPerPixel),
-	m_spatialWindow(m_options.spatialWindow, m_options.width),
 	m_correlationTime(m_options.correlationTableSize, m_options.beta),
-	m_visualize(m_options.minX)
-{}
+	m_visualize(m_options.minX),
+	m_statsEnabled(m_options.stats)
+{
+	if (m_options.bitsPerPixel > 16) {
+		throw std::runtime_error("Too many bits per pixel");
+	}
 
-void ComputePipeline::writeFrame(void *data, size_t length, cv::Mat & output, int format) {
-	if (length != m_options.frameSize) {
-		throw std::runtime_error("Invalid frame length");
+	// From here on, the input is the region of interest
+	const cv::Rect frame(0, 0, m_options.width, m_options.height);
+	m_roi = m_options.roi.empty() ? frame : m_options.roi;
+	if ((m_roi & frame) != m_roi) {
+		throw std::runtime_error("Invalid region of interest");
 	}
-	if (format != CV_8UC3 && format != CV_8UC4) {
-		throw std::runtime_error("Invalid output format");
+	if (!m_options.mask.empty() && (m_options.mask.type() != CV_8UC1
+		|| m_options.mask.size() != frame.size()))
+	{
+		throw std::runtime_error("Invalid mask");
 	}
-	output.create(m_options.height, m_options.width, format);
+	m_inputWidth = m_options.width;
+	m_options.width = m_roi.width;
+	m_options.height = m_roi.height;
 
-	Mat3b * mat3;
-	Mat4b * mat4;
+	switch (m_options.contrastMode) {
+		case SPATIAL_CONTRAST:
+			m_window = m_options.spatialWindow;
+			if (!WideSpatialWindow::fits(m_options.bitsPerPixel, m_window)) {
+				throw std::runtime_error("Spatial window too large");
+			}
+			break;
+		case TEMPORAL_CONTRAST:
+			m_window = 1;
+			m_temporalWindow.reset(new TemporalWindow(m_options.temporalWindow,
+				m_options.width, m_options.height));
+			break;
+		case SPATIOTEMPORAL_CONTRAST:
+			m_window = m_options.spatialWindow;
+			m_temporalWindow.reset(new TemporalWindow(m_options.temporalWindow,
+				m_options.width, m_options.height));
+			break;
+		default:
+			throw std::runtime_error("Invalid contrast mode");
+	}
+	// Same as SpatialWindow::getOutputWidth() and getOffset()
+	m_outputWidth = m_options.width - m_window + 1;
+	m_offset = m_window - 1 - m_window / 2;
 
-	if (format == CV_8UC3) {
-		mat3 = (Mat3b*)&output;
-	} else {
-		mat4 = (Mat4b*)&output;
+	if (m_options.outputStride < 1) {
+		throw std::runtime_error("Invalid output stride");
 	}
+	m_stride = m_options.outputStride;
+	m_strideOffset = (m_offset + m_stride - 1) / m_stride;
+	m_strideFirst = m_strideOffset * m_stride - m_offset;
+	m_strideWidth = std::max(0, m_outputWidth - m_strideFirst + m_stride - 1) / m_stride;
+	m_strideRows = std::max(0,
+		m_options.height - m_window + 1 - m_strideFirst + m_stride - 1) / m_stride;
+	createSpans();
 
-	m_unpack.startFrame(data);
-	m_spatialWindow.startFrame();
+	int threads = m_options.threads;
+	if (threads <= 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
 
-	ComputePos pos;
+	// Divide the output rows between the bands. Output rows are identified
+	// here by the first input row of their window.
+	const int window = m_window;
+	const int outputRows = m_options.height - window + 1;
+	const int numBands = std::max(1, std::min(threads, outputRows));
+	for (int i = 0; i < numBands; i++) {
+		int start = std::max(0, outputRows) * i / numBands;
+		int end = std::max(0, outputRows) * (i + 1) / numBands;
+		m_bands.emplace_back(new Band(m_options, start,
+			std::min(m_options.height, end + window - 1)));
+	}
 
-	for (pos.y = 0; pos.y < m_options.height; pos.y++) {
-		for (pos.x = 0; pos.x < m_options.width; pos.x++) {
-			pos.outX = pos.outY = -1;
-			int luminance = m_unpack.compute(pos);
-			double kSq = m_spatialWindow.compute(pos, luminance);
-			if (pos.outX == -1) {
+	if (numBands > 1) {
+		m_threadPool.reset(new ThreadPool(numBands - 1));
+	}
+
+	switch (m_options.averageMode) {
+		case NO_AVERAGE:
+			break;
+		case EXPONENTIAL_AVERAGE:
+		case BOXCAR_AVERAGE:
+			m_rollingAverage.reset(new RollingAverage(
+				m_options.averageMode == BOXCAR_AVERAGE
+					? RollingAverage::BOXCAR : RollingAverage::EXPONENTIAL,
+				m_options.averageFrames,
+				m_strideWidth,
+				m_strideRows,
+				m_options.averageInverse,
+				m_options.outlierThreshold));
+			// Values outside the mask are never written, so they are zero
+			m_xFrame = cv::Mat::zeros(m_strideRows, m_strideWidth, CV_64FC1);
+			break;
+		default:
+			throw std::runtime_error("Invalid average mode");
+	}
+
+	switch (m_options.outputMode) {
+		case COLOUR_OUTPUT:
+		case CORRELATION_TIME_OUTPUT:
+		case RELATIVE_FLOW_OUTPUT:
+			break;
+		case KSQUARED_OUTPUT:
+			if (m_rollingAverage) {
+				throw std::runtime_error("K² output can't be averaged");
+			}
+			break;
+		default:
+			throw std::runtime_error("Invalid output mode");
+	}
+
+	if (m_options.displayOnly && !m_rollingAverage
+		&& m_options.outputMode == COLOUR_OUTPUT)
+	{
+		m_colourLookup.reset(new ColourLookup(m_correlationTime, m_visualize));
+	}
+	m_kSqOutput = m_colourLookup || m_options.outputMode == KSQUARED_OUTPUT;
+}
+
+/**
+ * Find the runs of output pixels in the mask
+ */
+void ComputePipeline::createSpans() {
+	m_spans.assign(m_strideRows, std::vector<Span>());
+	m_maskedCount = 0;
+	for (int row = 0; row < m_strideRows; row++) {
+		std::vector<Span> & spans = m_spans[row];
+		const uint8_t * mask = m_options.mask.empty() ? nullptr
+			: m_options.mask.ptr<uint8_t>(m_roi.y + (row + m_strideOffset) * m_stride)
+				+ m_roi.x + m_strideOffset * m_stride;
+		for (int i = 0; i < m_strideWidth; i++) {
+			if (mask && !mask[i * m_stride]) {
 				continue;
 			}
-			double x = m_correlationTime.compute(pos, kSq);
-			cv::Vec3b c = m_visualize.compute(pos, x);
-			if (format == CV_8UC3) {
-				mat3->at<cv::Vec3b>(pos.outY, pos.outX) = c;
+			if (spans.size() && spans.back().start + spans.back().count == i) {
+				spans.back().count++;
 			} else {
-				mat4->at<cv::Vec4b>(pos.outY, pos.outX) = cv::Vec4b(
-					c[0], c[1], c[2], 0xff);
+				spans.push_back(Span{i, 1});
 			}
+			m_maskedCount++;
+		}
+	}
+}
+
+void ComputePipeline::checkFrame(size_t length, int format) {
+	if (length != m_options.frameSize) {
+		throw std::runtime_error("Invalid frame length");
+	}
+	checkFormat(format);
+}
+
+void ComputePipeline::checkFormat(int format) const {
+	const bool valid = m_options.outputMode == COLOUR_OUTPUT
+		? format == CV_8UC3 || format == CV_8UC4
+		: format == CV_32FC1;
+	if (!valid) {
+		throw std::runtime_error("Invalid output format");
+	}
+}
+
+void ComputePipeline::writeFrame(const void *data, size_t length, cv::Mat & output, int format) {
+	checkFrame(length, format);
+	output.create(getOutputSize(), format);
+	const bool stats = m_statsEnabled;
+
+	if (m_temporalWindow) {
+		m_temporalWindow->startFrame();
+	}
+
+	if (m_options.contrastMode == SPATIOTEMPORAL_CONTRAST) {
+		// The spatial window of a band reads the temporal sums of rows
+		// which overlap the next band, so all the temporal sums are
+		// updated first. Each band updates the rows up to the start of the
+		// next band.
+		runBands([&](Band & band, int i) {
+			addTemporalRows(band, i + 1 < (int)m_bands.size()
+				? m_bands[i + 1]->startRow : m_options.height, data, stats);
+		});
+	}
+
+	// With averaging, the outlier check needs the mean K² of the whole
+	// frame, so the correlation times are all computed into m_xFrame before
+	// any are averaged
+	runBands([&](Band & band, int) {
+		writeBand(band, data, output, format, stats);
+	});
+
+	if (m_rollingAverage) {
+		double kSqSum = 0;
+		for (size_t i = 0; i < m_bands.size(); i++) {
+			kSqSum += m_bands[i]->kSqSum;
+		}
+		m_rollingAverage->startFrame(m_maskedCount ? kSqSum / m_maskedCount : 0);
+		runBands([&](Band & band, int) {
+			averageBand(band, output, format, stats);
+		});
+	}
+
+	if (stats) {
+		PipelineStats frameStats;
+		frameStats.frames = 1;
+		for (size_t i = 0; i < m_bands.size(); i++) {
+			frameStats.add(m_bands[i]->stats);
+			m_bands[i]->stats.clear();
+		}
+		addStats(frameStats);
+	}
+}
+
+/**
+ * Call a function for each band, in parallel if there is more than one
+ */
+void ComputePipeline::runBands(const std::function<void(Band&, int)> & func) {
+	if (m_threadPool) {
+		m_threadPool->run(m_bands.size(), [&](int i) {
+			func(*m_bands[i], i);
+		});
+	} else {
+		func(*m_bands[0], 0);
+	}
+}
+
+void ComputePipeline::addTemporalRows(Band & band, int endRow, const void * data,
+		bool stats)
+{
+	StageTimer timer(stats);
+	startUnpack(band.unpack, data, band.startRow);
+	for (int y = band.startRow; y < endRow; y++) {
+		unpackRow(band.unpack, data, y, &band.inputRow[0]);
+		timer.lap(band.stats, PipelineStats::UNPACK);
+		m_temporalWindow->addRow(y, &band.inputRow[0]);
+		timer.lap(band.stats, PipelineStats::CONTRAST);
+	}
+}
+
+void ComputePipeline::writeBand(Band & band, const void * data, cv::Mat & output, int format,
+		bool stats)
+{
+	StageTimer timer(stats);
+	// In spatio-temporal mode, the input was already consumed by
+	// addTemporalRows()
+	const bool unpack = !band.spatioTemporalWindow;
+	if (unpack) {
+		startUnpack(band.unpack, data, band.startRow);
+	}
+	startBandFrame(band);
+	band.kSqSum = 0;
+
+	for (int y = band.startRow; y < band.endRow; y++) {
+		if (unpack) {
+			unpackRow(band.unpack, data, y, &band.inputRow[0]);
+			timer.lap(band.stats, PipelineStats::UNPACK);
+		}
+		int outY = contrastRow(band, y, &band.inputRow[0], &band.kSqRow[0]);
+		if (outY < 0 || outY % m_stride) {
+			timer.lap(band.stats, PipelineStats::CONTRAST);
+			continue;
+		}
+		if (m_stride > 1) {
+			decimateRow(&band.kSqRow[0], &band.kSqRow[0]);
+		}
+		timer.lap(band.stats, PipelineStats::CONTRAST);
+		outY /= m_stride;
+		const int row = outY - m_strideOffset;
+		if (stats) {
+			countBranches(&band.kSqRow[0], row, band.stats);
+			timer.skip();
+		}
+		if (m_rollingAverage) {
+			band.kSqSum += sumRow(&band.kSqRow[0], row);
+			solveRow(&band.kSqRow[0], m_xFrame.ptr<double>(row), row);
+			timer.lap(band.stats, PipelineStats::SOLVE);
+		} else if (m_kSqOutput) {
+			colouriseRow(&band.kSqRow[0], output, outY, format);
+			timer.lap(band.stats, PipelineStats::COLOURISE);
+		} else {
+			solveRow(&band.kSqRow[0], &band.xRow[0], row);
+			timer.lap(band.stats, PipelineStats::SOLVE);
+			colouriseRow(&band.xRow[0], output, outY, format);
+			timer.lap(band.stats, PipelineStats::COLOURISE);
+		}
+	}
+}
+
+/**
+ * Average the band's rows of m_xFrame into the rolling average, and
+ * colourise the result
+ */
+void ComputePipeline::averageBand(Band & band, cv::Mat & output, int format, bool stats) {
+	StageTimer timer(stats);
+	// The band's output rows are numbered by the first input row of their
+	// window, so they are offset from the row of their centre pixel
+	for (int y = band.startRow + m_offset; y < band.endRow - m_window + 1 + m_offset; y++) {
+		if (y % m_stride) {
+			continue;
+		}
+		int row = y / m_stride - m_strideOffset;
+		m_rollingAverage->computeRow(row, m_xFrame.ptr<double>(row), &band.xRow[0]);
+		timer.lap(band.stats, PipelineStats::SOLVE);
+		colouriseRow(&band.xRow[0], output, y / m_stride, format);
+		timer.lap(band.stats, PipelineStats::COLOURISE);
+	}
+}
+
+/**
+ * Reset the band's contrast state for a new frame. In the temporal modes,
+ * the temporal window must already have been started.
+ */
+void ComputePipeline::startBandFrame(Band & band) {
+	if (band.spatialWindow) {
+		band.spatialWindow->startFrame();
+	}
+	if (band.wideSpatialWindow) {
+		band.wideSpatialWindow->startFrame();
+	}
+	if (band.spatioTemporalWindow) {
+		band.spatioTemporalWindow->startFrame(m_temporalWindow->getFrameCount());
+	}
+}
+
+/**
+ * Pass input row y through the contrast stage. If an output row is
+ * complete, write its m_outputWidth K² values to kSq and return its index,
+ * otherwise return -1.
+ *
+ * In spatio-temporal mode, the input is not used, instead the temporal sums
+ * of row y must already have been updated.
+ */
+int ComputePipeline::contrastRow(Band & band, int y, const uint16_t * input, double * kSq) {
+	int outY;
+	if (band.spatioTemporalWindow) {
+		outY = band.spatioTemporalWindow->computeRow(
+			m_temporalWindow->getSumRow(y), m_temporalWindow->getSumSqRow(y), kSq);
+	} else if (m_temporalWindow) {
+		m_temporalWindow->computeRow(y, input, kSq);
+		return y;
+	} else if (band.spatialWindow) {
+		outY = band.spatialWindow->computeRow(input, kSq);
+	} else {
+		outY = band.wideSpatialWindow->computeRow(input, kSq);
+	}
+	if (outY < 0) {
+		return -1;
+	}
+	return outY + band.startRow;
+}
+
+/**
+ * Write the output of the masked pixels of a row of m_strideWidth values
+ * to output row outY. The input is K² if m_kSqOutput is set, otherwise the
+ * correlation time.
+ */
+void ComputePipeline::colouriseRow(const double * x, cv::Mat & output, int outY, int format) {
+	for (const Span & span : m_spans[outY - m_strideOffset]) {
+		const int offset = m_strideOffset + span.start;
+		const double * input = x + span.start;
+		if (format == CV_32FC1) {
+			convertRow(input, output.ptr<float>(outY) + offset, span.count);
+		} else if (m_colourLookup && format == CV_8UC3) {
+			m_colourLookup->computeRow(input, output.ptr<cv::Vec3b>(outY) + offset, span.count);
+		} else if (m_colourLookup) {
+			m_colourLookup->computeRow(input, output.ptr<cv::Vec4b>(outY) + offset, span.count);
+		} else if (format == CV_8UC3) {
+			m_visualize.computeRow(input, output.ptr<cv::Vec3b>(outY) + offset, span.count);
+		} else {
+			m_visualize.computeRow(input, output.ptr<cv::Vec4b>(outY) + offset, span.count);
 		}
 	}
 }
 
+/**
+ * Write count values of the output mode, from K² or the correlation time
+ */
+void ComputePipeline::convertRow(const double * input, float * output, int count) const {
+	if (m_options.outputMode == RELATIVE_FLOW_OUTPUT) {
+		for (int i = 0; i < count; i++) {
+			output[i] = (float)(1.0 / input[i]);
+		}
+	} else {
+		for (int i = 0; i < count; i++) {
+			output[i] = (float)input[i];
+		}
+	}
+}
+
+/**
+ * Solve for the correlation times of the masked pixels in a row of K²
+ * values
+ */
+void ComputePipeline::solveRow(const double * kSq, double * x, int row) {
+	for (const Span & span : m_spans[row]) {
+		m_correlationTime.computeRow(kSq + span.start, x + span.start, span.count);
+	}
+}
+
+/**
+ * Get the sum of the masked K² values in a row
+ */
+double ComputePipeline::sumRow(const double * kSq, int row) {
+	double sum = 0;
+	for (const Span & span : m_spans[row]) {
+		for (int i = span.start; i < span.start + span.count; i++) {
+			sum += kSq[i];
+		}
+	}
+	return sum;
+}
+
+/**
+ * Start unpacking a frame at row y of the region of interest
+ */
+void ComputePipeline::startUnpack(Unpack & unpack, const void * data, int y) {
+	unpack.startFrame(data);
+	unpack.skipPixels(((size_t)m_roi.y + y) * m_inputWidth + m_roi.x);
+}
+
+/**
+ * Unpack row y of the region of interest, which must follow the row
+ * previously unpacked, if any
+ */
+void ComputePipeline::unpackRow(Unpack & unpack, const void * data, int y, uint16_t * output) {
+	if (m_roi.width != m_inputWidth) {
+		// Seek past the pixels either side of the region, which is cheaper
+		// than unpacking them
+		startUnpack(unpack, data, y);
+	}
+	unpack.computeRow(output, m_roi.width);
+}
+
+/**
+ * Copy the m_strideWidth shown values of a row of m_outputWidth K² values.
+ * The input and output may be the same.
+ */
+void ComputePipeline::decimateRow(const double * input, double * output) {
+	input += m_strideFirst;
+	for (int x = 0; x < m_strideWidth; x++) {
+		output[x] = input[x * m_stride];
+	}
+}
+
+/**
+ * Count the branches of the correlation time solver used for the masked
+ * pixels of a row of K² values
+ */
+void ComputePipeline::countBranches(const double * kSq, int row,
+		PipelineStats & stats) const
+{
+	for (const Span & span : m_spans[row]) {
+		m_correlationTime.countBranches(kSq + span.start, span.count,
+			stats.asymptoticPixels, stats.zeroPixels, stats.newtonPixels);
+	}
+}
+
+void ComputePipeline::addStats(const PipelineStats & stats) {
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	m_stats.add(stats);
+}
+
+PipelineStats ComputePipeline::getStats() const {
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	return m_stats;
+}
+
+void ComputePipeline::resetStats() {
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	m_stats.clear();
+}
+
+void ComputePipeline::unpackFrame(const void *data, size_t length, cv::Mat & unpacked) {
+	if (length != m_options.frameSize) {
+		throw std::runtime_error("Invalid frame length");
+	}
+	StageTimer timer(m_statsEnabled);
+	Unpack & unpack = m_bands[0]->unpack;
+	unpacked.create(m_options.height, m_options.width, CV_16UC1);
+	startUnpack(unpack, data, 0);
+	for (int y = 0; y < m_options.height; y++) {
+		unpackRow(unpack, data, y, unpacked.ptr<uint16_t>(y));
+	}
+	if (timer.isEnabled()) {
+		PipelineStats stats;
+		timer.lap(stats, PipelineStats::UNPACK);
+		addStats(stats);
+	}
+}
+
+void ComputePipeline::contrastFrame(const cv::Mat & unpacked, cv::Mat & kSq) {
+	StageTimer timer(m_statsEnabled);
+	Band & band = *m_bands[0];
+	kSq.create(getContrastSize(), CV_64FC1);
+	if (m_temporalWindow) {
+		m_temporalWindow->startFrame();
+	}
+	startBandFrame(band);
+	for (int y = 0; y < m_options.height; y++) {
+		// Rows which do not complete a window produce no output, so the
+		// first rows can be written to any row of kSq.
+		int row = std::max(0, y - m_window + 1);
+		if (row >= m_options.height - m_window + 1) {
+			break;
+		}
+		if (band.spatioTemporalWindow) {
+			m_temporalWindow->addRow(y, unpacked.ptr<uint16_t>(y));
+		}
+		if (m_stride == 1) {
+			contrastRow(band, y, unpacked.ptr<uint16_t>(y), kSq.ptr<double>(row));
+			continue;
+		}
+		int outY = contrastRow(band, y, unpacked.ptr<uint16_t>(y), &band.kSqRow[0]);
+		if (outY >= 0) {
+			storeContrastRow(&band.kSqRow[0], outY, kSq);
+		}
+	}
+	if (timer.isEnabled()) {
+		PipelineStats stats;
+		timer.lap(stats, PipelineStats::CONTRAST);
+		addStats(stats);
+	}
+}
+
+void ComputePipeline::storeContrastRow(const double * kSqRow, int outY, cv::Mat & kSq) {
+	if (outY % m_stride == 0) {
+		decimateRow(kSqRow, kSq.ptr<double>(outY / m_stride - m_strideOffset));
+	}
+}
+
+void ComputePipeline::solveFrame(const cv::Mat & kSq, cv::Mat & x) {
+	StageTimer timer(m_statsEnabled);
+	PipelineStats stats;
+	if (timer.isEnabled()) {
+		for (int y = 0; y < kSq.rows; y++) {
+			countBranches(kSq.ptr<double>(y), y, stats);
+		}
+		timer.skip();
+	}
+	if (m_kSqOutput) {
+		// The output is written from K², so share its data
+		x = kSq;
+		if (timer.isEnabled()) {
+			addStats(stats);
+		}
+		return;
+	}
+	x.create(kSq.rows, kSq.cols, CV_64FC1);
+	if (m_rollingAverage) {
+		double kSqSum = 0;
+		for (int y = 0; y < kSq.rows; y++) {
+			kSqSum += sumRow(kSq.ptr<double>(y), y);
+		}
+		m_rollingAverage->startFrame(m_maskedCount ? kSqSum / m_maskedCount : 0);
+		if (m_maskedCount != x.total()) {
+			// The average is of whole rows, so give it defined values
+			// outside the mask
+			x.setTo(0);
+		}
+	}
+	for (int y = 0; y < kSq.rows; y++) {
+		solveRow(kSq.ptr<double>(y), x.ptr<double>(y), y);
+		if (m_rollingAverage) {
+			m_rollingAverage->computeRow(y, x.ptr<double>(y), x.ptr<double>(y));
+		}
+	}
+	if (timer.isEnabled()) {
+		timer.lap(stats, PipelineStats::SOLVE);
+		addStats(stats);
+	}
+}
+
+void ComputePipeline::colouriseFrame(const cv::Mat & x, cv::Mat & output, int format) {
+	checkFrame(m_options.frameSize, format);
+	StageTimer timer(m_statsEnabled);
+	output.create(getOutputSize(), format);
+	for (int y = 0; y < x.rows; y++) {
+		colouriseRow(x.ptr<double>(y), output, y + m_strideOffset, format);
+	}
+	if (timer.isEnabled()) {
+		// A frame is complete when it leaves the last stage
+		PipelineStats stats;
+		stats.frames = 1;
+		timer.lap(stats, PipelineStats::COLOURISE);
+		addStats(stats);
+	}
+}
+
 } //namespace
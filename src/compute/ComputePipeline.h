@@ -1,47 +1,336 @@
 #ifndef SPECKLE_COMPUTEPIPELINE_H
 #define SPECKLE_COMPUTEPIPELINE_H
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "compute/ComputePos.h"
 #include "compute/Unpack.h"
 #include "compute/SpatialWindow.h"
+#include "compute/TemporalWindow.h"
+#include "compute/SpatioTemporalWindow.h"
 #include "compute/CorrelationTime.h"
+#include "compute/ColourLookup.h"
+#include "compute/RollingAverage.h"
 #include "compute/Visualize.h"
+#include "compute/PipelineStats.h"
 #include "common/OpenCvTypes.h"
+#include "common/ThreadPool.h"
 
 namespace Speckle {
 
 class ComputePipeline {
 public:
+	enum ContrastMode {
+		// K² over a spatialWindow × spatialWindow neighbourhood
+		SPATIAL_CONTRAST,
+		// K² of each pixel over the last temporalWindow frames
+		TEMPORAL_CONTRAST,
+		// K² over a spatialWindow × spatialWindow neighbourhood in each of
+		// the last temporalWindow frames
+		SPATIOTEMPORAL_CONTRAST
+	};
+
+	enum AverageMode {
+		// Display each frame's correlation times as they are
+		NO_AVERAGE,
+		// Display a rolling average, see RollingAverage
+		EXPONENTIAL_AVERAGE,
+		BOXCAR_AVERAGE
+	};
+
+	enum OutputMode {
+		// Colours from Visualize, as CV_8UC3 or CV_8UC4
+		COLOUR_OUTPUT,
+		// The other modes write CV_32FC1 values without Visualize. K² is
+		// written without solving for the correlation time.
+		KSQUARED_OUTPUT,
+		// The correlation time x, after any averaging
+		CORRELATION_TIME_OUTPUT,
+		// 1/x, which is proportional to flow, and infinite where x is zero
+		RELATIVE_FLOW_OUTPUT
+	};
+
 	struct Options {
 		Options()
 			: width(0), height(0), bitsPerPixel(0),
+			contrastMode(SPATIAL_CONTRAST),
 			spatialWindow(7),
+			temporalWindow(25),
 			correlationTableSize(1024),
 			beta(1.0),
 			frameSize(0),
-			minX(40)
+			minX(40),
+			averageMode(NO_AVERAGE),
+			averageFrames(10),
+			averageInverse(false),
+			outlierThreshold(0.25),
+			displayOnly(false),
+			outputMode(COLOUR_OUTPUT),
+			outputStride(1),
+			stats(false),
+			threads(1)
 		{}
 			
 		int width;
 		int height;
 		int bitsPerPixel;
+		ContrastMode contrastMode;
 		int spatialWindow;
+		int temporalWindow;
 		int correlationTableSize;
 		double beta;
 		size_t frameSize;
 		double minX;
+
+		// Averaging of correlation times over frames. Frames are rejected
+		// from the average if their mean K² changes by more than
+		// outlierThreshold, relative to the average, or 0 to disable.
+		AverageMode averageMode;
+		int averageFrames;
+		bool averageInverse;
+		double outlierThreshold;
+
+		// Only the colour output is needed, so map K² directly to colours
+		// with ColourLookup instead of solving for the correlation time.
+		// This is ignored when averaging, which needs the correlation time,
+		// and with the other output modes.
+		bool displayOnly;
+
+		// What is written to the output. K² output can't be averaged.
+		OutputMode outputMode;
+
+		// Only solve and colourise every outputStride'th pixel in each
+		// direction, giving an output image which is smaller by that
+		// factor. Output pixel (x, y) shows input pixel
+		// (x * outputStride, y * outputStride). The contrast sums are
+		// still maintained for every pixel.
+		int outputStride;
+
+		// The region of the input frame to process, or an empty rectangle
+		// for the whole frame. The pipeline behaves as if the input were
+		// only this region: the output size and the pixels with a complete
+		// window are those of the region. Rows above and below it are
+		// skipped without being unpacked.
+		cv::Rect roi;
+
+		// An optional CV_8UC1 mask with the size of the input frame. The
+		// correlation time is only solved and coloured for output pixels
+		// whose input pixel is non-zero in the mask. Output pixels outside
+		// it are not written, like those without a complete window.
+		cv::Mat mask;
+
+		// Whether to start with statistics collection enabled, see
+		// setStatsEnabled()
+		bool stats;
+
+		// The number of threads to use, or 0 for one per CPU
+		int threads;
 	};
 
 	ComputePipeline(const Options & options);
 
-	void writeFrame(void *data, size_t length, cv::Mat & output, int format);
+	/**
+	 * Compute a frame into output, which is created with the given format
+	 * if necessary. The format is CV_8UC3 or CV_8UC4 for colour output, and
+	 * CV_32FC1 for the other output modes.
+	 */
+	void writeFrame(const void *data, size_t length, cv::Mat & output, int format);
+
+	/**
+	 * Throw if format is not an output format of the output mode
+	 */
+	void checkFormat(int format) const;
+
+	/**
+	 * Run the stages of writeFrame() separately on whole frames, so that
+	 * consecutive frames can be in different stages at the same time. Each
+	 * stage may be called from a different thread, but a given stage must
+	 * not be called concurrently with itself or with writeFrame(). The
+	 * threads option is ignored.
+	 *
+	 * The unpacked frame is CV_16UC1 with the size of the input. K² and
+	 * the correlation time are CV_64FC1, and only cover the output pixels
+	 * which have a complete window. With displayOnly, solveFrame() passes
+	 * K² through in place of the correlation time, as it does with K²
+	 * output. colouriseFrame() writes the output of writeFrame().
+	 */
+	void unpackFrame(const void *data, size_t length, cv::Mat & unpacked);
+	void contrastFrame(const cv::Mat & unpacked, cv::Mat & kSq);
+	void solveFrame(const cv::Mat & kSq, cv::Mat & x);
+	void colouriseFrame(const cv::Mat & x, cv::Mat & output, int format);
+
+	/**
+	 * Get the size of the K² frame of contrastFrame()
+	 */
+	cv::Size getContrastSize() const {
+		return cv::Size(m_strideWidth, m_strideRows);
+	}
+
+	/**
+	 * Store a row of K² values computed elsewhere, for example by
+	 * MultiSpatialWindow, in a K² frame of getContrastSize() for
+	 * solveFrame(). The row is as written by SpatialWindow::computeRow()
+	 * with this pipeline's window size, for output row outY of the region.
+	 * Rows which are not shown with the output stride are ignored.
+	 */
+	void storeContrastRow(const double * kSqRow, int outY, cv::Mat & kSq);
+
+	/**
+	 * Get the size of the output, which is the input size divided by
+	 * outputStride, rounded up
+	 */
+	cv::Size getOutputSize() const {
+		return cv::Size(
+			(m_options.width + m_stride - 1) / m_stride,
+			(m_options.height + m_stride - 1) / m_stride);
+	}
+
+	/**
+	 * Get the number of frames which were left out of the rolling average
+	 * as outliers. This may be called from any thread.
+	 */
+	int getRejectedFrameCount() const {
+		return m_rollingAverage ? m_rollingAverage->getRejectedCount() : 0;
+	}
+
+	/**
+	 * Enable or disable the collection of statistics. This takes effect
+	 * from the next frame or stage call, and may be called from any
+	 * thread. When disabled, the cost is one flag check per call.
+	 */
+	void setStatsEnabled(bool enabled) {
+		m_statsEnabled = enabled;
+	}
+
+	bool isStatsEnabled() const {
+		return m_statsEnabled;
+	}
+
+	/**
+	 * Get the statistics collected so far. This may be called from any
+	 * thread.
+	 *
+	 * The branch counts cover the K² values of the output pixels. With
+	 * displayOnly, the solver is not run, so they show the branch it would
+	 * have used.
+	 */
+	PipelineStats getStats() const;
+
+	void resetStats();
+
 private:
+	/**
+	 * A run of consecutive output pixels in the mask, as a range of
+	 * indexes into a row of m_strideWidth K² values
+	 */
+	struct Span {
+		int start;
+		int count;
+	};
+
+	/**
+	 * A horizontal band of the frame, with its own stage state and scratch
+	 * rows. Adjacent bands overlap by spatialWindow - 1 input rows, so
+	 * that each output row is computed by exactly one band.
+	 */
+	struct Band {
+		Band(const Options & options, int startRow, int endRow);
+
+		// The input rows [startRow, endRow)
+		int startRow;
+		int endRow;
+
+		Unpack unpack;
+
+		// In spatial mode, one of these is used, depending on whether the
+		// sums fit in 32 bits
+		std::unique_ptr<SpatialWindow> spatialWindow;
+		std::unique_ptr<WideSpatialWindow> wideSpatialWindow;
+		std::unique_ptr<SpatioTemporalWindow> spatioTemporalWindow;
+
+		std::vector<uint16_t> inputRow;
+		std::vector<double> kSqRow;
+		std::vector<double> xRow;
+
+		// The sum of the band's K² values in the current frame
+		double kSqSum;
+
+		// Statistics for the current frame
+		PipelineStats stats;
+	};
+
+	void writeBand(Band & band, const void * data, cv::Mat & output, int format,
+		bool stats);
+	void averageBand(Band & band, cv::Mat & output, int format, bool stats);
+	void runBands(const std::function<void(Band&, int)> & func);
+	void addTemporalRows(Band & band, int endRow, const void * data, bool stats);
+	void countBranches(const double * kSq, int row, PipelineStats & stats) const;
+	void startUnpack(Unpack & unpack, const void * data, int y);
+	void unpackRow(Unpack & unpack, const void * data, int y, uint16_t * output);
+	void solveRow(const double * kSq, double * x, int row);
+	double sumRow(const double * kSq, int row);
+	void convertRow(const double * input, float * output, int count) const;
+	void createSpans();
+	void addStats(const PipelineStats & stats);
+	int contrastRow(Band & band, int y, const uint16_t * input, double * kSq);
+	void colouriseRow(const double * x, cv::Mat & output, int outY, int format);
+	void decimateRow(const double * input, double * output);
+	void startBandFrame(Band & band);
+	void checkFrame(size_t length, int format);
+
 	Options m_options;
 
-	Unpack m_unpack;
-	SpatialWindow m_spatialWindow;
+	// The region of the input which is processed, and the input width. In
+	// m_options, the width and height are those of the region.
+	cv::Rect m_roi;
+	int m_inputWidth;
+
+	// The output pixels in the mask, in each row of K² values, and their
+	// total number
+	std::vector<std::vector<Span>> m_spans;
+	size_t m_maskedCount;
+
+	// The size of the spatial window in pixels, which is 1 for temporal
+	// contrast, and the width and offset of the resulting output
+	int m_window;
+	int m_outputWidth;
+	int m_offset;
+
+	// The output stride. Of the K² values in a row, those from
+	// m_strideFirst onwards at intervals of m_stride are shown. There are
+	// m_strideWidth of them in each row and m_strideRows of them in each
+	// column, starting at output column and row m_strideOffset.
+	int m_stride;
+	int m_strideFirst;
+	int m_strideOffset;
+	int m_strideWidth;
+	int m_strideRows;
+
+	std::unique_ptr<TemporalWindow> m_temporalWindow;
+	std::unique_ptr<RollingAverage> m_rollingAverage;
+
+	// With averaging, the correlation times of the whole frame are
+	// computed before any of them are averaged
+	cv::Mat m_xFrame;
+
 	CorrelationTime m_correlationTime;
 	Visualize m_visualize;
+	std::unique_ptr<ColourLookup> m_colourLookup;
+
+	// Whether the output is written from K², so that the correlation time
+	// is not solved for
+	bool m_kSqOutput;
+
+	std::vector<std::unique_ptr<Band>> m_bands;
+	std::unique_ptr<ThreadPool> m_threadPool;
+
+	std::atomic<bool> m_statsEnabled;
+	mutable std::mutex m_statsMutex;
+	PipelineStats m_stats;
 };
 
 } // namespace
@@ -1,8 +1,15 @@
+#include <algorithm>
 #include <stdexcept>
 #include "compute/CorrelationTime.h"
 
 #include <iostream>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace Speckle {
 
 // The precision of precomputed values in the lookup table
@@ -15,6 +22,7 @@ const double CorrelationTime::asymptoticThreshold = 0.05;
 CorrelationTime::CorrelationTime(int tableSize, double beta)
 	: m_beta(beta),
 	m_step(1.0 / (tableSize - 1)),
+	m_invStep(1.0 / m_step),
 	m_table(tableSize)
 {
 	m_table[0] = 0.0;
@@ -37,23 +45,226 @@ CorrelationTime::CorrelationTime(int tableSize, double beta)
 	}
 }
 
-double CorrelationTime::compute(ComputePos & pos, double kSq) {
-	double x;
+/*
+ * Vectorised expm1(t) for -700 < t <= 0.
+ *
+ * The argument is reduced to t = n·ln(2) + r with |r| <= ln(2)/2, and
+ * expm1(r) is evaluated with its Taylor series to the r¹³ term, which has a
+ * truncation error below 1e-17·|r|. The result is 2ⁿ·expm1(r) + (2ⁿ - 1),
+ * which is exactly expm1(r) when n = 0, so small arguments do not suffer
+ * cancellation. The relative error is within a few ulp, below 1e-15.
+ */
+#if defined(__AVX2__) || defined(__SSE2__)
+static const double expm1Coefficients[] = {
+	1. / 6227020800, 1. / 479001600, 1. / 39916800, 1. / 3628800,
+	1. / 362880, 1. / 40320, 1. / 5040, 1. / 720, 1. / 120, 1. / 24,
+	1. / 6, 1. / 2
+};
+static const double log2e = 1.44269504088896340736e+00;
+static const double ln2Hi = 6.93147180369123816490e-01;
+static const double ln2Lo = 1.90821492927058770002e-10;
+#endif
+
+#if defined(__AVX2__)
+static inline __m256d expm1Vector(__m256d t) {
+	__m128i n = _mm256_cvtpd_epi32(_mm256_mul_pd(t, _mm256_set1_pd(log2e)));
+	__m256d nd = _mm256_cvtepi32_pd(n);
+	__m256d r = _mm256_sub_pd(
+		_mm256_sub_pd(t, _mm256_mul_pd(nd, _mm256_set1_pd(ln2Hi))),
+		_mm256_mul_pd(nd, _mm256_set1_pd(ln2Lo)));
+
+	__m256d p = _mm256_set1_pd(expm1Coefficients[0]);
+	for (size_t i = 1; i < sizeof(expm1Coefficients) / sizeof(double); i++) {
+		p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(expm1Coefficients[i]));
+	}
+	p = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, r), p));
+
+	// 2ⁿ from its exponent bits
+	__m256d scale = _mm256_castsi256_pd(_mm256_slli_epi64(
+		_mm256_cvtepi32_epi64(_mm_add_epi32(n, _mm_set1_epi32(1023))), 52));
+	const __m256d one = _mm256_set1_pd(1.0);
+	return _mm256_add_pd(_mm256_mul_pd(scale, p), _mm256_sub_pd(scale, one));
+}
+#elif defined(__SSE2__)
+static inline __m128d expm1Vector(__m128d t) {
+	__m128i n = _mm_cvtpd_epi32(_mm_mul_pd(t, _mm_set1_pd(log2e)));
+	__m128d nd = _mm_cvtepi32_pd(n);
+	__m128d r = _mm_sub_pd(
+		_mm_sub_pd(t, _mm_mul_pd(nd, _mm_set1_pd(ln2Hi))),
+		_mm_mul_pd(nd, _mm_set1_pd(ln2Lo)));
+
+	__m128d p = _mm_set1_pd(expm1Coefficients[0]);
+	for (size_t i = 1; i < sizeof(expm1Coefficients) / sizeof(double); i++) {
+		p = _mm_add_pd(_mm_mul_pd(p, r), _mm_set1_pd(expm1Coefficients[i]));
+	}
+	p = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, r), p));
+
+	// 2ⁿ from its exponent bits. The biased exponent is positive, so it can
+	// be zero-extended to 64 bits.
+	__m128i biased = _mm_add_epi32(n, _mm_set1_epi32(1023));
+	__m128d scale = _mm_castsi128_pd(_mm_slli_epi64(
+		_mm_unpacklo_epi32(biased, _mm_setzero_si128()), 52));
+	const __m128d one = _mm_set1_pd(1.0);
+	return _mm_add_pd(_mm_mul_pd(scale, p), _mm_sub_pd(scale, one));
+}
+#endif
+
+/*
+ * The vector paths do the same calculation as solve(), with the same
+ * branches and table seeds, except that getKSquared() and
+ * getKSquaredDeriv() share a single vectorised expm1:
+ *
+ *   e = expm1(-2x)
+ *   k²/𝛽 = (e + 2x) / 2x²
+ *   (d/dx) k²/𝛽 = -((e + 2)x + e) / x³
+ *
+ * The results agree with solve() to a relative error below 1e-10. The last
+ * values of a row are padded to a whole vector, so each result depends only
+ * on its own K², wherever it is in the row. ColourLookup relies on this.
+ */
+void CorrelationTime::computeRow(const double * kSq, double * output, int count) const {
+	int i = 0;
+	const float * table = &m_table[0];
+	const int maxIndex = (int)m_table.size() - 1;
+	// Below this, the asymptotic approximation is used
+	const double lowThreshold = std::max(m_step, asymptoticThreshold);
+
+#if defined(__AVX2__)
+	const __m256d invStep = _mm256_set1_pd(m_invStep);
+	const __m256d low = _mm256_set1_pd(lowThreshold);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d two = _mm256_set1_pd(2.0);
+	const __m256d half = _mm256_set1_pd(0.5);
+	const __m256d zero = _mm256_setzero_pd();
+	for (; i < count; i += 4) {
+		const int n = std::min(4, count - i);
+		double tail[4];
+		if (n < 4) {
+			for (int j = 0; j < 4; j++) {
+				tail[j] = kSq[i + std::min(j, n - 1)];
+			}
+		}
+		__m256d k = _mm256_div_pd(_mm256_loadu_pd(n < 4 ? tail : kSq + i),
+			_mm256_set1_pd(m_beta));
+
+		__m128i index = _mm256_cvtpd_epi32(_mm256_mul_pd(k, invStep));
+		index = _mm_min_epi32(_mm_max_epi32(index, _mm_setzero_si128()),
+			_mm_set1_epi32(maxIndex));
+		__m256d x = _mm256_cvtps_pd(_mm_i32gather_ps(table, index, 4));
+
+		// One Newton iteration
+		__m256d x2 = _mm256_mul_pd(x, x);
+		__m256d e = expm1Vector(_mm256_mul_pd(x, _mm256_set1_pd(-2.0)));
+		__m256d f = _mm256_sub_pd(
+			_mm256_div_pd(_mm256_add_pd(e, _mm256_mul_pd(two, x)), _mm256_mul_pd(two, x2)),
+			k);
+		__m256d deriv = _mm256_div_pd(
+			_mm256_add_pd(_mm256_mul_pd(_mm256_add_pd(e, two), x), e),
+			_mm256_mul_pd(x2, x));
+		x = _mm256_add_pd(x, _mm256_div_pd(f, deriv));
+
+		__m256d asymptotic = _mm256_sub_pd(_mm256_div_pd(one, k), half);
+		x = _mm256_blendv_pd(x, asymptotic, _mm256_cmp_pd(k, low, _CMP_LT_OQ));
+		x = _mm256_blendv_pd(x, zero, _mm256_cmp_pd(k, one, _CMP_GE_OQ));
+		if (n < 4) {
+			_mm256_storeu_pd(tail, x);
+			std::copy(tail, tail + n, output + i);
+		} else {
+			_mm256_storeu_pd(output + i, x);
+		}
+	}
+#elif defined(__SSE2__)
+	const __m128d invStep = _mm_set1_pd(m_invStep);
+	const __m128d low = _mm_set1_pd(lowThreshold);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d two = _mm_set1_pd(2.0);
+	const __m128d half = _mm_set1_pd(0.5);
+	for (; i < count; i += 2) {
+		const int n = std::min(2, count - i);
+		double tail[2] = {kSq[i], kSq[i]};
+		__m128d k = _mm_div_pd(_mm_loadu_pd(n < 2 ? tail : kSq + i),
+			_mm_set1_pd(m_beta));
+
+		// SSE2 has no gather, so the table is read one lane at a time
+		int32_t index[4];
+		_mm_storeu_si128((__m128i*)index, _mm_cvtpd_epi32(_mm_mul_pd(k, invStep)));
+		for (int j = 0; j < 2; j++) {
+			index[j] = std::min(std::max(index[j], 0), maxIndex);
+		}
+		__m128d x = _mm_set_pd(table[index[1]], table[index[0]]);
+
+		// One Newton iteration
+		__m128d x2 = _mm_mul_pd(x, x);
+		__m128d e = expm1Vector(_mm_mul_pd(x, _mm_set1_pd(-2.0)));
+		__m128d f = _mm_sub_pd(
+			_mm_div_pd(_mm_add_pd(e, _mm_mul_pd(two, x)), _mm_mul_pd(two, x2)),
+			k);
+		__m128d deriv = _mm_div_pd(
+			_mm_add_pd(_mm_mul_pd(_mm_add_pd(e, two), x), e),
+			_mm_mul_pd(x2, x));
+		x = _mm_add_pd(x, _mm_div_pd(f, deriv));
+
+		__m128d asymptotic = _mm_sub_pd(_mm_div_pd(one, k), half);
+		__m128d isLow = _mm_cmplt_pd(k, low);
+		x = _mm_or_pd(_mm_and_pd(isLow, asymptotic), _mm_andnot_pd(isLow, x));
+		x = _mm_andnot_pd(_mm_cmpge_pd(k, one), x);
+		if (n < 2) {
+			_mm_storeu_pd(tail, x);
+			output[i] = tail[0];
+		} else {
+			_mm_storeu_pd(output + i, x);
+		}
+	}
+#endif
+
+	// Solve the remainder, or every value without vectors
+	for (; i < count; i++) {
+		output[i] = solve(kSq[i]);
+	}
+}
+
+int CorrelationTime::getBranch(double kSq) const {
 	kSq /= m_beta;
 	if (kSq < m_step || kSq < asymptoticThreshold) {
 		// The asymptotic approximation is good when k^2 is small
-		x = 1.0 / kSq - 0.5;
+		return -1;
 	} else if (kSq >= 1.0) {
 		// The solution is 0 at k^2 = 1, and negative for k^2>1, which is unphysical
-		x = 0.;
+		return m_table.size();
+	} else {
+		// Rounded to even, as the vector conversion in computeRow() does
+		return (int)std::nearbyint(kSq * m_invStep);
+	}
+}
+
+void CorrelationTime::countBranches(const double * kSq, int count,
+		uint64_t & asymptotic, uint64_t & zero, uint64_t & newton) const
+{
+	const int zeroBranch = m_table.size();
+	for (int i = 0; i < count; i++) {
+		int branch = getBranch(kSq[i]);
+		if (branch < 0) {
+			asymptotic++;
+		} else if (branch == zeroBranch) {
+			zero++;
+		} else {
+			newton++;
+		}
+	}
+}
+
+double CorrelationTime::solve(double kSq) const {
+	int branch = getBranch(kSq);
+	kSq /= m_beta;
+	if (branch < 0) {
+		return 1.0 / kSq - 0.5;
+	} else if (branch == (int)m_table.size()) {
+		return 0.;
 	} else {
 		// Look up the seed value in the table, then do a single iteration of the
 		// Newton method
-		x = m_table.at(std::round(kSq / m_step));
-		x = doCorrelationIteration(kSq, x);
+		return doCorrelationIteration(kSq, m_table[branch]);
 	}
-
-	return x;
 }
 
 } // namespace
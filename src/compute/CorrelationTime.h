@@ -2,6 +2,7 @@
 #define SPECKLE_CORRELATIONTIME_H
 
 #include <cmath>
+#include <cstdint>
 #include <vector>
 
 #include "compute/ComputePos.h"
@@ -11,11 +12,43 @@ namespace Speckle {
 class CorrelationTime {
 public:
 	CorrelationTime(int tableSize, double beta);
-	double compute(ComputePos & pos, double kSq);
+
+	double compute(ComputePos & pos, double kSq) const {
+		return solve(kSq);
+	}
+
+	/**
+	 * Solve for the correlation time of count K² values. Each result
+	 * depends only on its K², and not on its position in the row.
+	 */
+	void computeRow(const double * kSq, double * output, int count) const;
+
+	/**
+	 * Get the branch of the solution used for kSq: -1 for the asymptotic
+	 * approximation, the table size where the solution is 0, and otherwise
+	 * the index of the table entry used as the Newton seed. The branch is
+	 * non-decreasing in K², and within a branch, the solution is
+	 * non-increasing.
+	 */
+	int getBranch(double kSq) const;
+
+	/**
+	 * Add the number of count K² values which fall into each kind of
+	 * branch to the given counters
+	 */
+	void countBranches(const double * kSq, int count, uint64_t & asymptotic,
+		uint64_t & zero, uint64_t & newton) const;
+
+	int getTableSize() const {
+		return m_table.size();
+	}
 
 private:
+	double solve(double kSq) const;
+
 	double m_beta;
 	double m_step;
+	double m_invStep;
 	std::vector<float> m_table;
 
 	static const double tablePrecision;
@@ -0,0 +1,148 @@
+#include "compute/FramePipeline.h"
+
+#include <cstring>
+
+namespace Speckle {
+
+FramePipeline::FramePipeline(const ComputePipeline::Options & options, int format,
+		int depth, const std::function<void()> & outputCallback)
+	: m_pipeline(getPipelineOptions(options)),
+	m_format(format),
+	m_outputCallback(outputCallback),
+	m_free(depth),
+	m_stopping(false)
+{
+	m_pipeline.checkFormat(format);
+	if (depth < 1) {
+		throw std::runtime_error("Invalid pipeline depth");
+	}
+
+	for (int i = 0; i < depth; i++) {
+		m_slots.emplace_back(new Slot);
+		m_slots.back()->input.resize(options.frameSize);
+		// The pipeline does not write the border of the output or pixels
+		// outside the mask, so clear them
+		m_slots.back()->output = cv::Mat::zeros(m_pipeline.getOutputSize(), format);
+		m_free.tryPush(m_slots.back().get());
+	}
+	for (int i = 0; i <= NUM_STAGES; i++) {
+		m_queues.emplace_back(new Queue(depth));
+	}
+	for (int i = 0; i < NUM_STAGES; i++) {
+		m_threads.emplace_back([this, i] {
+			stageMain(i);
+		});
+	}
+}
+
+FramePipeline::~FramePipeline() {
+	m_stopping = true;
+	for (auto & thread : m_threads) {
+		thread.join();
+	}
+}
+
+ComputePipeline::Options FramePipeline::getPipelineOptions(
+		const ComputePipeline::Options & options)
+{
+	ComputePipeline::Options pipelineOptions = options;
+	pipelineOptions.threads = 1;
+	return pipelineOptions;
+}
+
+bool FramePipeline::push(const void * data, size_t length) {
+	if (length != m_slots[0]->input.size()) {
+		throw std::runtime_error("Invalid frame length");
+	}
+	Slot * slot;
+	if (!m_free.tryPop(slot)) {
+		return false;
+	}
+	std::memcpy(&slot->input[0], data, length);
+	// There is room in every queue for every slot, so this cannot fail
+	m_queues[UNPACK]->tryPush(slot);
+	return true;
+}
+
+bool FramePipeline::pop(cv::Mat & output) {
+	{
+		std::lock_guard<std::mutex> lock(m_exceptionMutex);
+		if (m_exception) {
+			std::rethrow_exception(m_exception);
+		}
+	}
+	Slot * slot;
+	if (!m_queues[NUM_STAGES]->tryPop(slot)) {
+		return false;
+	}
+	// Swap rather than copy, so that the slot reuses the caller's buffer
+	std::swap(output, slot->output);
+	m_free.tryPush(slot);
+	return true;
+}
+
+size_t FramePipeline::getQueueDepth(int stage) const {
+	return m_queues.at(stage)->size();
+}
+
+const char * FramePipeline::getStageName(int stage) {
+	if (stage == NUM_STAGES) {
+		return "output";
+	}
+	return PipelineStats::getStageName(stage);
+}
+
+void FramePipeline::stageMain(int stage) {
+	Queue & input = *m_queues[stage];
+	Queue & output = *m_queues[stage + 1];
+	int idleCount = 0;
+
+	while (!m_stopping) {
+		Slot * slot;
+		if (!input.tryPop(slot)) {
+			backoff(idleCount);
+			continue;
+		}
+		idleCount = 0;
+
+		try {
+			runStage(stage, *slot);
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(m_exceptionMutex);
+			if (!m_exception) {
+				m_exception = std::current_exception();
+			}
+		}
+		output.tryPush(slot);
+
+		if (stage == COLOURISE && m_outputCallback) {
+			m_outputCallback();
+		}
+	}
+}
+
+void FramePipeline::runStage(int stage, Slot & slot) {
+	switch (stage) {
+		case UNPACK:
+			m_pipeline.unpackFrame(&slot.input[0], slot.input.size(), slot.unpacked);
+			break;
+		case CONTRAST:
+			m_pipeline.contrastFrame(slot.unpacked, slot.kSq);
+			break;
+		case SOLVE:
+			m_pipeline.solveFrame(slot.kSq, slot.x);
+			break;
+		case COLOURISE:
+			// pop() may have swapped in a buffer which doesn't fit, such as
+			// an empty one, which is replaced by a cleared buffer
+			if (slot.output.size() != m_pipeline.getOutputSize()
+				|| slot.output.type() != m_format)
+			{
+				slot.output = cv::Mat::zeros(m_pipeline.getOutputSize(), m_format);
+			}
+			m_pipeline.colouriseFrame(slot.x, slot.output, m_format);
+			break;
+	}
+}
+
+} // namespace
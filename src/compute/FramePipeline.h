@@ -0,0 +1,132 @@
+#ifndef SPECKLE_FRAMEPIPELINE_H
+#define SPECKLE_FRAMEPIPELINE_H
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "compute/ComputePipeline.h"
+#include "common/SpscQueue.h"
+
+namespace Speckle {
+
+/**
+ * Run the stages of ComputePipeline on consecutive frames at the same time,
+ * each stage in its own thread. The stages are connected by bounded
+ * lock-free queues, so sustained throughput is limited by the slowest
+ * stage rather than the sum of the stages.
+ *
+ * push() and pop() may be called from different threads, but each must
+ * only be called from one thread.
+ */
+class FramePipeline {
+public:
+	enum Stage {
+		UNPACK = PipelineStats::UNPACK,
+		CONTRAST = PipelineStats::CONTRAST,
+		SOLVE = PipelineStats::SOLVE,
+		COLOURISE = PipelineStats::COLOURISE,
+		NUM_STAGES = PipelineStats::NUM_STAGES
+	};
+
+	/**
+	 * @param options The pipeline options. The threads option is ignored.
+	 * @param format The output format, as for ComputePipeline::writeFrame()
+	 * @param depth The number of frames which can be in the pipeline
+	 * @param outputCallback A function which is called from the last
+	 *   stage's thread when a frame is ready to pop()
+	 */
+	FramePipeline(const ComputePipeline::Options & options, int format,
+		int depth = 4,
+		const std::function<void()> & outputCallback = nullptr);
+	~FramePipeline();
+
+	/**
+	 * Copy a frame into the pipeline. If the pipeline is full, return false
+	 * without doing anything.
+	 */
+	bool push(const void * data, size_t length);
+
+	/**
+	 * Get the next finished frame, if there is one. If a stage failed, its
+	 * exception is rethrown here.
+	 *
+	 * The output is swapped with a buffer of the pipeline, so the buffer
+	 * given here is reused for a later frame. Pixels which the pipeline
+	 * does not write, at the border and outside the mask, keep the previous
+	 * contents of the buffer, which are zero unless the caller changed
+	 * them.
+	 */
+	bool pop(cv::Mat & output);
+
+	/**
+	 * Get the number of frames waiting for the given stage, or with
+	 * NUM_STAGES, the number of finished frames waiting for pop().
+	 */
+	size_t getQueueDepth(int stage) const;
+
+	static const char * getStageName(int stage);
+
+	/**
+	 * Get the number of frames left out of the rolling average as outliers
+	 */
+	int getRejectedFrameCount() const {
+		return m_pipeline.getRejectedFrameCount();
+	}
+
+	/**
+	 * Statistics, see ComputePipeline::setStatsEnabled(). The stage times
+	 * are the time each stage's thread spent working, not waiting.
+	 */
+	void setStatsEnabled(bool enabled) {
+		m_pipeline.setStatsEnabled(enabled);
+	}
+
+	PipelineStats getStats() const {
+		return m_pipeline.getStats();
+	}
+
+	void resetStats() {
+		m_pipeline.resetStats();
+	}
+
+private:
+	struct Slot {
+		std::vector<uint8_t> input;
+		cv::Mat unpacked;
+		cv::Mat kSq;
+		cv::Mat x;
+		cv::Mat output;
+	};
+
+	typedef SpscQueue<Slot*> Queue;
+
+	static ComputePipeline::Options getPipelineOptions(
+		const ComputePipeline::Options & options);
+	void stageMain(int stage);
+	void runStage(int stage, Slot & slot);
+
+	ComputePipeline m_pipeline;
+	const int m_format;
+	std::function<void()> m_outputCallback;
+
+	std::vector<std::unique_ptr<Slot>> m_slots;
+	Queue m_free;
+
+	// The input queue of each stage, followed by the output queue
+	std::vector<std::unique_ptr<Queue>> m_queues;
+
+	std::vector<std::thread> m_threads;
+	std::atomic<bool> m_stopping;
+
+	std::mutex m_exceptionMutex;
+	std::exception_ptr m_exception;
+};
+
+} // namespace
+
+#endif
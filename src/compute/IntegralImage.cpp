@@ -0,0 +1,184 @@
+#include "compute/IntegralImage.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "compute/SpatialWindow.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Speckle {
+
+IntegralImage::IntegralImage(int width, int height)
+	: m_width(width),
+	m_height(height),
+	m_sum((size_t)(width + 1) * (height + 1)),
+	m_sumSq((size_t)(width + 1) * (height + 1)),
+	m_cumSum(width + 1),
+	m_cumSumSq(width + 1)
+{
+	if (width <= 0 || height <= 0) {
+		throw std::runtime_error("Invalid frame size");
+	}
+}
+
+void IntegralImage::compute(const cv::Mat & input) {
+	if (input.type() != CV_16UC1 || input.cols != m_width || input.rows != m_height) {
+		throw std::runtime_error("Invalid input for the integral image");
+	}
+	const size_t stride = m_width + 1;
+	// Row 0 is the sum over no rows, and is never written
+	for (int y = 0; y < m_height; y++) {
+		addRow(input.ptr<uint16_t>(y),
+			&m_sum[y * stride], &m_sumSq[y * stride],
+			&m_sum[(y + 1) * stride], &m_sumSq[(y + 1) * stride],
+			m_width);
+	}
+}
+
+template <typename T>
+void IntegralImage::addRow(const uint16_t * input, const T * prevSum, const T * prevSumSq,
+		T * sum, T * sumSq, int width)
+{
+	// A serial dependency chain along the row
+	T rowSum = 0;
+	T rowSumSq = 0;
+	sum[0] = 0;
+	sumSq[0] = 0;
+	for (int x = 0; x < width; x++) {
+		const T value = input[x];
+		rowSum += value;
+		rowSumSq += value * value;
+		sum[x + 1] = prevSum[x + 1] + rowSum;
+		sumSq[x + 1] = prevSumSq[x + 1] + rowSumSq;
+	}
+}
+
+/**
+ * The 64-bit rows are built a vector at a time. The prefix sum within the
+ * vector is done with shifts, so the serial dependency is only the carry
+ * from one vector to the next.
+ */
+template <>
+void IntegralImage::addRow<uint64_t>(const uint16_t * input,
+		const uint64_t * prevSum, const uint64_t * prevSumSq,
+		uint64_t * sum, uint64_t * sumSq, int width)
+{
+	sum[0] = 0;
+	sumSq[0] = 0;
+	int x = 0;
+
+#if defined(__AVX2__)
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i carry = zero;
+	__m256i carrySq = zero;
+	for (; x + 4 <= width; x += 4) {
+		__m256i value = _mm256_cvtepu16_epi64(
+			_mm_loadl_epi64((const __m128i*)(input + x)));
+		__m256i square = _mm256_mul_epu32(value, value);
+
+		// [a, b, c, d] → [a, a+b, c, c+d] → [a, a+b, a+b+c, a+b+c+d]
+		value = _mm256_add_epi64(value, _mm256_slli_si256(value, 8));
+		square = _mm256_add_epi64(square, _mm256_slli_si256(square, 8));
+		value = _mm256_add_epi64(value, _mm256_blend_epi32(
+			_mm256_permute4x64_epi64(value, _MM_SHUFFLE(1, 1, 0, 0)), zero, 0x0f));
+		square = _mm256_add_epi64(square, _mm256_blend_epi32(
+			_mm256_permute4x64_epi64(square, _MM_SHUFFLE(1, 1, 0, 0)), zero, 0x0f));
+
+		value = _mm256_add_epi64(value, carry);
+		square = _mm256_add_epi64(square, carrySq);
+		carry = _mm256_permute4x64_epi64(value, _MM_SHUFFLE(3, 3, 3, 3));
+		carrySq = _mm256_permute4x64_epi64(square, _MM_SHUFFLE(3, 3, 3, 3));
+
+		_mm256_storeu_si256((__m256i*)(sum + x + 1), _mm256_add_epi64(value,
+			_mm256_loadu_si256((const __m256i*)(prevSum + x + 1))));
+		_mm256_storeu_si256((__m256i*)(sumSq + x + 1), _mm256_add_epi64(square,
+			_mm256_loadu_si256((const __m256i*)(prevSumSq + x + 1))));
+	}
+#elif defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	__m128i carry = zero;
+	__m128i carrySq = zero;
+	for (; x + 2 <= width; x += 2) {
+		uint32_t pair;
+		std::memcpy(&pair, input + x, sizeof(pair));
+		__m128i value = _mm_unpacklo_epi32(
+			_mm_unpacklo_epi16(_mm_cvtsi32_si128(pair), zero), zero);
+		__m128i square = _mm_mul_epu32(value, value);
+
+		// [a, b] → [a, a+b]
+		value = _mm_add_epi64(value, _mm_slli_si128(value, 8));
+		square = _mm_add_epi64(square, _mm_slli_si128(square, 8));
+
+		value = _mm_add_epi64(value, carry);
+		square = _mm_add_epi64(square, carrySq);
+		carry = _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 2, 3, 2));
+		carrySq = _mm_shuffle_epi32(square, _MM_SHUFFLE(3, 2, 3, 2));
+
+		_mm_storeu_si128((__m128i*)(sum + x + 1), _mm_add_epi64(value,
+			_mm_loadu_si128((const __m128i*)(prevSum + x + 1))));
+		_mm_storeu_si128((__m128i*)(sumSq + x + 1), _mm_add_epi64(square,
+			_mm_loadu_si128((const __m128i*)(prevSumSq + x + 1))));
+	}
+#endif
+
+	// The remainder continues from the row sums so far
+	uint64_t rowSum = sum[x] - prevSum[x];
+	uint64_t rowSumSq = sumSq[x] - prevSumSq[x];
+	for (; x < width; x++) {
+		const uint64_t value = input[x];
+		rowSum += value;
+		rowSumSq += value * value;
+		sum[x + 1] = prevSum[x + 1] + rowSum;
+		sumSq[x + 1] = prevSumSq[x + 1] + rowSumSq;
+	}
+}
+
+template void IntegralImage::addRow<uint32_t>(const uint16_t * input,
+	const uint32_t * prevSum, const uint32_t * prevSumSq,
+	uint32_t * sum, uint32_t * sumSq, int width);
+
+double IntegralImage::getKSquared(const cv::Rect & rect) const {
+	const uint64_t sum = getSum(rect);
+	const int64_t area = rect.area();
+	if (sum == 0 || area < 2) {
+		return 0.0;
+	}
+	// The same expression as SpatialWindow, in long double so that the
+	// numerator is exact for large rectangles too
+	const long double s = sum;
+	const long double n = area;
+	return (double)((n * getSumSq(rect) - s * s) / (n - 1) / s / s * n);
+}
+
+double IntegralImage::getKSquared(int x, int y, int window) const {
+	const int offset = window - 1 - window / 2;
+	const cv::Rect rect = cv::Rect(x - offset, y - offset, window, window)
+		& cv::Rect(0, 0, m_width, m_height);
+	return getKSquared(rect);
+}
+
+void IntegralImage::computeRow(int window, int y, double * output) {
+	// The cumulative sums along the row of the column sums over the window
+	// are a difference of two rows of the integral image
+	const size_t stride = m_width + 1;
+	const uint64_t * top = &m_sum[y * stride];
+	const uint64_t * bottom = &m_sum[(y + window) * stride];
+	const uint64_t * topSq = &m_sumSq[y * stride];
+	const uint64_t * bottomSq = &m_sumSq[(y + window) * stride];
+	uint64_t * cumSum = &m_cumSum[0];
+	uint64_t * cumSumSq = &m_cumSumSq[0];
+	for (size_t x = 0; x < stride; x++) {
+		cumSum[x] = bottom[x] - top[x];
+		cumSumSq[x] = bottomSq[x] - topSq[x];
+	}
+	WideSpatialWindow::computeOutput(cumSum, cumSumSq, window,
+		m_width - window + 1, output);
+}
+
+} // namespace
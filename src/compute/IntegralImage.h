@@ -0,0 +1,116 @@
+#ifndef SPECKLE_INTEGRALIMAGE_H
+#define SPECKLE_INTEGRALIMAGE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "common/OpenCvTypes.h"
+
+namespace Speckle {
+
+/**
+ * 64-bit integral images of a frame and of its square, from which the sum,
+ * mean and K² over any rectangle are available in constant time.
+ *
+ * Unlike SpatialWindow, which streams a fixed window size in raster order,
+ * this allows arbitrary queries once the frame is added: region statistics,
+ * windows which shrink at the edges of the frame, and probing at a point.
+ * The cost is memory for two 64-bit values per pixel.
+ */
+class IntegralImage {
+public:
+	IntegralImage(int width, int height);
+
+	/**
+	 * Build the integral images of a CV_16UC1 frame of the given size, in
+	 * one pass
+	 */
+	void compute(const cv::Mat & input);
+
+	/**
+	 * Add a row of input to a pair of integral image rows of width + 1
+	 * elements. Element x of the output is that of the previous row plus
+	 * the sum of the input columns [0, x). Sums wrap modulo the size of T.
+	 */
+	template <typename T>
+	static void addRow(const uint16_t * input, const T * prevSum, const T * prevSumSq,
+		T * sum, T * sumSq, int width);
+
+	/**
+	 * Get the sum of the values in a rectangle, which must lie within the
+	 * frame
+	 */
+	uint64_t getSum(const cv::Rect & rect) const {
+		return getRectangle(m_sum, rect);
+	}
+
+	/**
+	 * Get the sum of the squared values in a rectangle
+	 */
+	uint64_t getSumSq(const cv::Rect & rect) const {
+		return getRectangle(m_sumSq, rect);
+	}
+
+	double getMean(const cv::Rect & rect) const {
+		return rect.area() ? (double)getSum(rect) / rect.area() : 0.0;
+	}
+
+	/**
+	 * Get K² over a rectangle, with the sample variance as in SpatialWindow.
+	 * It is zero if the sum is zero or the rectangle has fewer than two
+	 * pixels.
+	 */
+	double getKSquared(const cv::Rect & rect) const;
+
+	/**
+	 * Get K² over the window × window neighbourhood of pixel (x, y), placed
+	 * as in SpatialWindow. Near the edges, the window is clipped to the
+	 * frame rather than having no result.
+	 */
+	double getKSquared(int x, int y, int window) const;
+
+	/**
+	 * Write K² for the windows whose top row is y, with the same values and
+	 * layout as SpatialWindow::computeRow() writes when row y + window - 1
+	 * completes them. The sums must fit as in WideSpatialWindow::fits().
+	 */
+	void computeRow(int window, int y, double * output);
+
+	int getWidth() const {
+		return m_width;
+	}
+
+	int getHeight() const {
+		return m_height;
+	}
+
+private:
+	uint64_t getRectangle(const std::vector<uint64_t> & sums, const cv::Rect & rect) const {
+		const size_t stride = m_width + 1;
+		const size_t top = (size_t)rect.y * stride;
+		const size_t bottom = (size_t)(rect.y + rect.height) * stride;
+		return sums[bottom + rect.x + rect.width] - sums[bottom + rect.x]
+			- sums[top + rect.x + rect.width] + sums[top + rect.x];
+	}
+
+	const int m_width;
+	const int m_height;
+
+	// The integral images, with height + 1 rows of width + 1. Element
+	// (x, y) is the sum over rows [0, y) and columns [0, x).
+	std::vector<uint64_t> m_sum;
+	std::vector<uint64_t> m_sumSq;
+
+	// Scratch rows for computeRow()
+	std::vector<uint64_t> m_cumSum;
+	std::vector<uint64_t> m_cumSumSq;
+};
+
+template <>
+void IntegralImage::addRow<uint64_t>(const uint16_t * input,
+	const uint64_t * prevSum, const uint64_t * prevSumSq,
+	uint64_t * sum, uint64_t * sumSq, int width);
+
+} // namespace
+
+#endif
@@ -0,0 +1,67 @@
+#include <iomanip>
+#include <sstream>
+
+#include "compute/PipelineStats.h"
+
+namespace Speckle {
+
+void PipelineStats::clear() {
+	frames = 0;
+	for (int i = 0; i < NUM_STAGES; i++) {
+		nanoseconds[i] = 0;
+	}
+	asymptoticPixels = 0;
+	zeroPixels = 0;
+	newtonPixels = 0;
+}
+
+void PipelineStats::add(const PipelineStats & other) {
+	frames += other.frames;
+	for (int i = 0; i < NUM_STAGES; i++) {
+		nanoseconds[i] += other.nanoseconds[i];
+	}
+	asymptoticPixels += other.asymptoticPixels;
+	zeroPixels += other.zeroPixels;
+	newtonPixels += other.newtonPixels;
+}
+
+const char * PipelineStats::getStageName(int stage) {
+	switch (stage) {
+		case UNPACK:
+			return "unpack";
+		case CONTRAST:
+			return "contrast";
+		case SOLVE:
+			return "solve";
+		case COLOURISE:
+			return "colourise";
+		default:
+			return "unknown";
+	}
+}
+
+std::string PipelineStats::toString() const {
+	std::ostringstream s;
+	s << std::fixed << std::setprecision(3);
+	s << "frames: " << frames << "\n";
+
+	uint64_t total = 0;
+	for (int i = 0; i < NUM_STAGES; i++) {
+		total += nanoseconds[i];
+	}
+	const double perFrame = frames ? 1e-6 / frames : 0;
+	for (int i = 0; i < NUM_STAGES; i++) {
+		s << getStageName(i) << ": " << nanoseconds[i] * perFrame << " ms/frame\n";
+	}
+	s << "total: " << total * perFrame << " ms/frame\n";
+
+	const uint64_t pixels = asymptoticPixels + zeroPixels + newtonPixels;
+	const double percent = pixels ? 100.0 / pixels : 0;
+	s << std::setprecision(1);
+	s << "asymptotic: " << asymptoticPixels << " (" << asymptoticPixels * percent << "%)\n";
+	s << "zero: " << zeroPixels << " (" << zeroPixels * percent << "%)\n";
+	s << "newton: " << newtonPixels << " (" << newtonPixels * percent << "%)\n";
+	return s.str();
+}
+
+} // namespace
@@ -0,0 +1,99 @@
+#ifndef SPECKLE_PIPELINESTATS_H
+#define SPECKLE_PIPELINESTATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace Speckle {
+
+/**
+ * Cumulative timings and counters collected by ComputePipeline
+ */
+struct PipelineStats {
+	enum Stage {
+		UNPACK,
+		CONTRAST,
+		SOLVE,
+		COLOURISE,
+		NUM_STAGES
+	};
+
+	PipelineStats() {
+		clear();
+	}
+
+	void clear();
+	void add(const PipelineStats & other);
+
+	/**
+	 * Format the statistics as text, one line per item
+	 */
+	std::string toString() const;
+
+	static const char * getStageName(int stage);
+
+	// The number of frames completed
+	uint64_t frames;
+
+	// The time spent in each stage. When the pipeline uses several
+	// threads, this is the total over all of them.
+	uint64_t nanoseconds[NUM_STAGES];
+
+	// The number of K² values which fell into each branch of
+	// CorrelationTime: the asymptotic approximation, the clamp to zero at
+	// K² ≥ β, and the table lookup with a Newton iteration
+	uint64_t asymptoticPixels;
+	uint64_t zeroPixels;
+	uint64_t newtonPixels;
+};
+
+/**
+ * Attribute the time between consecutive calls of lap() to pipeline
+ * stages. When disabled, the clock is never read.
+ */
+class StageTimer {
+public:
+	StageTimer(bool enabled)
+		: m_enabled(enabled)
+	{
+		if (m_enabled) {
+			m_last = Clock::now();
+		}
+	}
+
+	bool isEnabled() const {
+		return m_enabled;
+	}
+
+	/**
+	 * Add the time since the last lap to the given stage
+	 */
+	void lap(PipelineStats & stats, int stage) {
+		if (m_enabled) {
+			Clock::time_point now = Clock::now();
+			stats.nanoseconds[stage] +=
+				std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_last).count();
+			m_last = now;
+		}
+	}
+
+	/**
+	 * Start the next lap without attributing the elapsed time to any stage
+	 */
+	void skip() {
+		if (m_enabled) {
+			m_last = Clock::now();
+		}
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	bool m_enabled;
+	Clock::time_point m_last;
+};
+
+} // namespace
+
+#endif
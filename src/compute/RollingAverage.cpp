@@ -0,0 +1,130 @@
+#include <cmath>
+#include <stdexcept>
+#include "compute/RollingAverage.h"
+
+namespace Speckle {
+
+// Values larger than this, including the infinite correlation time of a
+// dark pixel, are clamped, so that the sums stay finite
+static const double maxValue = 1e9;
+
+RollingAverage::RollingAverage(Mode mode, int frames, int width, int height,
+	bool inverse, double outlierThreshold)
+	: m_mode(mode),
+	m_frames(frames),
+	m_width(width),
+	m_inverse(inverse),
+	m_threshold(outlierThreshold),
+	m_alpha(2.0 / (frames + 1)),
+	m_sum((size_t)width * height),
+	m_current(-1),
+	m_count(0),
+	m_full(false),
+	m_meanAverage(0),
+	m_accepted(false),
+	m_rejected(0),
+	m_rejectedTotal(0)
+{
+	if (frames < 1) {
+		throw std::runtime_error("The average must have at least one frame");
+	}
+	if (mode == BOXCAR) {
+		m_history.resize((size_t)frames * width * height);
+		m_means.resize(frames);
+	}
+}
+
+bool RollingAverage::startFrame(double mean) {
+	if (m_count > 0 && m_threshold > 0 && m_rejected < m_frames) {
+		double reference = m_mode == BOXCAR ? m_meanAverage / m_count : m_meanAverage;
+		if (reference <= 0) {
+			// A change relative to a zero mean would reject every frame,
+			// so start again from this one instead, unless it is the same
+			if (mean != reference) {
+				m_count = 0;
+			}
+		} else if (std::fabs(mean - reference) > m_threshold * reference) {
+			m_accepted = false;
+			m_rejected++;
+			m_rejectedTotal++;
+			return false;
+		}
+	}
+	if (m_rejected >= m_frames) {
+		// The scene has changed, start again
+		m_count = 0;
+	}
+	m_rejected = 0;
+	m_accepted = true;
+
+	m_full = m_count == m_frames;
+	if (m_count < m_frames) {
+		m_count++;
+	}
+	if (m_mode == BOXCAR) {
+		m_current = (m_current + 1) % m_frames;
+		if (m_count == 1) {
+			m_meanAverage = 0;
+		} else if (m_full) {
+			m_meanAverage -= m_means[m_current];
+		}
+		m_meanAverage += mean;
+		m_means[m_current] = mean;
+	} else {
+		if (m_count == 1) {
+			m_meanAverage = mean;
+		} else {
+			m_meanAverage += m_alpha * (mean - m_meanAverage);
+		}
+	}
+	return true;
+}
+
+double RollingAverage::transform(double value) const {
+	if (m_inverse) {
+		value = 1.0 / value;
+	}
+	// This also replaces NaN
+	if (!(value <= maxValue)) {
+		value = maxValue;
+	}
+	return value;
+}
+
+void RollingAverage::computeRow(int y, const double * input, double * output) {
+	const size_t rowStart = (size_t)y * m_width;
+	double * sum = &m_sum[rowStart];
+	const bool reset = m_count == 1;
+
+	if (m_accepted && m_mode == BOXCAR) {
+		float * history = &m_history[(size_t)m_current * m_sum.size() + rowStart];
+		const bool full = m_full && !reset;
+		for (int x = 0; x < m_width; x++) {
+			float value = (float)transform(input[x]);
+			if (reset) {
+				sum[x] = 0;
+			} else if (full) {
+				sum[x] -= history[x];
+			}
+			sum[x] += value;
+			history[x] = value;
+		}
+	} else if (m_accepted) {
+		for (int x = 0; x < m_width; x++) {
+			double value = transform(input[x]);
+			if (reset) {
+				sum[x] = value;
+			} else {
+				sum[x] += m_alpha * (value - sum[x]);
+			}
+		}
+	}
+
+	const double scale = m_mode == BOXCAR ? 1.0 / m_count : 1.0;
+	for (int x = 0; x < m_width; x++) {
+		double average = sum[x] * scale;
+		output[x] = m_inverse ? 1.0 / average : average;
+	}
+}
+
+} // namespace
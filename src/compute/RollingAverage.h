@@ -0,0 +1,119 @@
+#ifndef SPECKLE_ROLLINGAVERAGE_H
+#define SPECKLE_ROLLINGAVERAGE_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace Speckle {
+
+/**
+ * Average per-pixel values, such as correlation times, over a sequence of
+ * frames. The average is updated incrementally, so the work per frame is
+ * proportional to the number of pixels.
+ *
+ * A frame whose global mean differs from the mean of the averaged frames
+ * by more than the outlier threshold, for example due to motion or a
+ * change in illumination, is left out of the average. If the number of
+ * consecutive rejected frames reaches the window size, the scene is assumed
+ * to have changed, and the average is restarted. A relative change from a
+ * mean of zero, as after a black or saturated frame, is not meaningful, so
+ * then a frame with a different mean restarts the average instead.
+ *
+ * Rows may be computed concurrently, as long as each row of a frame is
+ * computed once, after startFrame().
+ */
+class RollingAverage {
+public:
+	enum Mode {
+		// Exponential moving average, with the same mean age as a boxcar of
+		// the given number of frames. The state is one value per pixel.
+		EXPONENTIAL,
+		// Mean of the last N frames. The state is N frames of values.
+		BOXCAR
+	};
+
+	/**
+	 * @param mode The averaging mode
+	 * @param frames The window size in frames
+	 * @param width The frame width
+	 * @param height The frame height
+	 * @param inverse If true, average the reciprocals of the input values,
+	 *   and output the reciprocal of the average
+	 * @param outlierThreshold The maximum relative change in the global mean
+	 *   of an accepted frame, or 0 to accept all frames
+	 */
+	RollingAverage(Mode mode, int frames, int width, int height, bool inverse,
+		double outlierThreshold);
+
+	/**
+	 * Start a new frame with the given global mean, and decide whether it
+	 * will be added to the average. Return true if it will.
+	 */
+	bool startFrame(double mean);
+
+	/**
+	 * Add row y of the current frame, if it was accepted, and write the
+	 * average of row y to output. The input and output may be the same.
+	 */
+	void computeRow(int y, const double * input, double * output);
+
+	/**
+	 * Get the total number of frames rejected as outliers
+	 */
+	int getRejectedCount() const {
+		return m_rejectedTotal;
+	}
+
+	/**
+	 * Discard the average, so that the next frame starts a new one
+	 */
+	void reset() {
+		m_count = 0;
+		m_rejected = 0;
+	}
+
+private:
+	double transform(double value) const;
+
+	const Mode m_mode;
+	const int m_frames;
+	const int m_width;
+	const bool m_inverse;
+	const double m_threshold;
+
+	// The weight of a new frame in the exponential average
+	const double m_alpha;
+
+	// The average (exponential) or sum (boxcar) of each pixel
+	std::vector<double> m_sum;
+
+	// The last m_frames frames of transformed values for the boxcar,
+	// m_current is the newest
+	std::vector<float> m_history;
+	int m_current;
+
+	// The number of frames in the average, up to m_frames
+	int m_count;
+
+	// Whether the boxcar was already full when the current frame was
+	// accepted, so that the frame in slot m_current is leaving it
+	bool m_full;
+
+	// The average (exponential) or ring buffer (boxcar) of the global means
+	// of the accepted frames, used as the reference for outlier rejection
+	double m_meanAverage;
+	std::vector<double> m_means;
+
+	// Whether the current frame is being added
+	bool m_accepted;
+
+	// The number of consecutive frames rejected
+	int m_rejected;
+
+	std::atomic<int> m_rejectedTotal;
+};
+
+} // namespace
+
+#endif
@@ -1,77 +1,77 @@
 #include "compute/SpatialWindow.h"
-#include <cstdio>
+#include "compute/IntegralImage.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
 
 namespace Speckle {
 
-SpatialWindow::SpatialWindow(int window, int width)
-	: m_window(window),
+template <typename Accumulator>
+BasicSpatialWindow<Accumulator>::BasicSpatialWindow(int window, int width)
+	: m_history(window * width),
+	m_vertSum(width),
+	m_vertSumSq(width),
+	m_cumSum(width + 1),
+	m_cumSumSq(width + 1),
+	m_window(window),
 	m_width(width),
 	m_area(window * window),
-	m_top(0),
-	m_pivot(0)
-{
-	for (int y = 0; y < window + 1; y++) {
-		m_buffer.emplace_back(width);
-	}
+	m_row(0),
+	m_historyOffset(0),
+	m_horizSum(0),
+	m_horizSumSq(0)
+{}
+
+template <typename Accumulator>
+bool BasicSpatialWindow<Accumulator>::fits(int bitsPerPixel, int window) {
+	const int64_t maxValue = (INT64_C(1) << bitsPerPixel) - 1;
+	const int64_t maxSq = std::max(INT64_C(1), maxValue * maxValue);
+	const int64_t area = (int64_t)window * window;
+	// The sum of squares over the window must fit in the accumulator, and
+	// the numerator of K² must fit in an int64_t
+	return area <= std::numeric_limits<Accumulator>::max() / maxSq
+		&& area <= std::numeric_limits<int64_t>::max() / maxSq / area;
 }
 
-double SpatialWindow::compute(ComputePos & pos, int value) {
+template <typename Accumulator>
+double BasicSpatialWindow<Accumulator>::compute(ComputePos & pos, int value) {
 	const int x = pos.x;
 	const int y = pos.y;
+	const int window = m_window;
 
-	if (x == 0 && y > m_window) {
-		// Rotate the buffer, drop a row from the top
-		m_top++;
-		if (m_pivot == m_window) {
-			m_pivot = -1;
-		}
-		m_pivot++;
+	if (x == 0) {
+		m_historyOffset = (y % window) * m_width;
+		m_horizSum = 0;
+		m_horizSumSq = 0;
 	}
-	PixelStats & current = getBufferEntry(x, y);
 
-	// Record value and value squared
-	current.value = value;
-	int valueSq = value * value;
-	current.valueSq = valueSq;
+	// Replace the value which is leaving the window with the new value
+	Accumulator & slot = m_history[m_historyOffset + x];
+	Accumulator leaving = y >= window ? slot : 0;
+	slot = value;
 
 	// Vertical (subtotal) sums
-	current.vertSum = value;
-	current.vertSumSq = valueSq;
-
-	if (y > 0) {
-		PixelStats & previous = getBufferEntry(x, y - 1);
-		current.vertSum += previous.vertSum;
-		current.vertSumSq += previous.vertSumSq;
-	}
-
-	int window = m_window;
-	bool valid = true;
-
-	if (y >= window) {
-		PixelStats & top = getBufferEntry(x, y - window);
-		current.vertSum -= top.value;
-		current.vertSumSq -= top.valueSq;
-	} else if (y < window - 1) {
-		valid = false;
+	if (y == 0) {
+		m_vertSum[x] = value;
+		m_vertSumSq[x] = (Accumulator)value * value;
+	} else {
+		m_vertSum[x] += value - leaving;
+		m_vertSumSq[x] += (Accumulator)value * value - leaving * leaving;
 	}
 
 	// Horizontal (grand total) sums
-	current.horizSum = current.vertSum;
-	current.horizSumSq = current.vertSumSq;
-	if (x > 0) {
-		PixelStats & previous = getBufferEntry(x - 1, y);
-		current.horizSum += previous.horizSum;
-		current.horizSumSq += previous.horizSumSq;
-	}
+	m_horizSum += m_vertSum[x];
+	m_horizSumSq += m_vertSumSq[x];
 	if (x >= window) {
-		PixelStats & left = getBufferEntry(x - window, y);
-		current.horizSum -= left.vertSum;
-		current.horizSumSq -= left.vertSumSq;
-	} else if (x < window - 1) {
-		valid = false;
+		m_horizSum -= m_vertSum[x - window];
+		m_horizSumSq -= m_vertSumSq[x - window];
 	}
 
-	if (!valid) {
+	if (y < window - 1 || x < window - 1) {
 		return 0.0;
 	}
 
@@ -79,32 +79,392 @@ double SpatialWindow::compute(ComputePos & pos, int value) {
 	pos.outX = x - halfWindow;
 	pos.outY = y - halfWindow;
 
-	double kSquared;
+	return computeKSquared(m_horizSum, m_horizSumSq, m_area);
+}
 
-	if (current.horizSum == 0) {
-		kSquared = 0.0;
-	} else {
-		kSquared =
-			(double)(
-				(int64_t)m_area * current.horizSumSq - 
-				(int64_t)current.horizSum * current.horizSum
-			) / (m_area - 1)
-			/ current.horizSum / current.horizSum * m_area;
-	}
-
-#if 0
-	static int sample = 0;
-	if (++sample > 100000) {
-		sample = 0;
-		std::printf("%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%g\n",
-				pos.x, pos.y, pos.outX, pos.outY,
-				current.value, current.valueSq,
-					current.vertSum, current.vertSumSq,
-				current.horizSum, current.horizSumSq, kSquared);
+template <typename Accumulator>
+int BasicSpatialWindow<Accumulator>::computeRow(const uint16_t * input, double * output) {
+	updateColumns(input);
+	int y = m_row++;
+	if (y < m_window - 1) {
+		return -1;
+	}
+
+	// This is a serial dependency chain, but it is only one add per column.
+	// The window sums are differences of the cumulative sums, which are
+	// exact despite wrapping.
+	Cumulative * cumSum = &m_cumSum[0];
+	Cumulative * cumSumSq = &m_cumSumSq[0];
+	cumSum[0] = 0;
+	cumSumSq[0] = 0;
+	for (int x = 0; x < m_width; x++) {
+		cumSum[x + 1] = cumSum[x] + (Cumulative)m_vertSum[x];
+		cumSumSq[x + 1] = cumSumSq[x] + (Cumulative)m_vertSumSq[x];
+	}
+	computeOutput(cumSum, cumSumSq, m_window, getOutputWidth(), output);
+	return y - m_window / 2;
+}
+
+/**
+ * Write the new row into the history and update the vertical sums
+ */
+template <>
+void BasicSpatialWindow<int32_t>::updateColumns(const uint16_t * input) {
+	const int width = m_width;
+	// On the first row, the sums are reset. Until the window is full,
+	// nothing leaves it.
+	const bool reset = m_row == 0;
+	const bool subtract = m_row >= m_window;
+	int32_t * history = &m_history[(m_row % m_window) * width];
+	int32_t * vertSum = &m_vertSum[0];
+	int32_t * vertSumSq = &m_vertSumSq[0];
+	int x = 0;
+
+#if defined(__AVX2__)
+	for (; x + 8 <= width; x += 8) {
+		__m256i value = _mm256_cvtepu16_epi32(
+			_mm_loadu_si128((const __m128i*)(input + x)));
+		__m256i leaving = subtract
+			? _mm256_loadu_si256((const __m256i*)(history + x))
+			: _mm256_setzero_si256();
+		_mm256_storeu_si256((__m256i*)(history + x), value);
+
+		__m256i sum = reset ? _mm256_setzero_si256()
+			: _mm256_loadu_si256((const __m256i*)(vertSum + x));
+		__m256i sumSq = reset ? _mm256_setzero_si256()
+			: _mm256_loadu_si256((const __m256i*)(vertSumSq + x));
+		sum = _mm256_add_epi32(sum, _mm256_sub_epi32(value, leaving));
+		sumSq = _mm256_add_epi32(sumSq, _mm256_sub_epi32(
+			_mm256_mullo_epi32(value, value),
+			_mm256_mullo_epi32(leaving, leaving)));
+		_mm256_storeu_si256((__m256i*)(vertSum + x), sum);
+		_mm256_storeu_si256((__m256i*)(vertSumSq + x), sumSq);
+	}
+#elif defined(__SSE4_1__)
+	for (; x + 4 <= width; x += 4) {
+		__m128i value = _mm_cvtepu16_epi32(
+			_mm_loadl_epi64((const __m128i*)(input + x)));
+		__m128i leaving = subtract
+			? _mm_loadu_si128((const __m128i*)(history + x))
+			: _mm_setzero_si128();
+		_mm_storeu_si128((__m128i*)(history + x), value);
+
+		__m128i sum = reset ? _mm_setzero_si128()
+			: _mm_loadu_si128((const __m128i*)(vertSum + x));
+		__m128i sumSq = reset ? _mm_setzero_si128()
+			: _mm_loadu_si128((const __m128i*)(vertSumSq + x));
+		sum = _mm_add_epi32(sum, _mm_sub_epi32(value, leaving));
+		sumSq = _mm_add_epi32(sumSq, _mm_sub_epi32(
+			_mm_mullo_epi32(value, value),
+			_mm_mullo_epi32(leaving, leaving)));
+		_mm_storeu_si128((__m128i*)(vertSum + x), sum);
+		_mm_storeu_si128((__m128i*)(vertSumSq + x), sumSq);
+	}
+#endif
+
+	for (; x < width; x++) {
+		int value = input[x];
+		int leaving = subtract ? history[x] : 0;
+		history[x] = value;
+		if (reset) {
+			vertSum[x] = 0;
+			vertSumSq[x] = 0;
+		}
+		vertSum[x] += value - leaving;
+		vertSumSq[x] += value * value - leaving * leaving;
+	}
+}
+
+/**
+ * Compute the horizontal window sums, and from them, K²
+ */
+template <>
+void BasicSpatialWindow<int32_t>::computeOutput(const uint32_t * cumSum,
+		const uint32_t * cumSumSq, int window, int outputWidth, double * output)
+{
+	const int area = window * window;
+	int x = 0;
+
+	// The products area·sumSq and sum² are exact in double precision for any
+	// input which fits in the int sums, so the vector paths are bit-identical
+	// to computeKSquared().
+#if defined(__AVX2__)
+	const __m256d areaVec = _mm256_set1_pd(area);
+	const __m256d areaMinusOne = _mm256_set1_pd(area - 1);
+	const __m256d zero = _mm256_setzero_pd();
+	for (; x + 4 <= outputWidth; x += 4) {
+		__m128i sum = _mm_sub_epi32(
+			_mm_loadu_si128((const __m128i*)(cumSum + x + window)),
+			_mm_loadu_si128((const __m128i*)(cumSum + x)));
+		__m128i sumSq = _mm_sub_epi32(
+			_mm_loadu_si128((const __m128i*)(cumSumSq + x + window)),
+			_mm_loadu_si128((const __m128i*)(cumSumSq + x)));
+		__m256d s = _mm256_cvtepi32_pd(sum);
+		__m256d sq = _mm256_cvtepi32_pd(sumSq);
+		__m256d k = _mm256_sub_pd(_mm256_mul_pd(areaVec, sq), _mm256_mul_pd(s, s));
+		k = _mm256_div_pd(k, areaMinusOne);
+		k = _mm256_div_pd(k, s);
+		k = _mm256_div_pd(k, s);
+		k = _mm256_mul_pd(k, areaVec);
+		k = _mm256_andnot_pd(_mm256_cmp_pd(s, zero, _CMP_EQ_OQ), k);
+		_mm256_storeu_pd(output + x, k);
+	}
+#elif defined(__SSE4_1__)
+	const __m128d areaVec = _mm_set1_pd(area);
+	const __m128d areaMinusOne = _mm_set1_pd(area - 1);
+	const __m128d zero = _mm_setzero_pd();
+	for (; x + 2 <= outputWidth; x += 2) {
+		__m128i sum = _mm_sub_epi32(
+			_mm_loadl_epi64((const __m128i*)(cumSum + x + window)),
+			_mm_loadl_epi64((const __m128i*)(cumSum + x)));
+		__m128i sumSq = _mm_sub_epi32(
+			_mm_loadl_epi64((const __m128i*)(cumSumSq + x + window)),
+			_mm_loadl_epi64((const __m128i*)(cumSumSq + x)));
+		__m128d s = _mm_cvtepi32_pd(sum);
+		__m128d sq = _mm_cvtepi32_pd(sumSq);
+		__m128d k = _mm_sub_pd(_mm_mul_pd(areaVec, sq), _mm_mul_pd(s, s));
+		k = _mm_div_pd(k, areaMinusOne);
+		k = _mm_div_pd(k, s);
+		k = _mm_div_pd(k, s);
+		k = _mm_mul_pd(k, areaVec);
+		k = _mm_andnot_pd(_mm_cmpeq_pd(s, zero), k);
+		_mm_storeu_pd(output + x, k);
 	}
 #endif
 
-	return kSquared;
+	for (; x < outputWidth; x++) {
+		output[x] = computeKSquared(
+			(int32_t)(cumSum[x + window] - cumSum[x]),
+			(int32_t)(cumSumSq[x + window] - cumSumSq[x]),
+			area);
+	}
 }
 
+/**
+ * Write the new row into the history and update the vertical sums, with
+ * 64-bit lanes
+ */
+template <>
+void BasicSpatialWindow<int64_t>::updateColumns(const uint16_t * input) {
+	const int width = m_width;
+	const bool reset = m_row == 0;
+	const bool subtract = m_row >= m_window;
+	int64_t * history = &m_history[(m_row % m_window) * width];
+	int64_t * vertSum = &m_vertSum[0];
+	int64_t * vertSumSq = &m_vertSumSq[0];
+	int x = 0;
+
+	// The values are less than 2^16, so the squares can be done with a
+	// 32×32→64 multiply
+#if defined(__AVX2__)
+	for (; x + 4 <= width; x += 4) {
+		__m256i value = _mm256_cvtepu16_epi64(
+			_mm_loadl_epi64((const __m128i*)(input + x)));
+		__m256i leaving = subtract
+			? _mm256_loadu_si256((const __m256i*)(history + x))
+			: _mm256_setzero_si256();
+		_mm256_storeu_si256((__m256i*)(history + x), value);
+
+		__m256i sum = reset ? _mm256_setzero_si256()
+			: _mm256_loadu_si256((const __m256i*)(vertSum + x));
+		__m256i sumSq = reset ? _mm256_setzero_si256()
+			: _mm256_loadu_si256((const __m256i*)(vertSumSq + x));
+		sum = _mm256_add_epi64(sum, _mm256_sub_epi64(value, leaving));
+		sumSq = _mm256_add_epi64(sumSq, _mm256_sub_epi64(
+			_mm256_mul_epu32(value, value),
+			_mm256_mul_epu32(leaving, leaving)));
+		_mm256_storeu_si256((__m256i*)(vertSum + x), sum);
+		_mm256_storeu_si256((__m256i*)(vertSumSq + x), sumSq);
+	}
+#elif defined(__SSE4_1__)
+	for (; x + 2 <= width; x += 2) {
+		__m128i value = _mm_cvtepu16_epi64(
+			_mm_cvtsi32_si128((int)(input[x] | ((uint32_t)input[x + 1] << 16))));
+		__m128i leaving = subtract
+			? _mm_loadu_si128((const __m128i*)(history + x))
+			: _mm_setzero_si128();
+		_mm_storeu_si128((__m128i*)(history + x), value);
+
+		__m128i sum = reset ? _mm_setzero_si128()
+			: _mm_loadu_si128((const __m128i*)(vertSum + x));
+		__m128i sumSq = reset ? _mm_setzero_si128()
+			: _mm_loadu_si128((const __m128i*)(vertSumSq + x));
+		sum = _mm_add_epi64(sum, _mm_sub_epi64(value, leaving));
+		sumSq = _mm_add_epi64(sumSq, _mm_sub_epi64(
+			_mm_mul_epu32(value, value),
+			_mm_mul_epu32(leaving, leaving)));
+		_mm_storeu_si128((__m128i*)(vertSum + x), sum);
+		_mm_storeu_si128((__m128i*)(vertSumSq + x), sumSq);
+	}
+#endif
+
+	for (; x < width; x++) {
+		int64_t value = input[x];
+		int64_t leaving = subtract ? history[x] : 0;
+		history[x] = value;
+		if (reset) {
+			vertSum[x] = 0;
+			vertSumSq[x] = 0;
+		}
+		vertSum[x] += value - leaving;
+		vertSumSq[x] += value * value - leaving * leaving;
+	}
+}
+
+/**
+ * Compute K² from the 64-bit horizontal window sums
+ */
+template <>
+void BasicSpatialWindow<int64_t>::computeOutput(const uint64_t * cumSum,
+		const uint64_t * cumSumSq, int window, int outputWidth, double * output)
+{
+	const int area = window * window;
+	int x = 0;
+
+	// fits() guarantees that the window sum is less than 2^32 and that the
+	// numerator area·sumSq - sum² fits in an int64_t. The numerator is
+	// computed exactly with 32×32→64 multiplies, then converted to double
+	// with the same rounding as the scalar conversion, by adding the high
+	// and low halves with exponents of 2^84 and 2^52 (the magic constants
+	// below). So the vector paths
+	// are bit-identical to computeKSquared().
+#if defined(__AVX2__)
+	const __m256i areaInt = _mm256_set1_epi64x(area);
+	const __m256i exp52 = _mm256_set1_epi64x(0x4330000000000000);
+	const __m256i exp84 = _mm256_set1_epi64x(0x4530000000000000);
+	const __m256d exp52Double = _mm256_set1_pd(4503599627370496.0);
+	const __m256d exp84Double = _mm256_set1_pd(19342813113834066795298816.0 + 4503599627370496.0);
+	const __m256d areaVec = _mm256_set1_pd(area);
+	const __m256d areaMinusOne = _mm256_set1_pd(area - 1);
+	const __m256d zero = _mm256_setzero_pd();
+	for (; x + 4 <= outputWidth; x += 4) {
+		__m256i sum = _mm256_sub_epi64(
+			_mm256_loadu_si256((const __m256i*)(cumSum + x + window)),
+			_mm256_loadu_si256((const __m256i*)(cumSum + x)));
+		__m256i sumSq = _mm256_sub_epi64(
+			_mm256_loadu_si256((const __m256i*)(cumSumSq + x + window)),
+			_mm256_loadu_si256((const __m256i*)(cumSumSq + x)));
+		__m256i num = _mm256_add_epi64(
+			_mm256_mul_epu32(areaInt, sumSq),
+			_mm256_slli_epi64(_mm256_mul_epu32(areaInt,
+				_mm256_srli_epi64(sumSq, 32)), 32));
+		num = _mm256_sub_epi64(num, _mm256_mul_epu32(sum, sum));
+
+		__m256d numLow = _mm256_castsi256_pd(_mm256_blend_epi16(num, exp52, 0xcc));
+		__m256d numHigh = _mm256_castsi256_pd(
+			_mm256_or_si256(_mm256_srli_epi64(num, 32), exp84));
+		__m256d k = _mm256_add_pd(_mm256_sub_pd(numHigh, exp84Double), numLow);
+		__m256d s = _mm256_sub_pd(
+			_mm256_castsi256_pd(_mm256_or_si256(sum, exp52)), exp52Double);
+
+		k = _mm256_div_pd(k, areaMinusOne);
+		k = _mm256_div_pd(k, s);
+		k = _mm256_div_pd(k, s);
+		k = _mm256_mul_pd(k, areaVec);
+		k = _mm256_andnot_pd(_mm256_cmp_pd(s, zero, _CMP_EQ_OQ), k);
+		_mm256_storeu_pd(output + x, k);
+	}
+#elif defined(__SSE4_1__)
+	const __m128i areaInt = _mm_set1_epi64x(area);
+	const __m128i exp52 = _mm_set1_epi64x(0x4330000000000000);
+	const __m128i exp84 = _mm_set1_epi64x(0x4530000000000000);
+	const __m128d exp52Double = _mm_set1_pd(4503599627370496.0);
+	const __m128d exp84Double = _mm_set1_pd(19342813113834066795298816.0 + 4503599627370496.0);
+	const __m128d areaVec = _mm_set1_pd(area);
+	const __m128d areaMinusOne = _mm_set1_pd(area - 1);
+	const __m128d zero = _mm_setzero_pd();
+	for (; x + 2 <= outputWidth; x += 2) {
+		__m128i sum = _mm_sub_epi64(
+			_mm_loadu_si128((const __m128i*)(cumSum + x + window)),
+			_mm_loadu_si128((const __m128i*)(cumSum + x)));
+		__m128i sumSq = _mm_sub_epi64(
+			_mm_loadu_si128((const __m128i*)(cumSumSq + x + window)),
+			_mm_loadu_si128((const __m128i*)(cumSumSq + x)));
+		__m128i num = _mm_add_epi64(
+			_mm_mul_epu32(areaInt, sumSq),
+			_mm_slli_epi64(_mm_mul_epu32(areaInt,
+				_mm_srli_epi64(sumSq, 32)), 32));
+		num = _mm_sub_epi64(num, _mm_mul_epu32(sum, sum));
+
+		__m128d numLow = _mm_castsi128_pd(_mm_blend_epi16(num, exp52, 0xcc));
+		__m128d numHigh = _mm_castsi128_pd(
+			_mm_or_si128(_mm_srli_epi64(num, 32), exp84));
+		__m128d k = _mm_add_pd(_mm_sub_pd(numHigh, exp84Double), numLow);
+		__m128d s = _mm_sub_pd(
+			_mm_castsi128_pd(_mm_or_si128(sum, exp52)), exp52Double);
+
+		k = _mm_div_pd(k, areaMinusOne);
+		k = _mm_div_pd(k, s);
+		k = _mm_div_pd(k, s);
+		k = _mm_mul_pd(k, areaVec);
+		k = _mm_andnot_pd(_mm_cmpeq_pd(s, zero), k);
+		_mm_storeu_pd(output + x, k);
+	}
+#endif
+
+	for (; x < outputWidth; x++) {
+		output[x] = computeKSquared(
+			(int64_t)(cumSum[x + window] - cumSum[x]),
+			(int64_t)(cumSumSq[x + window] - cumSumSq[x]),
+			area);
+	}
+}
+
+template class BasicSpatialWindow<int32_t>;
+template class BasicSpatialWindow<int64_t>;
+
+template <typename Accumulator>
+BasicMultiSpatialWindow<Accumulator>::BasicMultiSpatialWindow(
+		const std::vector<int> & windows, int width)
+	: m_windows(windows),
+	m_width(width),
+	m_slots(*std::max_element(windows.begin(), windows.end()) + 1),
+	m_integral((size_t)m_slots * (width + 1)),
+	m_integralSq((size_t)m_slots * (width + 1)),
+	m_cumSum(width + 1),
+	m_cumSumSq(width + 1),
+	m_row(0)
+{}
+
+template <typename Accumulator>
+void BasicMultiSpatialWindow<Accumulator>::addRow(const uint16_t * input) {
+	const int y = m_row++;
+	if (y == 0) {
+		std::fill_n(getIntegralRow(m_integral, -1), m_width + 1, 0);
+		std::fill_n(getIntegralRow(m_integralSq, -1), m_width + 1, 0);
+	}
+	IntegralImage::addRow(input,
+		getIntegralRow(m_integral, y - 1), getIntegralRow(m_integralSq, y - 1),
+		getIntegralRow(m_integral, y), getIntegralRow(m_integralSq, y),
+		m_width);
+}
+
+template <typename Accumulator>
+int BasicMultiSpatialWindow<Accumulator>::computeRow(int i, double * output) {
+	const int window = m_windows[i];
+	const int y = m_row - 1;
+	if (y < window - 1) {
+		return -1;
+	}
+
+	// The differences of the integral image rows are exact despite
+	// wrapping, as are the window sums computed from them
+	const Cumulative * top = getIntegralRow(m_integral, y - window);
+	const Cumulative * bottom = getIntegralRow(m_integral, y);
+	const Cumulative * topSq = getIntegralRow(m_integralSq, y - window);
+	const Cumulative * bottomSq = getIntegralRow(m_integralSq, y);
+	Cumulative * cumSum = &m_cumSum[0];
+	Cumulative * cumSumSq = &m_cumSumSq[0];
+	for (int x = 0; x <= m_width; x++) {
+		cumSum[x] = bottom[x] - top[x];
+		cumSumSq[x] = bottomSq[x] - topSq[x];
+	}
+	BasicSpatialWindow<Accumulator>::computeOutput(cumSum, cumSumSq, window,
+		getOutputWidth(i), output);
+	return y - window / 2;
+}
+
+template class BasicMultiSpatialWindow<int32_t>;
+template class BasicMultiSpatialWindow<int64_t>;
+
 } // namespace
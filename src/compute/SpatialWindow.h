@@ -2,48 +2,206 @@
 #define SPECKLE_SPATIALWINDOW_H
 
 #include <stdexcept>
+#include <cstdint>
+#include <type_traits>
 #include <vector>
 #include "compute/ComputePos.h"
 
 namespace Speckle {
 
-class SpatialWindow {
+template <typename Accumulator>
+class BasicMultiSpatialWindow;
+
+class IntegralImage;
+
+/**
+ * Compute K² over a window × window neighbourhood, with running sums of
+ * the given signed integer type. The sum of squares over a window must fit
+ * in the accumulator: use SpatialWindow where fits() allows it, since it
+ * is faster, and WideSpatialWindow otherwise.
+ */
+template <typename Accumulator>
+class BasicSpatialWindow {
 public:
-	SpatialWindow(int window, int width);
+	BasicSpatialWindow(int window, int width);
+
+	/**
+	 * Determine whether the sums for the given sample size and window size
+	 * fit in the accumulator
+	 */
+	static bool fits(int bitsPerPixel, int window);
 
 	void startFrame() {
-		m_top = -1;
-		m_pivot = -1;
+		m_row = 0;
 	}
 
 	double compute(ComputePos & pos, int value);
 
+	/**
+	 * Add a complete row of input to the window. If the row completes a
+	 * window, write getOutputWidth() K² values to output and return the
+	 * output row index. Otherwise return -1.
+	 *
+	 * output[i] corresponds to output column i + getOffset(). The result is
+	 * bit-identical to calling compute() for each pixel.
+	 */
+	int computeRow(const uint16_t * input, double * output);
+
+	int getOutputWidth() const {
+		return m_width - m_window + 1;
+	}
+
+	int getOffset() const {
+		return m_window - 1 - m_window / 2;
+	}
+
 private:
+	template <typename> friend class BasicMultiSpatialWindow;
+	friend class IntegralImage;
+
+	typedef typename std::make_unsigned<Accumulator>::type Cumulative;
 
-	struct PixelStats {
-		int value;
-		int valueSq;
-		int vertSum;
-		int vertSumSq;
-		int horizSum;
-		int horizSumSq;
-	};
+	void updateColumns(const uint16_t * input);
 
-	static_assert(sizeof(PixelStats) < sizeof(int) * 12, "Inefficient structure padding");
+	/**
+	 * Write outputWidth K² values from cumulative sums along a row, in
+	 * which element x is the sum of the column sums [0, x)
+	 */
+	static void computeOutput(const Cumulative * cumSum, const Cumulative * cumSumSq,
+		int window, int outputWidth, double * output);
 
-	PixelStats & getBufferEntry(int x, int y) {
-		int rowIndex = (y - m_top + m_pivot) % (m_window + 1);
-		return m_buffer.at(rowIndex).at(x);
+	static double computeKSquared(Accumulator sum, Accumulator sumSq, int area) {
+		if (sum == 0) {
+			return 0.0;
+		}
+		return
+			(double)(
+				(int64_t)area * sumSq -
+				(int64_t)sum * sum
+			) / (area - 1)
+			/ sum / sum * area;
 	}
 
-	std::vector<std::vector<PixelStats>> m_buffer;
+	// The last m_window input rows, as a ring buffer indexed by y % m_window
+	std::vector<Accumulator> m_history;
+
+	// Per-column sums over the last m_window rows
+	std::vector<Accumulator> m_vertSum;
+	std::vector<Accumulator> m_vertSumSq;
+
+	// Cumulative sums of m_vertSum along the current row, modulo the
+	// accumulator size. Element x is the sum of columns [0, x).
+	std::vector<Cumulative> m_cumSum;
+	std::vector<Cumulative> m_cumSumSq;
+
 	const int m_window;
 	const int m_width;
 	const int m_area;
-	int m_top;
-	int m_pivot;
+
+	// The number of rows passed to computeRow() in this frame
+	int m_row;
+
+	// State of the per-pixel interface
+	int m_historyOffset;
+	Accumulator m_horizSum;
+	Accumulator m_horizSumSq;
+};
+
+/**
+ * Spatial window with 32-bit sums, for samples of up to 10 bits with
+ * windows of up to 45×45
+ */
+typedef BasicSpatialWindow<int32_t> SpatialWindow;
+
+/**
+ * Spatial window with 64-bit sums, for 16-bit samples or large windows
+ */
+typedef BasicSpatialWindow<int64_t> WideSpatialWindow;
+
+/**
+ * Compute K² for several window sizes in one pass over the input. The sums
+ * are shared: each row of input is added to a row of an integral image, as
+ * in IntegralImage but keeping only the last rows. The cumulative sums
+ * along the row of the column sums over the last N rows are then one
+ * subtraction for any N up to the largest window. Only that subtraction and
+ * K² itself are computed separately for each size.
+ */
+template <typename Accumulator>
+class BasicMultiSpatialWindow {
+public:
+	/**
+	 * @param windows The window sizes, in any order. The accumulator must
+	 *   fit the largest, see BasicSpatialWindow::fits().
+	 */
+	BasicMultiSpatialWindow(const std::vector<int> & windows, int width);
+
+	void startFrame() {
+		m_row = 0;
+	}
+
+	/**
+	 * Add a complete row of input to the column sums
+	 */
+	void addRow(const uint16_t * input);
+
+	/**
+	 * If the last row added completes a window of size getWindow(i), write
+	 * getOutputWidth(i) K² values to output and return the output row
+	 * index. Otherwise return -1. The result is bit-identical to that of
+	 * BasicSpatialWindow::computeRow() with the same window size.
+	 */
+	int computeRow(int i, double * output);
+
+	int getWindowCount() const {
+		return m_windows.size();
+	}
+
+	int getWindow(int i) const {
+		return m_windows[i];
+	}
+
+	int getOutputWidth(int i) const {
+		return m_width - m_windows[i] + 1;
+	}
+
+	int getOffset(int i) const {
+		return m_windows[i] - 1 - m_windows[i] / 2;
+	}
+
+private:
+	typedef typename BasicSpatialWindow<Accumulator>::Cumulative Cumulative;
+
+	/**
+	 * Get the integral image row of input rows [0, y], for y >= -1
+	 */
+	Cumulative * getIntegralRow(std::vector<Cumulative> & sums, int y) {
+		return &sums[(size_t)((y + 1) % m_slots) * (m_width + 1)];
+	}
+
+	const std::vector<int> m_windows;
+	const int m_width;
+
+	// The last rows of the integral images of the input and its square,
+	// modulo the accumulator size, as ring buffers of m_slots rows of
+	// m_width + 1. Element x of row y + 1 of the ring is the sum of input
+	// rows [0, y] and columns [0, x). Row 0 starts with the zero sums of no
+	// rows.
+	int m_slots;
+	std::vector<Cumulative> m_integral;
+	std::vector<Cumulative> m_integralSq;
+
+	// Cumulative sums along the row of the window sums of each column, as
+	// in BasicSpatialWindow
+	std::vector<Cumulative> m_cumSum;
+	std::vector<Cumulative> m_cumSumSq;
+
+	// The number of rows added in this frame
+	int m_row;
 };
 
+typedef BasicMultiSpatialWindow<int32_t> MultiSpatialWindow;
+typedef BasicMultiSpatialWindow<int64_t> WideMultiSpatialWindow;
+
 } // namespace
 
 #endif
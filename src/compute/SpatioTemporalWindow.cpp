@@ -0,0 +1,84 @@
+#include <stdexcept>
+#include "compute/SpatioTemporalWindow.h"
+
+namespace Speckle {
+
+SpatioTemporalWindow::SpatioTemporalWindow(int window, int frames, int width)
+	: m_history((size_t)window * width),
+	m_historySq((size_t)window * width),
+	m_vertSum(width),
+	m_vertSumSq(width),
+	m_cumSum(width + 1),
+	m_cumSumSq(width + 1),
+	m_window(window),
+	m_width(width),
+	m_count(0),
+	m_row(0)
+{
+	// With 16-bit input, the sums must fit in a uint32_t, and count² · 65535²
+	// must fit in an int64_t
+	if ((int64_t)window * window * frames > 46000) {
+		throw std::runtime_error("The spatio-temporal window is too large");
+	}
+}
+
+void SpatioTemporalWindow::startFrame(int frames) {
+	m_count = (int64_t)m_window * m_window * frames;
+	m_row = 0;
+}
+
+int SpatioTemporalWindow::computeRow(const uint32_t * sum, const uint64_t * sumSq,
+	double * output)
+{
+	const int width = m_width;
+	const int window = m_window;
+	const bool reset = m_row == 0;
+	const bool subtract = m_row >= window;
+	const size_t historyOffset = (size_t)(m_row % window) * width;
+	uint32_t * history = &m_history[historyOffset];
+	uint64_t * historySq = &m_historySq[historyOffset];
+	uint32_t * vertSum = &m_vertSum[0];
+	uint64_t * vertSumSq = &m_vertSumSq[0];
+
+	for (int x = 0; x < width; x++) {
+		uint32_t leaving = subtract ? history[x] : 0;
+		uint64_t leavingSq = subtract ? historySq[x] : 0;
+		history[x] = sum[x];
+		historySq[x] = sumSq[x];
+		if (reset) {
+			vertSum[x] = 0;
+			vertSumSq[x] = 0;
+		}
+		vertSum[x] += sum[x] - leaving;
+		vertSumSq[x] += sumSq[x] - leavingSq;
+	}
+
+	int y = m_row++;
+	if (y < window - 1) {
+		return -1;
+	}
+
+	uint32_t * cumSum = &m_cumSum[0];
+	uint64_t * cumSumSq = &m_cumSumSq[0];
+	cumSum[0] = 0;
+	cumSumSq[0] = 0;
+	for (int x = 0; x < width; x++) {
+		cumSum[x + 1] = cumSum[x] + vertSum[x];
+		cumSumSq[x + 1] = cumSumSq[x] + vertSumSq[x];
+	}
+
+	const int64_t n = m_count;
+	const int outputWidth = getOutputWidth();
+	for (int x = 0; x < outputWidth; x++) {
+		int64_t s = cumSum[x + window] - cumSum[x];
+		int64_t sq = cumSumSq[x + window] - cumSumSq[x];
+		if (s == 0 || n < 2) {
+			output[x] = 0.0;
+			continue;
+		}
+		output[x] = (double)(n * sq - s * s) / (n - 1) / s / s * n;
+	}
+	return y - window / 2;
+}
+
+} // namespace
@@ -0,0 +1,74 @@
+#ifndef SPECKLE_SPATIOTEMPORALWINDOW_H
+#define SPECKLE_SPATIOTEMPORALWINDOW_H
+
+#include <cstdint>
+#include <vector>
+
+namespace Speckle {
+
+/**
+ * Compute spatio-temporal speckle contrast: K² over a window × window
+ * neighbourhood in each of the last N frames.
+ *
+ * The input rows are the per-pixel sums over N frames maintained by
+ * TemporalWindow, so the cost of a frame does not depend on N. They are
+ * combined with the same running vertical and cumulative horizontal sums as
+ * SpatialWindow uses.
+ */
+class SpatioTemporalWindow {
+public:
+	/**
+	 * Construct a window of window × window pixels, for temporal sums over
+	 * at most the given number of frames
+	 */
+	SpatioTemporalWindow(int window, int frames, int width);
+
+	/**
+	 * Start a new frame, in which the temporal sums cover the given number
+	 * of frames
+	 */
+	void startFrame(int frames);
+
+	/**
+	 * Add the temporal sums of the next row to the window. If the row
+	 * completes a window, write getOutputWidth() K² values to output and
+	 * return the output row index. Otherwise return -1.
+	 */
+	int computeRow(const uint32_t * sum, const uint64_t * sumSq, double * output);
+
+	int getOutputWidth() const {
+		return m_width - m_window + 1;
+	}
+
+	int getOffset() const {
+		return m_window - 1 - m_window / 2;
+	}
+
+private:
+	// The last m_window rows of temporal sums, indexed by y % m_window
+	std::vector<uint32_t> m_history;
+	std::vector<uint64_t> m_historySq;
+
+	// Per-column sums over the last m_window rows
+	std::vector<uint32_t> m_vertSum;
+	std::vector<uint64_t> m_vertSumSq;
+
+	// Cumulative sums of the vertical sums. Element x is the sum of
+	// columns [0, x).
+	std::vector<uint32_t> m_cumSum;
+	std::vector<uint64_t> m_cumSumSq;
+
+	const int m_window;
+	const int m_width;
+
+	// The number of samples in each window, which is the area times the
+	// number of frames
+	int64_t m_count;
+
+	// The number of rows passed to computeRow() in this frame
+	int m_row;
+};
+
+} // namespace
+
+#endif
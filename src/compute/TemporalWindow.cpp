@@ -0,0 +1,79 @@
+#include <stdexcept>
+#include "compute/TemporalWindow.h"
+
+namespace Speckle {
+
+TemporalWindow::TemporalWindow(int frames, int width, int height)
+	: m_frames(frames),
+	m_width(width),
+	m_height(height),
+	m_history((size_t)frames * width * height),
+	m_current(-1),
+	m_count(0),
+	m_full(false),
+	m_sum((size_t)width * height),
+	m_sumSq((size_t)width * height)
+{
+	if (frames < 1) {
+		throw std::runtime_error("The temporal window must have at least one frame");
+	}
+}
+
+void TemporalWindow::startFrame() {
+	m_current = (m_current + 1) % m_frames;
+	m_full = m_count == m_frames;
+	if (m_count < m_frames) {
+		m_count++;
+	}
+}
+
+void TemporalWindow::computeRow(int y, const uint16_t * input, double * output) {
+	addRow(y, input);
+
+	const uint32_t * sum = getSumRow(y);
+	const uint64_t * sumSq = getSumSqRow(y);
+	const int64_t n = m_count;
+	if (n < 2) {
+		for (int x = 0; x < m_width; x++) {
+			output[x] = 0.0;
+		}
+		return;
+	}
+	for (int x = 0; x < m_width; x++) {
+		if (sum[x] == 0) {
+			output[x] = 0.0;
+			continue;
+		}
+		double s = sum[x];
+		output[x] = (double)(n * (int64_t)sumSq[x] - (int64_t)sum[x] * sum[x])
+			/ (n - 1) / s / s * n;
+	}
+}
+
+void TemporalWindow::addRow(int y, const uint16_t * input) {
+	const size_t rowStart = (size_t)y * m_width;
+	uint16_t * history = &m_history[(size_t)m_current * m_width * m_height + rowStart];
+	uint32_t * sum = &m_sum[rowStart];
+	uint64_t * sumSq = &m_sumSq[rowStart];
+
+	// On the first frame, the sums are reset. This is also the case for
+	// every frame of a one-frame window, which has nothing to subtract.
+	const bool reset = m_count == 1;
+	if (reset) {
+		for (int x = 0; x < m_width; x++) {
+			sum[x] = 0;
+			sumSq[x] = 0;
+		}
+	}
+
+	const bool full = m_full && !reset;
+	for (int x = 0; x < m_width; x++) {
+		uint32_t value = input[x];
+		uint32_t leaving = full ? history[x] : 0;
+		history[x] = value;
+		sum[x] += value - leaving;
+		sumSq[x] += (uint64_t)value * value - (uint64_t)leaving * leaving;
+	}
+}
+
+} // namespace
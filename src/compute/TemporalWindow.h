@@ -0,0 +1,86 @@
+#ifndef SPECKLE_TEMPORALWINDOW_H
+#define SPECKLE_TEMPORALWINDOW_H
+
+#include <cstdint>
+#include <vector>
+
+namespace Speckle {
+
+/**
+ * Compute temporal speckle contrast: K² of each pixel over the last N
+ * frames. The frames are kept in a ring buffer, and each pixel has a running
+ * sum and sum of squares, so the cost of a frame does not depend on N.
+ *
+ * Rows may be computed concurrently, as long as each row of a frame is
+ * computed once, after startFrame().
+ */
+class TemporalWindow {
+public:
+	TemporalWindow(int frames, int width, int height);
+
+	/**
+	 * Start a new frame, replacing the oldest frame in the window
+	 */
+	void startFrame();
+
+	/**
+	 * Add row y of the current frame, and write K² over the frames in the
+	 * window for each of the width pixels in the row.
+	 */
+	void computeRow(int y, const uint16_t * input, double * output);
+
+	/**
+	 * Add row y of the current frame, updating the sums without computing
+	 * K². This is for SpatioTemporalWindow, which reads the sums with
+	 * getSumRow() and getSumSqRow().
+	 */
+	void addRow(int y, const uint16_t * input);
+
+	/**
+	 * Get the per-pixel sums of row y over the frames in the window
+	 */
+	const uint32_t * getSumRow(int y) const {
+		return &m_sum[(size_t)y * m_width];
+	}
+
+	const uint64_t * getSumSqRow(int y) const {
+		return &m_sumSq[(size_t)y * m_width];
+	}
+
+	/**
+	 * Get the number of frames currently in the window. Until the window is
+	 * full, K² is computed from the frames so far, and it is zero if there
+	 * is only one.
+	 */
+	int getFrameCount() const {
+		return m_count;
+	}
+
+	void reset() {
+		m_count = 0;
+		m_current = -1;
+	}
+
+private:
+	const int m_frames;
+	const int m_width;
+	const int m_height;
+
+	// The last m_frames frames, m_current is the newest
+	std::vector<uint16_t> m_history;
+	int m_current;
+	int m_count;
+
+	// Whether the window was already full at the start of the current
+	// frame, in which case the slot being overwritten holds the frame which
+	// is leaving the window. Otherwise, the slot is unused.
+	bool m_full;
+
+	// Per-pixel sums over the frames in the window
+	std::vector<uint32_t> m_sum;
+	std::vector<uint64_t> m_sumSq;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,135 @@
+#include "compute/Unpack.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace Speckle {
+
+void Unpack::computeRow(uint16_t * output, int count) {
+	// Check the input length once for the whole row
+	size_t bits = (size_t)count * m_bpp;
+	if (bits > (size_t)m_bufferSize + 8 * (size_t)(m_end - m_pos)) {
+		throw std::runtime_error("Attempted to read beyond the end of the input buffer");
+	}
+
+	if (m_bufferSize == 0) {
+		// Byte-aligned fast paths
+		int done = 0;
+		switch (m_bpp) {
+			case 8:
+				unpack8(output, count);
+				done = count;
+				break;
+			case 10:
+				// Whole groups of 4 pixels in 5 bytes
+				done = count & ~3;
+				unpack10(output, done);
+				break;
+			case 16:
+				unpack16(output, count);
+				done = count;
+				break;
+		}
+		output += done;
+		count -= done;
+	}
+	if (count) {
+		unpackBits(output, count);
+	}
+}
+
+/**
+ * The generic bit reader
+ */
+void Unpack::unpackBits(uint16_t * output, int count) {
+	const uint8_t * pos = m_pos;
+	unsigned int buffer = m_buffer;
+	int bufferSize = m_bufferSize;
+	for (int i = 0; i < count; i++) {
+		while (bufferSize < m_bpp) {
+			buffer = (buffer << 8) | *(pos++);
+			bufferSize += 8;
+		}
+		bufferSize -= m_bpp;
+		output[i] = (buffer >> bufferSize) & m_mask;
+	}
+	m_pos = pos;
+	m_buffer = buffer;
+	m_bufferSize = bufferSize;
+}
+
+void Unpack::unpack8(uint16_t * output, int count) {
+	const uint8_t * pos = m_pos;
+	int i = 0;
+#if defined(__SSE2__)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(pos + i));
+		_mm_storeu_si128((__m128i*)(output + i), _mm_unpacklo_epi8(bytes, zero));
+		_mm_storeu_si128((__m128i*)(output + i + 8), _mm_unpackhi_epi8(bytes, zero));
+	}
+#endif
+	for (; i < count; i++) {
+		output[i] = pos[i];
+	}
+	m_pos += count;
+}
+
+/**
+ * Unpack 10-bit samples, 4 pixels per 5 bytes, MSB first. count must be a
+ * multiple of 4.
+ */
+void Unpack::unpack10(uint16_t * output, int count) {
+	const uint8_t * pos = m_pos;
+	int i = 0;
+
+#if defined(__SSSE3__)
+	const uint8_t * end = m_end;
+
+	// Each group of 8 pixels comes from 10 bytes. Gather the two bytes
+	// containing each pixel into a big-endian 16-bit lane, then shift out
+	// the bits which belong to the previous pixel by multiplying by 1, 4, 16
+	// or 64, and shift out the bits of the next pixel with a right shift.
+	const __m128i shuffle = _mm_setr_epi8(
+		1, 0, 2, 1, 3, 2, 4, 3, 6, 5, 7, 6, 8, 7, 9, 8);
+	const __m128i multiplier = _mm_setr_epi16(1, 4, 16, 64, 1, 4, 16, 64);
+#endif
+#if defined(__AVX2__)
+	// 16 pixels from 20 bytes, the second 10 in the upper lane. The loads
+	// read 6 bytes beyond the group, so stop before the end of the frame.
+	const __m256i shuffle2 = _mm256_broadcastsi128_si256(shuffle);
+	const __m256i multiplier2 = _mm256_broadcastsi128_si256(multiplier);
+	for (; i + 16 <= count && pos + 26 <= end; i += 16, pos += 20) {
+		__m256i bytes = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)pos)),
+			_mm_loadu_si128((const __m128i*)(pos + 10)), 1);
+		__m256i words = _mm256_shuffle_epi8(bytes, shuffle2);
+		words = _mm256_srli_epi16(_mm256_mullo_epi16(words, multiplier2), 6);
+		_mm256_storeu_si256((__m256i*)(output + i), words);
+	}
+#endif
+#if defined(__SSSE3__)
+	for (; i + 8 <= count && pos + 16 <= end; i += 8, pos += 10) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)pos);
+		__m128i words = _mm_shuffle_epi8(bytes, shuffle);
+		words = _mm_srli_epi16(_mm_mullo_epi16(words, multiplier), 6);
+		_mm_storeu_si128((__m128i*)(output + i), words);
+	}
+#endif
+
+	for (; i < count; i += 4, pos += 5) {
+		output[i] = (pos[0] << 2) | (pos[1] >> 6);
+		output[i + 1] = ((pos[1] & 0x3f) << 4) | (pos[2] >> 4);
+		output[i + 2] = ((pos[2] & 0x0f) << 6) | (pos[3] >> 2);
+		output[i + 3] = ((pos[3] & 0x03) << 8) | pos[4];
+	}
+	m_pos += count / 4 * 5;
+}
+
+void Unpack::unpack16(uint16_t * output, int count) {
+	std::memcpy(output, m_pos, count * sizeof(uint16_t));
+	m_pos += count * sizeof(uint16_t);
+}
+
+} // namespace
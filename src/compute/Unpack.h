@@ -4,6 +4,7 @@
 #include <stdexcept>
 #include <cstdint>
 #include <limits>
+#include <cstring>
 
 #include "compute/ComputePos.h"
 
@@ -12,6 +13,10 @@ namespace Speckle {
 /**
  * Unpack a bit-packed representation of a luminance stream. Output pixels
  * as ints.
+ *
+ * Samples narrower than 16 bits are packed MSB first, as in libfreenect's
+ * packed IR format. 16-bit samples are native-endian words, as delivered by
+ * libfreenect and libtiff.
  */
 class Unpack {
 public:
@@ -25,13 +30,45 @@ public:
 		}	
 	}
 
-	void startFrame(void *data) {
-		m_pos = static_cast<uint8_t*>(data);
+	void startFrame(const void *data) {
+		m_pos = static_cast<const uint8_t*>(data);
 		m_end = m_pos + m_frameSize;
 		m_buffer = 0;
+		m_bufferSize = 0;
+	}
+
+	/**
+	 * Skip over the given number of pixels, for example to start unpacking
+	 * at a particular row.
+	 */
+	void skipPixels(size_t count) {
+		size_t bits = count * m_bpp;
+		if (bits <= (size_t)m_bufferSize) {
+			m_bufferSize -= bits;
+			return;
+		}
+		bits -= m_bufferSize;
+		if (bits > 8 * (size_t)(m_end - m_pos)) {
+			throw std::runtime_error("Attempted to skip beyond the end of the input buffer");
+		}
+		m_pos += bits / 8;
+		m_bufferSize = 0;
+		if (bits % 8) {
+			m_buffer = *(m_pos++);
+			m_bufferSize = 8 - bits % 8;
+		}
 	}
 
 	int compute(ComputePos & pos) {
+		if (m_bpp == 16 && m_bufferSize == 0) {
+			if (m_end - m_pos < 2) {
+				throw std::runtime_error("Attempted to read beyond the end of the input buffer");
+			}
+			uint16_t value;
+			std::memcpy(&value, m_pos, sizeof(value));
+			m_pos += sizeof(value);
+			return value;
+		}
 		while (m_bufferSize < m_bpp) {
 			if (m_pos >= m_end) {
 				throw std::runtime_error("Attempted to read beyond the end of the input buffer");
@@ -43,15 +80,27 @@ public:
 		m_bufferSize -= m_bpp;
 		return (m_buffer >> m_bufferSize) & m_mask;
 	}
+
+	/**
+	 * Unpack the next count pixels into output. The bits per pixel must be
+	 * 16 or less.
+	 */
+	void computeRow(uint16_t * output, int count);
+
 private:
 	size_t m_frameSize;
 	int m_bpp;
 
 	int m_mask;
-	uint8_t *m_pos;
-	uint8_t *m_end;
+	const uint8_t *m_pos;
+	const uint8_t *m_end;
 	unsigned int m_buffer;
 	int m_bufferSize;
+
+	void unpackBits(uint16_t * output, int count);
+	void unpack8(uint16_t * output, int count);
+	void unpack10(uint16_t * output, int count);
+	void unpack16(uint16_t * output, int count);
 };
 
 } // namespace
@@ -3,10 +3,22 @@
 
 namespace Speckle {
 
-cv::Vec3b Visualize::compute(ComputePos & pos, double x) {
-	int index = cv::saturate_cast<uint8_t>(256. * m_minX / x);
-	const uint8_t * rgb = ColourMap::plasma[index];
-	return cv::Vec3b(rgb[2], rgb[1], rgb[0]);
+const uint8_t * Visualize::getColour(double x) const {
+	return ColourMap::plasma[getColourIndex(x)];
+}
+
+void Visualize::computeRow(const double * x, cv::Vec3b * output, int count) const {
+	for (int i = 0; i < count; i++) {
+		const uint8_t * rgb = getColour(x[i]);
+		output[i] = cv::Vec3b(rgb[2], rgb[1], rgb[0]);
+	}
+}
+
+void Visualize::computeRow(const double * x, cv::Vec4b * output, int count) const {
+	for (int i = 0; i < count; i++) {
+		const uint8_t * rgb = getColour(x[i]);
+		output[i] = cv::Vec4b(rgb[2], rgb[1], rgb[0], 0xff);
+	}
 }
 
 } // namespace
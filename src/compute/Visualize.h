@@ -12,8 +12,35 @@ public:
 		: m_minX(minX)
 	{}
 
-	cv::Vec3b compute(ComputePos & pos, double x);
+	cv::Vec3b compute(ComputePos & pos, double x) {
+		const uint8_t * rgb = getColour(x);
+		return cv::Vec3b(rgb[2], rgb[1], rgb[0]);
+	}
+
+	/**
+	 * Colourise count correlation times, writing BGR pixels
+	 */
+	void computeRow(const double * x, cv::Vec3b * output, int count) const;
+
+	/**
+	 * Colourise count correlation times, writing opaque BGRA pixels
+	 */
+	void computeRow(const double * x, cv::Vec4b * output, int count) const;
+
+	/**
+	 * Get the index into ColourMap::plasma of the colour for x
+	 */
+	int getColourIndex(double x) const {
+		return cv::saturate_cast<uint8_t>(256. * m_minX / x);
+	}
+
+	double getMinX() const {
+		return m_minX;
+	}
+
 private:
+	const uint8_t * getColour(double x) const;
+
 	double m_minX;
 };
 
@@ -0,0 +1,171 @@
+#include "compute/WindowSweep.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Speckle {
+
+WindowSweep::WindowSweep(const ComputePipeline::Options & options,
+		const std::vector<int> & windows)
+	: m_windows(windows)
+{
+	if (options.contrastMode != ComputePipeline::SPATIAL_CONTRAST) {
+		throw std::runtime_error("A window sweep needs spatial contrast");
+	}
+	if (m_windows.empty()) {
+		throw std::runtime_error("No window sizes were given");
+	}
+
+	m_stride = options.outputStride;
+	const int width = options.roi.empty() ? options.width : options.roi.width;
+	m_height = options.roi.empty() ? options.height : options.roi.height;
+	for (int window : m_windows) {
+		if (window < 1 || window > width || window > m_height) {
+			throw std::runtime_error("Invalid window size");
+		}
+		ComputePipeline::Options windowOptions = options;
+		windowOptions.spatialWindow = window;
+		// Only the stage interface is used, which ignores the threads
+		// option, so don't start threads for it
+		windowOptions.threads = 1;
+		m_pipelines.emplace_back(new ComputePipeline(windowOptions));
+	}
+	m_kSq.resize(m_windows.size());
+	m_x.resize(m_windows.size());
+
+	int threads = options.threads;
+	if (threads <= 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// Divide the frame between the bands as ComputePipeline does, by the
+	// first input row of each window. The smallest window has the most
+	// output rows.
+	const int minWindow = *std::min_element(m_windows.begin(), m_windows.end());
+	const int maxWindow = *std::max_element(m_windows.begin(), m_windows.end());
+	const bool narrow = SpatialWindow::fits(options.bitsPerPixel, maxWindow);
+	const int outputRows = m_height - minWindow + 1;
+	const int numBands = std::max(1, std::min(threads, outputRows));
+	for (int i = 0; i < numBands; i++) {
+		m_bands.emplace_back(new Band);
+		Band & band = *m_bands.back();
+		band.startRow = outputRows * i / numBands;
+		band.windowEndRow = outputRows * (i + 1) / numBands;
+		band.endRow = std::min(m_height, band.windowEndRow + maxWindow - 1);
+		if (narrow) {
+			band.window.reset(new MultiSpatialWindow(m_windows, width));
+		} else {
+			band.wideWindow.reset(new WideMultiSpatialWindow(m_windows, width));
+		}
+		band.kSqRow.resize(width);
+	}
+
+	// The thread pool is shared by the bands and, later in each frame, by
+	// the pipelines of each window size
+	threads = std::min(threads, std::max(numBands, (int)m_windows.size()));
+	if (threads > 1) {
+		m_threadPool.reset(new ThreadPool(threads - 1));
+	}
+}
+
+void WindowSweep::writeFrame(const void * data, size_t length,
+		std::vector<cv::Mat> & outputs, int format)
+{
+	const bool stats = m_pipelines[0]->isStatsEnabled();
+	m_pipelines[0]->unpackFrame(data, length, m_unpacked);
+	for (size_t i = 0; i < m_pipelines.size(); i++) {
+		m_kSq[i].create(m_pipelines[i]->getContrastSize(), CV_64FC1);
+	}
+
+	runTasks(m_bands.size(), [&](int i) {
+		contrastBand(*m_bands[i], stats);
+	});
+	if (stats) {
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		for (size_t i = 0; i < m_bands.size(); i++) {
+			m_stats.add(m_bands[i]->stats);
+			m_bands[i]->stats.clear();
+		}
+	}
+
+	outputs.resize(m_pipelines.size());
+	runTasks(m_pipelines.size(), [&](int i) {
+		m_pipelines[i]->solveFrame(m_kSq[i], m_x[i]);
+		m_pipelines[i]->colouriseFrame(m_x[i], outputs[i], format);
+	});
+}
+
+/**
+ * Call a function for each index in [0, count), in parallel if there is a
+ * thread pool
+ */
+void WindowSweep::runTasks(int count, const std::function<void(int)> & task) {
+	if (m_threadPool) {
+		m_threadPool->run(count, task);
+	} else {
+		for (int i = 0; i < count; i++) {
+			task(i);
+		}
+	}
+}
+
+/**
+ * Compute K² for all window sizes in the band's rows of the unpacked frame
+ */
+void WindowSweep::contrastBand(Band & band, bool stats) {
+	StageTimer timer(stats);
+	if (band.window) {
+		band.window->startFrame();
+	} else {
+		band.wideWindow->startFrame();
+	}
+	for (int y = band.startRow; y < band.endRow; y++) {
+		if (band.window) {
+			contrastRow(band, *band.window, y);
+		} else {
+			contrastRow(band, *band.wideWindow, y);
+		}
+	}
+	timer.lap(band.stats, PipelineStats::CONTRAST);
+}
+
+/**
+ * Add input row y to the band's window, and store the K² rows which it
+ * completes
+ */
+template <class Window>
+void WindowSweep::contrastRow(Band & band, Window & window, int y) {
+	window.addRow(m_unpacked.ptr<uint16_t>(y));
+	for (int i = 0; i < window.getWindowCount(); i++) {
+		// The output row is identified by the first input row of its window
+		const int row = y - window.getWindow(i) + 1;
+		if (row < band.startRow || row >= band.windowEndRow) {
+			// Either the window is incomplete, or the next band stores it
+			continue;
+		}
+		if (m_stride == 1) {
+			// As in ComputePipeline::contrastFrame(), this is the row of K²
+			window.computeRow(i, m_kSq[i].ptr<double>(row));
+			continue;
+		}
+		int outY = window.computeRow(i, &band.kSqRow[0]);
+		m_pipelines[i]->storeContrastRow(&band.kSqRow[0], outY + band.startRow,
+			m_kSq[i]);
+	}
+}
+
+PipelineStats WindowSweep::getStats() const {
+	PipelineStats stats;
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		stats = m_stats;
+	}
+	for (size_t i = 0; i < m_pipelines.size(); i++) {
+		stats.add(m_pipelines[i]->getStats());
+	}
+	// Each pipeline counts every frame
+	stats.frames /= m_pipelines.size();
+	return stats;
+}
+
+} // namespace
@@ -0,0 +1,113 @@
+#ifndef SPECKLE_WINDOWSWEEP_H
+#define SPECKLE_WINDOWSWEEP_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "compute/ComputePipeline.h"
+#include "compute/SpatialWindow.h"
+#include "common/OpenCvTypes.h"
+#include "common/ThreadPool.h"
+
+namespace Speckle {
+
+/**
+ * Compute spatial contrast results for several window sizes from each
+ * frame, for comparing window sizes. The frame is unpacked once, and K² for
+ * all the sizes comes from one pass of MultiSpatialWindow. Solving and
+ * colourising are done by a ComputePipeline for each size, through its
+ * stage interface, so the other options apply to each result as usual.
+ */
+class WindowSweep {
+public:
+	/**
+	 * The options must be for spatial contrast. Their spatialWindow is
+	 * replaced by each of the window sizes in turn.
+	 */
+	WindowSweep(const ComputePipeline::Options & options,
+		const std::vector<int> & windows);
+
+	/**
+	 * Write the output of each window size to the corresponding element
+	 * of outputs. As with ComputePipeline::writeFrame(), the format depends
+	 * on the output mode, and pixels without a complete window are not
+	 * written.
+	 */
+	void writeFrame(const void * data, size_t length,
+		std::vector<cv::Mat> & outputs, int format);
+
+	int getWindowCount() const {
+		return m_windows.size();
+	}
+
+	int getWindow(int i) const {
+		return m_windows[i];
+	}
+
+	/**
+	 * Get the pipeline of window size i, for example for its rejected frame
+	 * count
+	 */
+	const ComputePipeline & getPipeline(int i) const {
+		return *m_pipelines[i];
+	}
+
+	cv::Size getOutputSize() const {
+		return m_pipelines[0]->getOutputSize();
+	}
+
+	/**
+	 * Get the statistics of all window sizes together. The frame count is
+	 * the number of input frames.
+	 */
+	PipelineStats getStats() const;
+
+private:
+	/**
+	 * A horizontal band of the frame, as in ComputePipeline, with its own
+	 * contrast state and scratch row
+	 */
+	struct Band {
+		// The input rows [startRow, endRow)
+		int startRow;
+		int endRow;
+
+		// Each output row is stored by the band containing the first row
+		// of its window, so a band only stores the output rows whose window
+		// starts before this row
+		int windowEndRow;
+
+		std::unique_ptr<MultiSpatialWindow> window;
+		std::unique_ptr<WideMultiSpatialWindow> wideWindow;
+		std::vector<double> kSqRow;
+		PipelineStats stats;
+	};
+
+	void contrastBand(Band & band, bool stats);
+
+	template <class Window>
+	void contrastRow(Band & band, Window & window, int y);
+
+	void runTasks(int count, const std::function<void(int)> & task);
+
+	std::vector<int> m_windows;
+	std::vector<std::unique_ptr<ComputePipeline>> m_pipelines;
+	std::vector<std::unique_ptr<Band>> m_bands;
+	std::unique_ptr<ThreadPool> m_threadPool;
+	int m_height;
+	int m_stride;
+
+	cv::Mat m_unpacked;
+	std::vector<cv::Mat> m_kSq;
+	std::vector<cv::Mat> m_x;
+
+	// The time spent in the shared contrast pass
+	mutable std::mutex m_statsMutex;
+	PipelineStats m_stats;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef SPECKLE_ERROREVENT_H
+#define SPECKLE_ERROREVENT_H
+
+#include <QEvent>
+#include <QString>
+
+namespace Speckle {
+
+/**
+ * A fatal error in a worker thread, for the UI thread to report
+ */
+class ErrorEvent : public QEvent {
+public:
+	ErrorEvent(int type, const QString & message)
+		: QEvent((QEvent::Type)type), message(message)
+	{}
+
+	QString message;
+};
+
+} // namespace
+
+#endif
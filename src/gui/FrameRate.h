@@ -0,0 +1,52 @@
+#ifndef SPECKLE_FRAMERATE_H
+#define SPECKLE_FRAMERATE_H
+
+#include <atomic>
+#include <chrono>
+
+namespace Speckle {
+
+/**
+ * Count frames in one thread and report the rate in another
+ */
+class FrameRate {
+public:
+	FrameRate()
+		: m_count(0), m_lastCount(0), m_lastTime(Clock::now()), m_rate(0)
+	{}
+
+	/**
+	 * Count a frame. This may be called from any one thread.
+	 */
+	void tick() {
+		m_count.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Get the number of frames per second, averaged over at least one
+	 * second. Only call this from one thread.
+	 */
+	double get() {
+		Clock::time_point now = Clock::now();
+		double elapsed = std::chrono::duration<double>(now - m_lastTime).count();
+		if (elapsed >= 1.0) {
+			int count = m_count.load(std::memory_order_relaxed);
+			m_rate = (count - m_lastCount) / elapsed;
+			m_lastCount = count;
+			m_lastTime = now;
+		}
+		return m_rate;
+	}
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	std::atomic<int> m_count;
+	int m_lastCount;
+	Clock::time_point m_lastTime;
+	double m_rate;
+};
+
+} // namespace
+
+#endif
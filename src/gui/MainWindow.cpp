@@ -1,128 +1,362 @@
 #include <QLabel>
+#include <QMenuBar>
+#include <QActionGroup>
 #include <QMessageBox>
+#include <QPainter>
+#include <QStatusBar>
 #include <QCoreApplication>
+#include <QResizeEvent>
 #include "MainWindow.h"
+#include "ErrorEvent.h"
 #include "FrameEvent.h"
-#include <iostream>
+#include <algorithm>
 #include <cstring>
 
 namespace Speckle {
 
 int MainWindow::FrameEventType = -1;
+int MainWindow::ErrorEventType = -1;
 
-MainWindow::MainWindow()
+MainWindow::MainWindow(std::unique_ptr<FrameSource> source)
 	: m_label(new QLabel(this)),
-	m_done(false)
+	m_width(0),
+	m_height(0),
+	m_viewWidth(640),
+	m_viewHeight(488),
+	m_source(std::move(source)),
+	m_frameSize(0),
+	m_done(false),
+	m_droppedFrames(0),
+	m_inputPending(false),
+	m_framePosted(false),
+	m_showStats(false)
 {
 	if (FrameEventType == -1) {
 		FrameEventType = QEvent::registerEventType();
 	}
+	if (ErrorEventType == -1) {
+		ErrorEventType = QEvent::registerEventType();
+	}
 
-	m_kinectThread.reset(new std::thread( [=] {
-		kinectThreadMain();
+	m_sourceThread.reset(new std::thread( [=] {
+		sourceThreadMain();
+	}));
+	m_computeThread.reset(new std::thread( [=] {
+		computeThreadMain();
 	}));
+	QMenu * contrastMenu = menuBar()->addMenu("&Contrast");
+	QActionGroup * contrastGroup = new QActionGroup(this);
+	QAction * spatialAction = contrastGroup->addAction("&Spatial");
+	QAction * temporalAction = contrastGroup->addAction("&Temporal");
+	QAction * spatioTemporalAction = contrastGroup->addAction("Spatio-t&emporal");
+	spatialAction->setCheckable(true);
+	spatialAction->setChecked(true);
+	temporalAction->setCheckable(true);
+	spatioTemporalAction->setCheckable(true);
+	contrastMenu->addActions(contrastGroup->actions());
+	connect(spatialAction, &QAction::triggered, [=] {
+		setContrastMode(ComputePipeline::SPATIAL_CONTRAST);
+	});
+	connect(temporalAction, &QAction::triggered, [=] {
+		setContrastMode(ComputePipeline::TEMPORAL_CONTRAST);
+	});
+	connect(spatioTemporalAction, &QAction::triggered, [=] {
+		setContrastMode(ComputePipeline::SPATIOTEMPORAL_CONTRAST);
+	});
+
+	QMenu * averageMenu = menuBar()->addMenu("&Average");
+	QActionGroup * averageGroup = new QActionGroup(this);
+	QAction * noAverageAction = averageGroup->addAction("&None");
+	QAction * exponentialAction = averageGroup->addAction("&Exponential");
+	QAction * boxcarAction = averageGroup->addAction("&Boxcar");
+	noAverageAction->setCheckable(true);
+	noAverageAction->setChecked(true);
+	exponentialAction->setCheckable(true);
+	boxcarAction->setCheckable(true);
+	averageMenu->addActions(averageGroup->actions());
+	connect(noAverageAction, &QAction::triggered, [=] {
+		setAverageMode(ComputePipeline::NO_AVERAGE);
+	});
+	connect(exponentialAction, &QAction::triggered, [=] {
+		setAverageMode(ComputePipeline::EXPONENTIAL_AVERAGE);
+	});
+	connect(boxcarAction, &QAction::triggered, [=] {
+		setAverageMode(ComputePipeline::BOXCAR_AVERAGE);
+	});
+
+	QMenu * viewMenu = menuBar()->addMenu("&View");
+	QAction * statsAction = viewMenu->addAction("&Statistics");
+	statsAction->setCheckable(true);
+	connect(statsAction, &QAction::toggled, [=] (bool checked) {
+		setShowStats(checked);
+	});
+
+	setCentralWidget(m_label);
 	m_label->setMinimumSize(640, 488);
 	resize(640, 488);
 }
 
 MainWindow::~MainWindow() {
 	m_done = true;
-	if (m_kinectThread->joinable()) {
-		m_kinectThread->join();
+	m_source->stop();
+	if (m_sourceThread->joinable()) {
+		m_sourceThread->join();
+	}
+	if (m_computeThread->joinable()) {
+		m_computeThread->join();
 	}
+	std::lock_guard<std::mutex> lock(m_pipelineMutex);
+	m_pipeline.reset();
 }
 
-void MainWindow::kinectThreadMain() {
-	freenect_context *ctx;
-	freenect_device *dev;
-
-	if (freenect_init(&ctx, NULL) < 0) {
-		fatal("Error: freenect_init() failed");
+void MainWindow::sourceThreadMain() {
+	RawCaptureFormat format = m_source->getFormat();
+	if (format.samplesPerPixel != 1) {
+		fatal("Error: the source must have one sample per pixel");
 		return;
 	}
 
-	freenect_set_log_level(ctx, FREENECT_LOG_INFO);
-	
-	freenect_select_subdevices(ctx, FREENECT_DEVICE_CAMERA);
-	if (freenect_num_devices(ctx) < 1) {
-		fatal("Error: no Kinect devices found");
-		return;
+	{
+		std::lock_guard<std::mutex> lock(m_pipelineMutex);
+		m_options.width = format.width;
+		m_options.height = format.height;
+		m_options.bitsPerPixel = format.bitsPerSample;
+		m_options.frameSize = format.getFrameSize();
+		m_options.threads = 0;
+		m_options.displayOnly = true;
+		m_width = format.width;
+		m_height = format.height;
+		m_frameSize = format.getFrameSize();
+		createPipeline();
 	}
 
-	if (freenect_open_device(ctx, &dev, 0) < 0) {
-		fatal("Error: could not open device");
-		return;
+	try {
+		m_source->run([this](const void * data, uint64_t timestamp) {
+			processFrame(data, timestamp);
+		});
+	} catch (std::runtime_error & e) {
+		fatal((std::string("Error: ") + e.what()).c_str());
 	}
+}
 
-	freenect_frame_mode frameMode = freenect_find_video_mode(
-		FREENECT_RESOLUTION_MEDIUM, FREENECT_VIDEO_IR_10BIT_PACKED);
-
-	ComputePipeline::Options options;
-	options.width = frameMode.width;
-	options.height = frameMode.height;
-	options.bitsPerPixel = 10;
-	options.frameSize = options.bitsPerPixel * frameMode.width * frameMode.height / 8;
-	m_frameBuffer.create(options.frameSize, 1, CV_8UC1);
-
-	m_pipeline.reset(new ComputePipeline(options));
-
-	freenect_set_video_callback(dev, VideoCallback);
-	freenect_set_video_mode(dev, frameMode);
-	freenect_set_user(dev, (void*)this);
-	freenect_set_ir_brightness(dev, 40);
-	freenect_start_video(dev);
-
-	while (!m_done && freenect_process_events(ctx) >= 0);
-
-	freenect_stop_video(dev);
-	freenect_close_device(dev);
-	freenect_shutdown(ctx);
+void MainWindow::processFrame(const void *data, uint64_t timestamp) {
+	// Replace any frame which the compute thread hasn't picked up yet
+	std::vector<uint8_t> & buffer = m_input.getWriteBuffer();
+	buffer.assign((const uint8_t*)data, (const uint8_t*)data + m_frameSize);
+	if (!m_input.publish()) {
+		m_droppedFrames++;
+	}
+	m_cameraRate.tick();
 }
 
-void MainWindow::VideoCallback(freenect_device *dev, void *data, uint32_t timestamp) {
-	MainWindow & main = *(MainWindow*)freenect_get_user(dev);
-	main.processFrame(dev, data, timestamp);
+/**
+ * Feed the latest camera frame to the pipeline, and pass finished images
+ * to the UI thread, so that the UI thread only has to draw them
+ */
+void MainWindow::computeThreadMain() {
+	int idleCount = 0;
+	while (!m_done) {
+		bool progress;
+		try {
+			progress = computeStep();
+		} catch (std::exception & e) {
+			fatal((std::string("Error: ") + e.what()).c_str());
+			return;
+		}
+		if (progress) {
+			idleCount = 0;
+		} else {
+			backoff(idleCount);
+		}
+	}
 }
 
-void MainWindow::processFrame(freenect_device *dev, void *data, uint32_t timestamp) {
-	int bitsPerPixel = 10;
-	if (m_inFlight.load()) {
-		// Main thread has not displayed the previous frame yet
-		return;
+/**
+ * Push and pop at most one frame. Return true if anything was done.
+ */
+bool MainWindow::computeStep() {
+	std::lock_guard<std::mutex> lock(m_pipelineMutex);
+	if (!m_pipeline) {
+		return false;
 	}
-	m_inFlight++;
+	bool progress = false;
 
-	freenect_frame_mode frameMode = freenect_get_current_video_mode(dev);
-	size_t size = bitsPerPixel * frameMode.width * frameMode.height / 8;
-	std::memcpy(m_frameBuffer.ptr(0), data, size);
+	// A newer camera frame supersedes one the pipeline hasn't accepted
+	if (m_input.update()) {
+		if (m_inputPending) {
+			m_droppedFrames++;
+		}
+		m_inputPending = true;
+	}
+	if (m_inputPending) {
+		const std::vector<uint8_t> & input = m_input.getReadBuffer();
+		if (m_pipeline->push(&input[0], input.size())) {
+			m_inputPending = false;
+			progress = true;
+		}
+	}
 
-	FrameEvent * event = new FrameEvent(FrameEventType, m_frameBuffer.ptr(0),
-			size, frameMode.width, frameMode.height);
-	QCoreApplication::postEvent(this, event);
+	if (m_pipeline->pop(m_output.getWriteBuffer())) {
+		m_output.publish();
+		m_computeRate.tick();
+		if (!m_framePosted.exchange(true)) {
+			QCoreApplication::postEvent(this, new FrameEvent(FrameEventType,
+				nullptr, 0, m_width, m_height));
+		}
+		progress = true;
+	}
+	return progress;
 }
 
 void MainWindow::customEvent(QEvent * event) {
+	if (event->type() == ErrorEventType) {
+		// Stop the other threads before reporting, then close the window,
+		// which ends the application
+		m_done = true;
+		m_source->stop();
+		QMessageBox::critical(this, "Error",
+			static_cast<ErrorEvent*>(event)->message);
+		close();
+		return;
+	}
 	if (event->type() != FrameEventType) {
 		return;
 	}
-	FrameEvent * fe = static_cast<FrameEvent *>(event);
 
-	if (m_mat.empty()) {
-		m_mat.create(fe->height, fe->width, CV_8UC4);
+	// Display the most recent finished frame. The pipeline was already
+	// told to reduce it to about the size of the label.
+	m_framePosted = false;
+	if (!m_output.update()) {
+		return;
 	}
-	m_pipeline->writeFrame(fe->data, fe->size, m_mat, CV_8UC4);
+	const cv::Mat & mat = m_output.getReadBuffer();
 	QPixmap pixmap = QPixmap::fromImage(QImage(
-			m_mat.ptr(0), fe->width, fe->height, QImage::Format_RGB32));
-	if (fe->width > 640) {
-		pixmap = pixmap.scaled(pixmap.size() / 2);
+			mat.ptr(0), mat.cols, mat.rows, mat.step, QImage::Format_RGB32));
+	if (m_showStats) {
+		drawStats(pixmap);
 	}
 	m_label->setPixmap(pixmap);
-	m_inFlight--;
+	m_displayRate.tick();
+
+	QString status = QString("Camera: %1 fps  Compute: %2 fps  Display: %3 fps  "
+			"Dropped: %4")
+		.arg(m_cameraRate.get(), 0, 'f', 1)
+		.arg(m_computeRate.get(), 0, 'f', 1)
+		.arg(m_displayRate.get(), 0, 'f', 1)
+		.arg(m_droppedFrames.load());
+	{
+		std::lock_guard<std::mutex> lock(m_pipelineMutex);
+		if (m_pipeline) {
+			status += QString("  Rejected: %1  Queues:")
+				.arg(m_pipeline->getRejectedFrameCount());
+			for (int i = 0; i < FramePipeline::NUM_STAGES; i++) {
+				status += QString(" %1 %2").arg(FramePipeline::getStageName(i))
+					.arg(m_pipeline->getQueueDepth(i));
+			}
+		}
+	}
+	statusBar()->showMessage(status);
+}
+
+/**
+ * Draw the pipeline statistics over the top left of the image
+ */
+void MainWindow::drawStats(QPixmap & pixmap) {
+	PipelineStats stats;
+	{
+		std::lock_guard<std::mutex> lock(m_pipelineMutex);
+		if (!m_pipeline) {
+			return;
+		}
+		stats = m_pipeline->getStats();
+	}
+	QPainter painter(&pixmap);
+	QString text = QString::fromStdString(stats.toString()).trimmed();
+	QRect rect = painter.boundingRect(pixmap.rect().adjusted(4, 4, -4, -4),
+		Qt::AlignLeft | Qt::AlignTop, text);
+	painter.fillRect(rect.adjusted(-4, -4, 4, 4), QColor(0, 0, 0, 160));
+	painter.setPen(Qt::white);
+	painter.drawText(rect, Qt::AlignLeft | Qt::AlignTop, text);
 }
 
+/**
+ * Enable or disable statistics collection and the overlay. The statistics
+ * restart from zero each time they are enabled.
+ */
+void MainWindow::setShowStats(bool show) {
+	m_showStats = show;
+	std::lock_guard<std::mutex> lock(m_pipelineMutex);
+	m_options.stats = show;
+	if (m_pipeline) {
+		m_pipeline->resetStats();
+		m_pipeline->setStatsEnabled(show);
+	}
+}
+
+/**
+ * If the label size changes enough to need a different output stride,
+ * replace the pipeline
+ */
+void MainWindow::resizeEvent(QResizeEvent * event) {
+	QMainWindow::resizeEvent(event);
+	m_viewWidth = m_label->width();
+	m_viewHeight = m_label->height();
+
+	std::lock_guard<std::mutex> lock(m_pipelineMutex);
+	if (m_pipeline && getOutputStride() != m_options.outputStride) {
+		createPipeline();
+	}
+}
+
+/**
+ * Get the largest output stride which still gives an image at least as
+ * large as the label in one dimension
+ */
+int MainWindow::getOutputStride() const {
+	if (m_viewWidth <= 0 || m_viewHeight <= 0) {
+		return 1;
+	}
+	return std::max(1, std::min(m_width / m_viewWidth, m_height / m_viewHeight));
+}
+
+/**
+ * Replace the pipeline with one using the given contrast mode. Frames in
+ * flight in the old pipeline are discarded.
+ */
+void MainWindow::setContrastMode(ComputePipeline::ContrastMode mode) {
+	std::lock_guard<std::mutex> lock(m_pipelineMutex);
+	m_options.contrastMode = mode;
+	if (m_pipeline) {
+		createPipeline();
+	}
+}
+
+/**
+ * Replace the pipeline with one using the given rolling average mode
+ */
+void MainWindow::setAverageMode(ComputePipeline::AverageMode mode) {
+	std::lock_guard<std::mutex> lock(m_pipelineMutex);
+	m_options.averageMode = mode;
+	if (m_pipeline) {
+		createPipeline();
+	}
+}
+
+/**
+ * Create the pipeline from m_options. The caller must hold m_pipelineMutex.
+ */
+void MainWindow::createPipeline() {
+	m_pipeline.reset();
+	m_options.outputStride = getOutputStride();
+	m_pipeline.reset(new FramePipeline(m_options, CV_8UC4, 4));
+}
 
+/**
+ * Report an error and close the window. This may be called from any
+ * thread: the UI thread shows the message when it handles the event.
+ */
 void MainWindow::fatal(const char * message) {
-	QMessageBox::critical(nullptr, "Error", message);
+	QCoreApplication::postEvent(this, new ErrorEvent(ErrorEventType, message));
 }
 
 } // namespace
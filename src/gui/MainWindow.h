@@ -5,41 +5,90 @@
 #include <thread>
 #include <memory>
 #include <atomic>
-#include <libfreenect.h>
+#include <mutex>
 #include <opencv2/core/core.hpp>
-#include "compute/ComputePipeline.h"
+#include <vector>
+#include "compute/FramePipeline.h"
+#include "common/TripleBuffer.h"
+#include "source/FrameSource.h"
+#include "gui/FrameRate.h"
 
 QT_BEGIN_NAMESPACE
 class QLabel;
+class QPixmap;
 QT_END_NAMESPACE
 
 namespace Speckle {
 
 class MainWindow : public QMainWindow {
 public:
-	MainWindow();
+	/**
+	 * Show frames from the given source, which is run in its own thread
+	 */
+	MainWindow(std::unique_ptr<FrameSource> source);
 	~MainWindow();
 	virtual void customEvent(QEvent * event);
 
+protected:
+	virtual void resizeEvent(QResizeEvent * event);
+
 private:
-	void kinectThreadMain();
-	static void VideoCallback(freenect_device *dev, void *data, uint32_t timestamp);
-	void processFrame(freenect_device *dev, void *data, uint32_t timestamp);
+	void sourceThreadMain();
+	void processFrame(const void *data, uint64_t timestamp);
+	void computeThreadMain();
+	bool computeStep();
 	void fatal(const char * message);
+	void setContrastMode(ComputePipeline::ContrastMode mode);
+	void setAverageMode(ComputePipeline::AverageMode mode);
+	void setShowStats(bool show);
+	void drawStats(QPixmap & pixmap);
+	void createPipeline();
+	int getOutputStride() const;
 
 	QLabel * m_label;
 
-	cv::Mat m_frameBuffer;
-	cv::Mat m_mat;
-	int m_input;
-	int m_display;
+	std::atomic<int> m_width;
+	std::atomic<int> m_height;
+
+	// The size of the label which shows the image
+	std::atomic<int> m_viewWidth;
+	std::atomic<int> m_viewHeight;
+
+	std::unique_ptr<FrameSource> m_source;
+	size_t m_frameSize;
+	std::unique_ptr<std::thread> m_sourceThread;
+	std::unique_ptr<std::thread> m_computeThread;
+	ComputePipeline::Options m_options;
+
+	// Guards m_pipeline, which is replaced when the options change
+	std::mutex m_pipelineMutex;
+	std::unique_ptr<FramePipeline> m_pipeline;
+	std::atomic<bool> m_done;
+	std::atomic<int> m_droppedFrames;
+
+	// The latest camera frame, from the source thread to the compute thread
+	TripleBuffer<std::vector<uint8_t>> m_input;
+
+	// True if the compute thread has an input frame which the pipeline
+	// has not yet accepted
+	bool m_inputPending;
+
+	// The latest finished image, from the compute thread to the UI thread
+	TripleBuffer<cv::Mat> m_output;
+
+	// True if a FrameEvent has been posted and not yet handled
+	std::atomic<bool> m_framePosted;
+
+	// Whether to draw the pipeline statistics over the image. This is
+	// only used by the UI thread.
+	bool m_showStats;
 
-	std::unique_ptr<std::thread> m_kinectThread;
-	std::unique_ptr<ComputePipeline> m_pipeline;
-	bool m_done;
-	std::atomic<int> m_inFlight;
+	FrameRate m_cameraRate;
+	FrameRate m_computeRate;
+	FrameRate m_displayRate;
 
 	static int FrameEventType;
+	static int ErrorEventType;
 };
 
 } // namespace
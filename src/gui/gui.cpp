@@ -1,10 +1,62 @@
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QMessageBox>
 #include "MainWindow.h"
+#include "source/KinectSource.h"
+#include "source/ReplaySource.h"
+#include "source/SyntheticSource.h"
+
+using namespace Speckle;
+
+/**
+ * Create the frame source selected on the command line
+ */
+std::unique_ptr<FrameSource> createSource(const QCommandLineParser & parser) {
+	if (parser.isSet("replay")) {
+		ReplaySource::Options options;
+		options.realTime = !parser.isSet("fast");
+		options.loop = true;
+		return std::unique_ptr<FrameSource>(new ReplaySource(
+			parser.value("replay").toStdString(), options));
+	}
+
+	KinectSource::Options options;
+	options.brightness = 40;
+	if (parser.isSet("synthetic")) {
+		SyntheticSource::Options syntheticOptions;
+		syntheticOptions.format = KinectSource(options).getFormat();
+		if (parser.isSet("fast")) {
+			syntheticOptions.frameRate = 0;
+		}
+		return std::unique_ptr<FrameSource>(new SyntheticSource(syntheticOptions));
+	}
+	return std::unique_ptr<FrameSource>(new KinectSource(options));
+}
 
 int main(int argc, char **argv) {
 	QApplication app(argc, argv);
-	Speckle::MainWindow mainWindow;
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption(QCommandLineOption("replay",
+		"Show a TIFF or raw capture, repeatedly, instead of the Kinect stream.",
+		"file"));
+	parser.addOption(QCommandLineOption("synthetic",
+		"Show generated frames instead of the Kinect stream."));
+	parser.addOption(QCommandLineOption("fast",
+		"Deliver replayed or generated frames as fast as possible, rather "
+		"than at the recorded rate or 30 fps."));
+	parser.process(app);
+
+	std::unique_ptr<FrameSource> source;
+	try {
+		source = createSource(parser);
+	} catch (std::runtime_error & e) {
+		QMessageBox::critical(nullptr, "Error", e.what());
+		return 1;
+	}
+
+	Speckle::MainWindow mainWindow(std::move(source));
 	mainWindow.show();
 	return app.exec();
 }
-
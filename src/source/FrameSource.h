@@ -0,0 +1,79 @@
+#ifndef SPECKLE_FRAMESOURCE_H
+#define SPECKLE_FRAMESOURCE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include "common/RawCapture.h"
+
+namespace Speckle {
+
+/**
+ * A stream of frames of a fixed format, from a camera, a file or a
+ * generator. Frames are delivered to a callback from the thread which calls
+ * run().
+ */
+class FrameSource {
+public:
+	/**
+	 * The frame callback. The data is format.getFrameSize() bytes long, and
+	 * is only valid until the callback returns.
+	 */
+	typedef std::function<void(const void * data, uint64_t timestamp)> Callback;
+
+	/**
+	 * The rate of the device clock used for frame timestamps. libfreenect
+	 * passes through the Kinect's timestamps, which count at this rate, and
+	 * the other sources use the same units.
+	 */
+	static const int TIMESTAMP_RATE = 60000000;
+
+	FrameSource()
+		: m_stopping(false)
+	{}
+
+	virtual ~FrameSource() {}
+
+	/**
+	 * Get the format of the frames
+	 */
+	virtual RawCaptureFormat getFormat() const = 0;
+
+	/**
+	 * Deliver frames to the callback until the source is exhausted or
+	 * stop() is called. Throw std::runtime_error on failure.
+	 */
+	virtual void run(const Callback & callback) = 0;
+
+	/**
+	 * Make run() return as soon as possible. This may be called from any
+	 * thread, including from the callback.
+	 */
+	void stop() {
+		m_stopping = true;
+	}
+
+	/**
+	 * Get the number of timestamp ticks between two frames. Kinect
+	 * timestamps are 32 bits, so a decrease is taken to be a wraparound.
+	 */
+	static uint64_t getInterval(uint64_t previous, uint64_t current) {
+		if (current < previous) {
+			return (uint32_t)(current - previous);
+		}
+		return current - previous;
+	}
+
+protected:
+	bool isStopping() const {
+		return m_stopping;
+	}
+
+private:
+	std::atomic<bool> m_stopping;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,105 @@
+#include "source/KinectSource.h"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace Speckle {
+
+KinectSource::KinectSource(const Options & options)
+	: m_options(options), m_callback(nullptr)
+{
+	freenect_frame_mode frameMode = freenect_find_video_mode(
+		m_options.resolution, m_options.mode);
+	if (!frameMode.is_valid) {
+		throw std::runtime_error("Unable to set that combination of resolution and mode");
+	}
+	m_format.width = frameMode.width;
+	m_format.height = frameMode.height;
+	m_format.samplesPerPixel = 1;
+	m_format.bayer = false;
+
+	switch (m_options.mode) {
+		case FREENECT_VIDEO_RGB:
+			m_format.samplesPerPixel = 3;
+			m_format.bitsPerSample = 8;
+			break;
+		case FREENECT_VIDEO_BAYER:
+			m_format.bitsPerSample = 8;
+			m_format.bayer = true;
+			break;
+		case FREENECT_VIDEO_IR_8BIT:
+			m_format.bitsPerSample = 8;
+			break;
+		case FREENECT_VIDEO_IR_10BIT_PACKED:
+			m_format.bitsPerSample = 10;
+			break;
+		case FREENECT_VIDEO_IR_10BIT:
+			m_format.bitsPerSample = 16;
+			break;
+		default:
+			throw std::runtime_error("Invalid mode");
+	}
+}
+
+void KinectSource::run(const Callback & callback) {
+	freenect_context *ctx;
+	if (freenect_init(&ctx, NULL) < 0) {
+		throw std::runtime_error("freenect_init() failed");
+	}
+	m_callback = &callback;
+	try {
+		runDevice(ctx);
+	} catch (...) {
+		freenect_shutdown(ctx);
+		throw;
+	}
+	freenect_shutdown(ctx);
+}
+
+void KinectSource::runDevice(freenect_context * ctx) {
+	freenect_set_log_level(ctx, m_options.logLevel);
+	freenect_set_log_callback(ctx, LogCallback);
+
+	freenect_select_subdevices(ctx, FREENECT_DEVICE_CAMERA);
+	if (freenect_num_devices(ctx) < 1) {
+		throw std::runtime_error("No Kinect devices found");
+	}
+
+	freenect_device *dev;
+	if (freenect_open_device(ctx, &dev, 0) < 0) {
+		throw std::runtime_error("Could not open device");
+	}
+
+	// FIXME: it's not possible to set the brightness in high-resolution mode.
+	// It is overridden when the video starts, and then attempts to set it
+	// after that respond with an error.
+	if (m_options.mode == FREENECT_VIDEO_IR_8BIT
+			|| m_options.mode == FREENECT_VIDEO_IR_10BIT_PACKED
+			|| m_options.mode == FREENECT_VIDEO_IR_10BIT)
+	{
+		freenect_set_ir_brightness(dev, (uint16_t)m_options.brightness);
+	}
+
+	freenect_set_video_callback(dev, VideoCallback);
+	freenect_set_video_mode(dev, freenect_find_video_mode(m_options.resolution, m_options.mode));
+	freenect_set_user(dev, (void*)this);
+	freenect_start_video(dev);
+
+	while (!isStopping() && freenect_process_events(ctx) >= 0);
+
+	freenect_stop_video(dev);
+	freenect_close_device(dev);
+}
+
+void KinectSource::VideoCallback(freenect_device *dev, void *data, uint32_t timestamp) {
+	KinectSource & source = *(KinectSource*)freenect_get_user(dev);
+	if (!source.isStopping()) {
+		(*source.m_callback)(data, timestamp);
+	}
+}
+
+void KinectSource::LogCallback(freenect_context *dev, freenect_loglevel level, const char *msg) {
+	std::cerr << msg;
+}
+
+} // namespace
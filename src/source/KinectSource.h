@@ -0,0 +1,58 @@
+#ifndef SPECKLE_KINECTSOURCE_H
+#define SPECKLE_KINECTSOURCE_H
+
+#include <libfreenect.h>
+
+#include "source/FrameSource.h"
+
+namespace Speckle {
+
+/**
+ * Frames from the video stream of the first Kinect, via libfreenect
+ */
+class KinectSource : public FrameSource {
+public:
+	struct Options {
+		Options()
+			: resolution(FREENECT_RESOLUTION_MEDIUM),
+			mode(FREENECT_VIDEO_IR_10BIT_PACKED),
+			brightness(10),
+			logLevel(FREENECT_LOG_INFO)
+		{}
+
+		freenect_resolution resolution;
+		freenect_video_format mode;
+
+		// The output power of the IR projector, between 0 and 50. This is
+		// only set in the IR modes.
+		int brightness;
+
+		freenect_loglevel logLevel;
+	};
+
+	/**
+	 * Throw std::runtime_error if the combination of resolution and mode is
+	 * not supported
+	 */
+	KinectSource(const Options & options);
+
+	virtual RawCaptureFormat getFormat() const {
+		return m_format;
+	}
+
+	virtual void run(const Callback & callback);
+
+private:
+	static void VideoCallback(freenect_device *dev, void *data, uint32_t timestamp);
+	static void LogCallback(freenect_context *dev, freenect_loglevel level, const char *msg);
+
+	void runDevice(freenect_context * ctx);
+
+	Options m_options;
+	RawCaptureFormat m_format;
+	const Callback * m_callback;
+};
+
+} // namespace
+
+#endif
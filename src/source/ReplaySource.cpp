@@ -0,0 +1,92 @@
+#include "source/ReplaySource.h"
+#include "source/TiffFormat.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+namespace Speckle {
+
+ReplaySource::ReplaySource(const std::string & fileName, const Options & options)
+	: m_options(options), m_tif(nullptr)
+{
+	if (RawCaptureReader::isRawCapture(fileName)) {
+		m_raw.reset(new RawCaptureReader(fileName));
+		m_format = m_raw->getFormat();
+		return;
+	}
+
+	m_tif = TIFFOpen(fileName.c_str(), "r");
+	if (!m_tif) {
+		throw std::runtime_error("Unable to open input file");
+	}
+	try {
+		m_format = getTiffFormat(m_tif);
+	} catch (...) {
+		TIFFClose(m_tif);
+		throw;
+	}
+	m_buffer.resize(m_format.getFrameSize());
+}
+
+ReplaySource::~ReplaySource() {
+	if (m_tif) {
+		TIFFClose(m_tif);
+	}
+}
+
+/**
+ * Get the frame with the given index. Return false if there is no such
+ * frame. TIFF pages can only be read in order.
+ */
+bool ReplaySource::readFrame(size_t index, const void *& data, uint64_t & timestamp) {
+	if (m_raw) {
+		if (index >= m_raw->getFrameCount()) {
+			return false;
+		}
+		data = m_raw->getFrame(index);
+		timestamp = m_raw->getTimestamp(index);
+		return true;
+	}
+
+	if (index == 0) {
+		if (!TIFFSetDirectory(m_tif, 0)) {
+			throw std::runtime_error("Error reading TIFF file");
+		}
+	} else if (!TIFFReadDirectory(m_tif)) {
+		return false;
+	}
+	readTiffFrame(m_tif, m_format, &m_buffer[0]);
+	data = &m_buffer[0];
+	timestamp = getTiffTimestamp(m_tif);
+	return true;
+}
+
+void ReplaySource::run(const Callback & callback) {
+	typedef std::chrono::steady_clock Clock;
+	const std::chrono::duration<double> tick(1.0 / TIMESTAMP_RATE);
+
+	bool haveFrames = false;
+	do {
+		Clock::time_point start = Clock::now();
+		uint64_t elapsed = 0;
+		uint64_t previous = 0;
+		const void * data;
+		uint64_t timestamp;
+		for (size_t i = 0; !isStopping() && readFrame(i, data, timestamp); i++) {
+			haveFrames = true;
+			if (m_options.realTime) {
+				if (i > 0) {
+					uint64_t interval = getInterval(previous, timestamp);
+					elapsed += interval ? interval : DEFAULT_INTERVAL;
+				}
+				std::this_thread::sleep_until(start
+					+ std::chrono::duration_cast<Clock::duration>(tick * (double)elapsed));
+			}
+			previous = timestamp;
+			callback(data, timestamp);
+		}
+	} while (m_options.loop && haveFrames && !isStopping());
+}
+
+} // namespace
@@ -0,0 +1,65 @@
+#ifndef SPECKLE_REPLAYSOURCE_H
+#define SPECKLE_REPLAYSOURCE_H
+
+#include <memory>
+#include <string>
+#include <tiffio.h>
+#include <vector>
+
+#include "source/FrameSource.h"
+
+namespace Speckle {
+
+/**
+ * Frames from a raw capture or a multi-page TIFF file
+ */
+class ReplaySource : public FrameSource {
+public:
+	struct Options {
+		Options()
+			: realTime(true), loop(false)
+		{}
+
+		// If true, deliver frames at the rate they were recorded, using
+		// their timestamps. Otherwise deliver them as fast as the callback
+		// accepts them.
+		bool realTime;
+
+		// Start again from the first frame after the last one
+		bool loop;
+	};
+
+	/**
+	 * Open the file. Throw std::runtime_error if it can't be opened or its
+	 * first frame has an unsupported format.
+	 */
+	ReplaySource(const std::string & fileName, const Options & options);
+	~ReplaySource();
+
+	ReplaySource(const ReplaySource &) = delete;
+	ReplaySource & operator=(const ReplaySource &) = delete;
+
+	virtual RawCaptureFormat getFormat() const {
+		return m_format;
+	}
+
+	virtual void run(const Callback & callback);
+
+	/**
+	 * The frame interval assumed when the file has no timestamps
+	 */
+	static const int DEFAULT_INTERVAL = TIMESTAMP_RATE / 30;
+
+private:
+	bool readFrame(size_t index, const void *& data, uint64_t & timestamp);
+
+	Options m_options;
+	RawCaptureFormat m_format;
+	std::unique_ptr<RawCaptureReader> m_raw;
+	TIFF * m_tif;
+	std::vector<uint8_t> m_buffer;
+};
+
+} // namespace
+
+#endif
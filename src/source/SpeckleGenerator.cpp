@@ -0,0 +1,325 @@
+#include "source/SpeckleGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "compute/CorrelationTime.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Speckle {
+
+/**
+ * Advance count pixels of the field by one sample, mixing in the given
+ * noise, and add the resulting intensity to sum
+ */
+static void addSample(float * re, float * im, float * sum,
+		const float * noiseRe, const float * noiseIm,
+		float rho, float noise, int count)
+{
+	int x = 0;
+#if defined(__AVX2__)
+	const __m256 rhoVec = _mm256_set1_ps(rho);
+	const __m256 noiseVec = _mm256_set1_ps(noise);
+	for (; x + 8 <= count; x += 8) {
+		__m256 r = _mm256_add_ps(_mm256_mul_ps(rhoVec, _mm256_loadu_ps(re + x)),
+			_mm256_mul_ps(noiseVec, _mm256_loadu_ps(noiseRe + x)));
+		__m256 i = _mm256_add_ps(_mm256_mul_ps(rhoVec, _mm256_loadu_ps(im + x)),
+			_mm256_mul_ps(noiseVec, _mm256_loadu_ps(noiseIm + x)));
+		_mm256_storeu_ps(re + x, r);
+		_mm256_storeu_ps(im + x, i);
+		_mm256_storeu_ps(sum + x, _mm256_add_ps(_mm256_loadu_ps(sum + x),
+			_mm256_add_ps(_mm256_mul_ps(r, r), _mm256_mul_ps(i, i))));
+	}
+#elif defined(__SSE2__)
+	const __m128 rhoVec = _mm_set1_ps(rho);
+	const __m128 noiseVec = _mm_set1_ps(noise);
+	for (; x + 4 <= count; x += 4) {
+		__m128 r = _mm_add_ps(_mm_mul_ps(rhoVec, _mm_loadu_ps(re + x)),
+			_mm_mul_ps(noiseVec, _mm_loadu_ps(noiseRe + x)));
+		__m128 i = _mm_add_ps(_mm_mul_ps(rhoVec, _mm_loadu_ps(im + x)),
+			_mm_mul_ps(noiseVec, _mm_loadu_ps(noiseIm + x)));
+		_mm_storeu_ps(re + x, r);
+		_mm_storeu_ps(im + x, i);
+		_mm_storeu_ps(sum + x, _mm_add_ps(_mm_loadu_ps(sum + x),
+			_mm_add_ps(_mm_mul_ps(r, r), _mm_mul_ps(i, i))));
+	}
+#endif
+	for (; x < count; x++) {
+		re[x] = rho * re[x] + noise * noiseRe[x];
+		im[x] = rho * im[x] + noise * noiseIm[x];
+		sum[x] += re[x] * re[x] + im[x] * im[x];
+	}
+}
+
+SpeckleGenerator::SpeckleGenerator(const Options & options)
+	: m_options(options),
+	m_random(options.seed),
+	m_started(false)
+{
+	if (m_options.width <= 0 || m_options.height <= 0) {
+		throw std::runtime_error("Invalid frame size");
+	}
+	if (m_options.bitsPerSample < 1 || m_options.bitsPerSample > 16) {
+		throw std::runtime_error("Invalid bits per sample");
+	}
+	if (m_options.depth == 0) {
+		m_options.depth = m_options.bitsPerSample;
+	}
+	if (m_options.depth < 1 || m_options.depth > m_options.bitsPerSample) {
+		throw std::runtime_error("Invalid sample depth");
+	}
+	if (m_options.speckleSize < 1) {
+		throw std::runtime_error("Invalid speckle size");
+	}
+	if (m_options.exposure <= 0 || m_options.correlationTime <= 0
+		|| m_options.frameRate <= 0 || m_options.exposure > 1.0 / m_options.frameRate)
+	{
+		throw std::runtime_error("Invalid exposure, correlation time or frame rate");
+	}
+	if (m_options.meanIntensity <= 0) {
+		throw std::runtime_error("Invalid mean intensity");
+	}
+	if (m_options.subExposures < 0) {
+		throw std::runtime_error("Invalid number of sub-exposures");
+	}
+
+	// Find the squared correlation r between samples which gives the
+	// variance of a continuous exposure. The discrete K² increases with r,
+	// from 1/n with independent samples to 1 with a constant field.
+	const double kSq = getKSquared(getX());
+	if (m_options.subExposures == 0) {
+		m_options.subExposures = std::max(8, (int)std::ceil(2 / kSq));
+	}
+	const int n = m_options.subExposures;
+	if (kSq < getDiscreteKSquared(0, n)) {
+		throw std::runtime_error("Too few sub-exposures for the ratio of exposure "
+			"time to correlation time");
+	}
+	double lo = 0, hi = 1;
+	for (int i = 0; i < 100; i++) {
+		double mid = (lo + hi) / 2;
+		if (getDiscreteKSquared(mid, n) < kSq) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	m_rho = std::sqrt(lo);
+	m_maxValue = (1 << m_options.depth) - 1;
+	m_scale = m_options.meanIntensity * m_maxValue / n;
+	m_noise = std::sqrt(1 - lo);
+
+	const double gap = 1.0 / m_options.frameRate - m_options.exposure
+		+ m_options.exposure / n;
+	m_gapRho = std::exp(-gap / m_options.correlationTime);
+	m_gapNoise = std::sqrt(1 - (double)m_gapRho * m_gapRho);
+
+	const size_t area = (size_t)m_options.width * m_options.height;
+	m_fieldRe.resize(area);
+	m_fieldIm.resize(area);
+	m_samples.resize(area);
+	m_offsets.resize(n + 1);
+	createPool();
+
+	int threads = m_options.threads;
+	if (threads <= 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	m_numTasks = std::min(threads * 4, m_options.height);
+	if (threads > 1) {
+		m_threadPool.reset(new ThreadPool(threads - 1));
+	}
+}
+
+RawCaptureFormat SpeckleGenerator::getFormat() const {
+	RawCaptureFormat format;
+	format.width = m_options.width;
+	format.height = m_options.height;
+	format.bitsPerSample = m_options.bitsPerSample;
+	return format;
+}
+
+/**
+ * Get K² of the mean of n samples of the intensity, where the squared
+ * field correlation between consecutive samples is r
+ */
+double SpeckleGenerator::getDiscreteKSquared(double r, int n) {
+	double sum = 0;
+	double power = 1;
+	for (int k = 1; k < n; k++) {
+		power *= r;
+		sum += (1.0 - (double)k / n) * power;
+	}
+	return (1 + 2 * sum) / n;
+}
+
+/**
+ * Fill the pool with complex Gaussian noise of unit mean intensity, averaged
+ * over a box of the speckle size
+ */
+void SpeckleGenerator::createPool() {
+	const int size = m_options.speckleSize;
+	m_poolWidth = m_options.width + POOL_MARGIN;
+	m_poolHeight = m_options.height + POOL_MARGIN;
+	const int noiseWidth = m_poolWidth + size - 1;
+	const int noiseHeight = m_poolHeight + size - 1;
+
+	std::normal_distribution<float> normal(0, std::sqrt(0.5));
+	std::vector<float> noise((size_t)noiseWidth * noiseHeight);
+	std::vector<float> rowSums((size_t)m_poolWidth * noiseHeight);
+	for (std::vector<float> * pool : {&m_poolRe, &m_poolIm}) {
+		for (size_t i = 0; i < noise.size(); i++) {
+			noise[i] = normal(m_random);
+		}
+		for (int y = 0; y < noiseHeight; y++) {
+			const float * in = &noise[(size_t)y * noiseWidth];
+			float * out = &rowSums[(size_t)y * m_poolWidth];
+			for (int x = 0; x < m_poolWidth; x++) {
+				float sum = 0;
+				for (int i = 0; i < size; i++) {
+					sum += in[x + i];
+				}
+				out[x] = sum;
+			}
+		}
+		pool->resize((size_t)m_poolWidth * m_poolHeight);
+		for (int y = 0; y < m_poolHeight; y++) {
+			float * out = &(*pool)[(size_t)y * m_poolWidth];
+			for (int x = 0; x < m_poolWidth; x++) {
+				float sum = 0;
+				for (int i = 0; i < size; i++) {
+					sum += rowSums[(size_t)(y + i) * m_poolWidth + x];
+				}
+				out[x] = sum / size;
+			}
+		}
+	}
+}
+
+/**
+ * Choose the pool offsets for the next frame. Offsets closer than the
+ * speckle size would give correlated noise, so they are avoided.
+ */
+void SpeckleGenerator::chooseOffsets() {
+	std::uniform_int_distribution<int> dist(0, POOL_MARGIN);
+	const int size = m_options.speckleSize;
+	for (size_t i = 0; i < m_offsets.size(); i++) {
+		Offset & offset = m_offsets[i];
+		for (int attempt = 0; attempt < 100; attempt++) {
+			offset.x = dist(m_random);
+			offset.y = dist(m_random);
+			bool close = false;
+			for (size_t j = 0; j < i && !close; j++) {
+				close = std::abs(offset.x - m_offsets[j].x) < size
+					&& std::abs(offset.y - m_offsets[j].y) < size;
+			}
+			if (!close) {
+				break;
+			}
+		}
+	}
+}
+
+void SpeckleGenerator::generate(void * output) {
+	chooseOffsets();
+	const int tasks = m_numTasks;
+	const int height = m_options.height;
+	auto task = [&](int i) {
+		for (int y = height * i / tasks; y < height * (i + 1) / tasks; y++) {
+			generateRow(y);
+		}
+	};
+	if (m_threadPool) {
+		m_threadPool->run(tasks, task);
+	} else {
+		for (int i = 0; i < tasks; i++) {
+			task(i);
+		}
+	}
+	m_started = true;
+	pack(static_cast<uint8_t*>(output));
+}
+
+/**
+ * Advance the field of row y through the gap and the exposure, and write
+ * the quantised integrated intensity to m_samples
+ */
+void SpeckleGenerator::generateRow(int y) {
+	// The first frame starts from independent noise
+	const float gapRho = m_started ? m_gapRho : 0;
+	const float gapNoise = m_started ? m_gapNoise : 1;
+	const int width = m_options.width;
+	float * fieldRe = &m_fieldRe[(size_t)y * width];
+	float * fieldIm = &m_fieldIm[(size_t)y * width];
+	uint16_t * samples = &m_samples[(size_t)y * width];
+
+	// Work on blocks small enough for the field and the sum to stay in the
+	// L1 cache while each sample is added
+	const int blockSize = 256;
+	float sum[blockSize];
+	for (int start = 0; start < width; start += blockSize) {
+		const int count = std::min(blockSize, width - start);
+		float * re = fieldRe + start;
+		float * im = fieldIm + start;
+		std::fill(sum, sum + count, 0.f);
+		for (size_t k = 0; k < m_offsets.size(); k++) {
+			const size_t poolPos = (size_t)(y + m_offsets[k].y) * m_poolWidth
+				+ m_offsets[k].x + start;
+			const float * noiseRe = &m_poolRe[poolPos];
+			const float * noiseIm = &m_poolIm[poolPos];
+			if (k == 0) {
+				for (int x = 0; x < count; x++) {
+					re[x] = gapRho * re[x] + gapNoise * noiseRe[x];
+					im[x] = gapRho * im[x] + gapNoise * noiseIm[x];
+				}
+				continue;
+			}
+			addSample(re, im, sum, noiseRe, noiseIm, m_rho, m_noise, count);
+		}
+		for (int x = 0; x < count; x++) {
+			float value = std::min(sum[x] * m_scale + 0.5f, m_maxValue + 0.5f);
+			samples[start + x] = (uint16_t)value;
+		}
+	}
+}
+
+/**
+ * Pack m_samples in the format read by Unpack
+ */
+void SpeckleGenerator::pack(uint8_t * output) {
+	const int bits = m_options.bitsPerSample;
+	const size_t size = getFormat().getFrameSize();
+	if (bits == 16) {
+		std::memcpy(output, &m_samples[0], size);
+		return;
+	}
+	if (bits == 8) {
+		for (size_t i = 0; i < size; i++) {
+			output[i] = m_samples[i];
+		}
+		return;
+	}
+	uint32_t buffer = 0;
+	int bufferSize = 0;
+	size_t pos = 0;
+	for (size_t i = 0; i < m_samples.size(); i++) {
+		buffer = (buffer << bits) | m_samples[i];
+		bufferSize += bits;
+		while (bufferSize >= 8) {
+			bufferSize -= 8;
+			output[pos++] = buffer >> bufferSize;
+		}
+	}
+	if (bufferSize && pos < size) {
+		output[pos] = buffer << (8 - bufferSize);
+	}
+}
+
+} // namespace
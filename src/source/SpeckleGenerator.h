@@ -0,0 +1,157 @@
+#ifndef SPECKLE_SPECKLEGENERATOR_H
+#define SPECKLE_SPECKLEGENERATOR_H
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "common/RawCapture.h"
+#include "common/ThreadPool.h"
+
+namespace Speckle {
+
+/**
+ * Simulate frames of fully developed speckle with a known correlation time,
+ * for testing the accuracy and speed of the pipeline.
+ *
+ * The field at each pixel is a circular complex Gaussian, the limit of a
+ * sum of many random phasors. Its spatial correlation comes from averaging
+ * white noise over a speckleSize × speckleSize box, and its temporal
+ * correlation decays exponentially, as assumed by CorrelationTime.
+ *
+ * The exposure is integrated over subExposures samples of the field. The
+ * field decorrelation between samples is chosen so that the variance of
+ * the integrated intensity is exactly that of a continuous exposure, so
+ * that K² is getKSquared(x) with β = 1, however few samples are used.
+ */
+class SpeckleGenerator {
+public:
+	struct Options {
+		Options()
+			: width(640), height(488), bitsPerSample(10), depth(0),
+			speckleSize(1),
+			exposure(0.01),
+			correlationTime(0.01),
+			frameRate(30),
+			meanIntensity(0.125),
+			subExposures(0),
+			threads(1),
+			seed(1)
+		{}
+
+		int width;
+		int height;
+
+		// The sample size in the output: 8, 10 (packed) or 16 bits. The
+		// other sizes accepted by Unpack also work.
+		int bitsPerSample;
+
+		// The number of significant bits in each sample, or 0 for
+		// bitsPerSample. The Kinect's 16-bit IR mode has 10.
+		int depth;
+
+		// The speckle diameter in pixels. With 1, neighbouring pixels are
+		// independent.
+		int speckleSize;
+
+		// The exposure time and the correlation time, in seconds. Their
+		// ratio is the x recovered by CorrelationTime.
+		double exposure;
+		double correlationTime;
+
+		// The frame rate, which determines the decorrelation between frames
+		double frameRate;
+
+		// The mean intensity as a proportion of the full scale. Samples
+		// above the full scale are clipped, which reduces K².
+		double meanIntensity;
+
+		// The number of samples of the field in each exposure, which must
+		// be somewhat larger than x, or 0 to choose a number which is. More
+		// samples make the intensity distribution more accurate, but the
+		// time taken is proportional to the number.
+		int subExposures;
+
+		// The number of threads, or 0 for one per CPU
+		int threads;
+
+		uint32_t seed;
+	};
+
+	/**
+	 * Throw std::runtime_error if the options are invalid
+	 */
+	SpeckleGenerator(const Options & options);
+
+	RawCaptureFormat getFormat() const;
+
+	/**
+	 * Get the ratio of exposure time to correlation time
+	 */
+	double getX() const {
+		return m_options.exposure / m_options.correlationTime;
+	}
+
+	/**
+	 * Write the next frame to output, which must be getFormat().getFrameSize()
+	 * bytes long
+	 */
+	void generate(void * output);
+
+private:
+	struct Offset {
+		int x;
+		int y;
+	};
+
+	void createPool();
+	void chooseOffsets();
+	void generateRow(int y);
+	void pack(uint8_t * output);
+	static double getDiscreteKSquared(double r, int n);
+
+	Options m_options;
+	int m_maxValue;
+	float m_scale;
+
+	// The field correlation between consecutive samples within an
+	// exposure, and the corresponding weight of the new noise
+	float m_rho;
+	float m_noise;
+
+	// The same for the interval between the last sample of one exposure
+	// and the first of the next
+	float m_gapRho;
+	float m_gapNoise;
+
+	// A field of spatially correlated noise, larger than the frame by
+	// POOL_MARGIN in each direction. The noise added to the field at each
+	// sample is a frame-sized region of it at a random offset, which is
+	// much cheaper than generating and filtering new noise.
+	static const int POOL_MARGIN = 256;
+	int m_poolWidth;
+	int m_poolHeight;
+	std::vector<float> m_poolRe;
+	std::vector<float> m_poolIm;
+
+	// The current field
+	std::vector<float> m_fieldRe;
+	std::vector<float> m_fieldIm;
+
+	// The integrated intensity, quantised
+	std::vector<uint16_t> m_samples;
+
+	// The offsets into the pool for the gap before the frame, followed by
+	// those for each sample
+	std::vector<Offset> m_offsets;
+
+	std::mt19937 m_random;
+	bool m_started;
+	std::unique_ptr<ThreadPool> m_threadPool;
+	int m_numTasks;
+};
+
+} // namespace
+
+#endif
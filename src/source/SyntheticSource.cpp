@@ -0,0 +1,52 @@
+#include "source/SyntheticSource.h"
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#include "source/SpeckleGenerator.h"
+
+namespace Speckle {
+
+SyntheticSource::SyntheticSource(const Options & options)
+	: m_options(options)
+{
+	if (m_options.format.getFrameSize() == 0 || m_options.x <= 0 || m_options.frameRate < 0) {
+		throw std::runtime_error("Invalid synthetic source options");
+	}
+
+	// The exposure is the whole frame interval
+	SpeckleGenerator::Options generatorOptions;
+	generatorOptions.width = m_options.format.width * m_options.format.samplesPerPixel;
+	generatorOptions.height = m_options.format.height;
+	generatorOptions.bitsPerSample = m_options.format.bitsPerSample;
+	generatorOptions.speckleSize = m_options.speckleSize;
+	generatorOptions.frameRate = m_options.frameRate ? m_options.frameRate : 30;
+	generatorOptions.exposure = 1 / generatorOptions.frameRate;
+	generatorOptions.correlationTime = generatorOptions.exposure / m_options.x;
+	generatorOptions.threads = 0;
+	SpeckleGenerator generator(generatorOptions);
+
+	m_frames.resize(NUM_FRAMES);
+	for (int i = 0; i < NUM_FRAMES; i++) {
+		m_frames[i].resize(m_options.format.getFrameSize());
+		generator.generate(&m_frames[i][0]);
+	}
+}
+
+void SyntheticSource::run(const Callback & callback) {
+	typedef std::chrono::steady_clock Clock;
+	const double rate = m_options.frameRate ? m_options.frameRate : 30;
+	const uint64_t interval = (uint64_t)(TIMESTAMP_RATE / rate);
+
+	Clock::time_point start = Clock::now();
+	for (long i = 0; !isStopping() && (!m_options.frames || i < m_options.frames); i++) {
+		if (m_options.frameRate) {
+			std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(
+				std::chrono::duration<double>(i / m_options.frameRate)));
+		}
+		callback(&m_frames[i % NUM_FRAMES][0], i * interval);
+	}
+}
+
+} // namespace
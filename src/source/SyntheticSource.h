@@ -0,0 +1,60 @@
+#ifndef SPECKLE_SYNTHETICSOURCE_H
+#define SPECKLE_SYNTHETICSOURCE_H
+
+#include <vector>
+
+#include "source/FrameSource.h"
+
+namespace Speckle {
+
+/**
+ * Frames of simulated speckle from SpeckleGenerator, for running the live
+ * path without a camera
+ */
+class SyntheticSource : public FrameSource {
+public:
+	struct Options {
+		Options()
+			: speckleSize(2), x(1), frameRate(30), frames(0)
+		{}
+
+		// The format of the generated frames. The samples of colour formats
+		// are generated as if they were neighbouring pixels.
+		RawCaptureFormat format;
+
+		// The speckle diameter in pixels
+		int speckleSize;
+
+		// The ratio of exposure time to correlation time
+		double x;
+
+		// The number of frames per second, or 0 to deliver frames as fast
+		// as the callback accepts them
+		double frameRate;
+
+		// The number of frames to deliver, or 0 for no limit
+		long frames;
+	};
+
+	SyntheticSource(const Options & options);
+
+	virtual RawCaptureFormat getFormat() const {
+		return m_options.format;
+	}
+
+	virtual void run(const Callback & callback);
+
+private:
+	/**
+	 * The number of distinct frames, which are generated in advance so
+	 * that generation doesn't limit the frame rate
+	 */
+	static const int NUM_FRAMES = 8;
+
+	Options m_options;
+	std::vector<std::vector<uint8_t>> m_frames;
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,107 @@
+#include "source/TiffFormat.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace Speckle {
+
+namespace {
+
+const char TIMESTAMP_PREFIX[] = "timestamp=";
+
+} // namespace
+
+void setTiffFormat(TIFF * tif, const RawCaptureFormat & format, uint64_t timestamp) {
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, format.width);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, format.height);
+
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, format.height);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
+	TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_NONE);
+	TIFFSetField(tif, TIFFTAG_XRESOLUTION, 1.0);
+	TIFFSetField(tif, TIFFTAG_YRESOLUTION, 1.0);
+	TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, format.samplesPerPixel);
+	TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, format.bitsPerSample);
+
+	if (format.bayer) {
+		// Let's pretend to be a DNG. We don't provide a baseline thumbnail
+		// but we do most other things correctly. These files can be read by
+		// ufraw.
+		static uint8_t version[] = {1, 4, 0, 0};
+		TIFFSetField(tif, TIFFTAG_DNGVERSION, version);
+		TIFFSetField(tif, TIFFTAG_SUBFILETYPE, 0);
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_CFA);
+
+		// DNG does not allow LZW compression
+		TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
+
+		static uint16_t patternDim[] = {2, 2};
+		TIFFSetField(tif, TIFFTAG_CFAREPEATPATTERNDIM, patternDim);
+		static uint8_t pattern[] = {1, 0, 2, 1};
+		TIFFSetField(tif, TIFFTAG_CFAPATTERN, pattern);
+	} else {
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, format.samplesPerPixel == 3
+			? PHOTOMETRIC_RGB : PHOTOMETRIC_MINISBLACK);
+
+		// LZW is not helpful for packed formats
+		TIFFSetField(tif, TIFFTAG_COMPRESSION, format.bitsPerSample % 8
+			? COMPRESSION_NONE : COMPRESSION_LZW);
+	}
+
+	std::string description = TIMESTAMP_PREFIX + std::to_string(timestamp);
+	TIFFSetField(tif, TIFFTAG_IMAGEDESCRIPTION, description.c_str());
+}
+
+RawCaptureFormat getTiffFormat(TIFF * tif) {
+	uint32_t width, height;
+	uint16_t samplesPerPixel, bitsPerSample, photometric;
+	if (!TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width)
+		|| !TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height)
+		|| !TIFFGetFieldDefaulted(tif, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel)
+		|| !TIFFGetFieldDefaulted(tif, TIFFTAG_BITSPERSAMPLE, &bitsPerSample)
+		|| !TIFFGetField(tif, TIFFTAG_PHOTOMETRIC, &photometric))
+	{
+		throw std::runtime_error("Unable to read required TIFF tag");
+	}
+
+	RawCaptureFormat format;
+	format.width = width;
+	format.height = height;
+	format.samplesPerPixel = samplesPerPixel;
+	format.bitsPerSample = bitsPerSample;
+	format.bayer = photometric == PHOTOMETRIC_CFA;
+	if (bitsPerSample > 16
+		|| (int64_t)TIFFScanlineSize(tif) * 8
+			!= (int64_t)width * samplesPerPixel * bitsPerSample)
+	{
+		throw std::runtime_error("Unsupported TIFF sample format");
+	}
+	return format;
+}
+
+void readTiffFrame(TIFF * tif, const RawCaptureFormat & format, uint8_t * data) {
+	if (getTiffFormat(tif) != format) {
+		throw std::runtime_error("All pages of the input must have the same size and format");
+	}
+	tsize_t lineSize = TIFFScanlineSize(tif);
+	for (int y = 0; y < format.height; y++) {
+		if (1 != TIFFReadScanline(tif, data + (size_t)y * lineSize, y, 0)) {
+			throw std::runtime_error("Error reading TIFF file");
+		}
+	}
+}
+
+uint64_t getTiffTimestamp(TIFF * tif) {
+	char * description;
+	if (!TIFFGetField(tif, TIFFTAG_IMAGEDESCRIPTION, &description)
+		|| std::strncmp(description, TIMESTAMP_PREFIX, sizeof(TIMESTAMP_PREFIX) - 1))
+	{
+		return 0;
+	}
+	return std::strtoull(description + sizeof(TIMESTAMP_PREFIX) - 1, nullptr, 10);
+}
+
+} // namespace
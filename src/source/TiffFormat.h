@@ -0,0 +1,36 @@
+#ifndef SPECKLE_TIFFFORMAT_H
+#define SPECKLE_TIFFFORMAT_H
+
+#include <tiffio.h>
+#include "common/RawCapture.h"
+
+namespace Speckle {
+
+/**
+ * Set the tags of the current TIFF directory for a single-strip frame in
+ * the given format. Bayer frames are stored as DNG. The device timestamp is
+ * stored in the image description.
+ */
+void setTiffFormat(TIFF * tif, const RawCaptureFormat & format, uint64_t timestamp);
+
+/**
+ * Get the format of the current TIFF directory. Throw std::runtime_error
+ * if its rows can't be stored unpadded in a raw capture.
+ */
+RawCaptureFormat getTiffFormat(TIFF * tif);
+
+/**
+ * Read the current TIFF directory into a frame of format.getFrameSize()
+ * bytes. Throw std::runtime_error if the directory has a different format
+ * or can't be read.
+ */
+void readTiffFrame(TIFF * tif, const RawCaptureFormat & format, uint8_t * data);
+
+/**
+ * Get the device timestamp stored by setTiffFormat(), or 0 if there is none
+ */
+uint64_t getTiffTimestamp(TIFF * tif);
+
+} // namespace
+
+#endif
@@ -0,0 +1,511 @@
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "compute/ColourLookup.h"
+#include "compute/ComputePipeline.h"
+#include "compute/CorrelationTime.h"
+#include "compute/IntegralImage.h"
+#include "compute/SpatialWindow.h"
+#include "compute/Unpack.h"
+#include "compute/Visualize.h"
+#include "compute/WindowSweep.h"
+
+namespace po = boost::program_options;
+using namespace Speckle;
+
+struct BenchOptions {
+	BenchOptions()
+		: width(640), height(488), iterations(50), tsv(false)
+	{}
+
+	int width;
+	int height;
+	int iterations;
+
+	// Write tab-separated results instead of text
+	bool tsv;
+};
+
+/**
+ * The parameters of a benchmark run, other than the frame size. Zero means
+ * that the parameter doesn't apply.
+ */
+struct BenchCase {
+	BenchCase(const std::string & name, int bits = 0, int window = 0)
+		: name(name), bits(bits), window(window)
+	{}
+
+	std::string name;
+	int bits;
+	int window;
+};
+
+const int BITS[] = {8, 10, 12, 16};
+const int WINDOWS[] = {3, 5, 7, 11};
+
+/**
+ * Write the header line of the tab-separated results
+ */
+void reportHeader(const BenchOptions & options) {
+	if (options.tsv) {
+		std::cout << "benchmark\twidth\theight\tbits\twindow"
+			"\tns_per_pixel\tmpixel_per_s\tframes_per_s\n";
+	}
+}
+
+/**
+ * Run a function repeatedly and report its throughput in nanoseconds per
+ * pixel and frames per second, for a frame of the configured size
+ */
+void report(const BenchCase & benchCase, const BenchOptions & options,
+	const std::function<void()> & func)
+{
+	// Warm up caches and the branch predictor
+	func();
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < options.iterations; i++) {
+		func();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	double pixels = (double)options.width * options.height * options.iterations;
+	double nsPerPixel = elapsed.count() * 1e9 / pixels;
+	double mpixelPerSecond = pixels / elapsed.count() / 1e6;
+	double framesPerSecond = options.iterations / elapsed.count();
+	if (options.tsv) {
+		std::cout << benchCase.name
+			<< "\t" << options.width << "\t" << options.height
+			<< "\t" << benchCase.bits << "\t" << benchCase.window
+			<< "\t" << nsPerPixel << "\t" << mpixelPerSecond
+			<< "\t" << framesPerSecond << "\n";
+		return;
+	}
+
+	std::cout << benchCase.name << " " << options.width << "x" << options.height;
+	if (benchCase.bits) {
+		std::cout << " " << benchCase.bits << "-bit";
+	}
+	if (benchCase.window) {
+		std::cout << " w" << benchCase.window;
+	}
+	std::cout << ": "
+		<< nsPerPixel << " ns/pixel, "
+		<< mpixelPerSecond << " Mpixel/s, "
+		<< framesPerSecond << " frames/s\n";
+}
+
+/**
+ * Make a frame of uniformly distributed values in (0, 1), the same for every
+ * run
+ */
+std::vector<double> makeUniform(const BenchOptions & options) {
+	std::vector<double> values((size_t)options.width * options.height);
+	uint32_t seed = 1;
+	for (size_t i = 0; i < values.size(); i++) {
+		seed = seed * 1103515245 + 12345;
+		values[i] = ((seed >> 8) + 0.5) / double(1 << 24);
+	}
+	return values;
+}
+
+/**
+ * Make a frame of fully developed speckle. The intensity is exponentially
+ * distributed, with a mean of a quarter of the sample range, and clipped at
+ * the maximum, as from a camera exposed for the bright spots.
+ */
+std::vector<uint16_t> makeSpeckle(const BenchOptions & options, int bits) {
+	std::vector<double> uniform = makeUniform(options);
+	std::vector<uint16_t> samples(uniform.size());
+	const double mean = (1 << bits) / 4.0;
+	const double max = (1 << bits) - 1;
+	for (size_t i = 0; i < samples.size(); i++) {
+		samples[i] = (uint16_t)std::min(max, -mean * std::log(uniform[i]));
+	}
+	return samples;
+}
+
+/**
+ * Pack samples in the input format of Unpack
+ */
+std::vector<uint8_t> pack(const std::vector<uint16_t> & samples, int bits) {
+	std::vector<uint8_t> packed((samples.size() * bits + 7) / 8);
+	if (bits == 16) {
+		std::memcpy(&packed[0], &samples[0], packed.size());
+		return packed;
+	}
+	uint32_t buffer = 0;
+	int bufferSize = 0;
+	size_t pos = 0;
+	for (uint16_t sample : samples) {
+		buffer = (buffer << bits) | sample;
+		bufferSize += bits;
+		while (bufferSize >= 8) {
+			bufferSize -= 8;
+			packed[pos++] = buffer >> bufferSize;
+		}
+	}
+	if (bufferSize) {
+		packed[pos] = buffer << (8 - bufferSize);
+	}
+	return packed;
+}
+
+/**
+ * Make a frame of K² values spread over the range seen in practice
+ */
+std::vector<double> makeKSquared(const BenchOptions & options) {
+	return makeUniform(options);
+}
+
+void benchUnpack(const BenchOptions & options) {
+	std::vector<uint16_t> output((size_t)options.width * options.height);
+	for (int bits : BITS) {
+		std::vector<uint8_t> packed = pack(makeSpeckle(options, bits), bits);
+		Unpack unpack(packed.size(), bits);
+		report(BenchCase("unpack", bits), options, [&] {
+			unpack.startFrame(&packed[0]);
+			for (int y = 0; y < options.height; y++) {
+				unpack.computeRow(&output[(size_t)y * options.width], options.width);
+			}
+		});
+	}
+}
+
+template <class Window>
+void benchWindow(const BenchOptions & options, const char * name, int bits, int window) {
+	std::vector<uint16_t> samples = makeSpeckle(options, bits);
+	Window spatialWindow(window, options.width);
+	std::vector<double> kSq(spatialWindow.getOutputWidth());
+	report(BenchCase(name, bits, window), options, [&] {
+		spatialWindow.startFrame();
+		for (int y = 0; y < options.height; y++) {
+			spatialWindow.computeRow(&samples[(size_t)y * options.width], &kSq[0]);
+		}
+	});
+}
+
+void benchSpatialWindow(const BenchOptions & options) {
+	for (int bits : {10, 16}) {
+		for (int window : WINDOWS) {
+			if (window > options.width || window > options.height) {
+				continue;
+			}
+			if (SpatialWindow::fits(bits, window)) {
+				benchWindow<SpatialWindow>(options, "spatial-window", bits, window);
+			}
+			benchWindow<WideSpatialWindow>(options, "spatial-window-wide", bits, window);
+		}
+	}
+}
+
+/**
+ * Compare the integral image with the ring buffer of WideSpatialWindow for
+ * the same rows of K², and time building it and querying the clipped window
+ * at every pixel
+ */
+void benchIntegralImage(const BenchOptions & options) {
+	for (int bits : {10, 16}) {
+		std::vector<uint16_t> samples = makeSpeckle(options, bits);
+		const cv::Mat input(options.height, options.width, CV_16UC1, &samples[0]);
+		IntegralImage integral(options.width, options.height);
+		report(BenchCase("integral-image-build", bits), options, [&] {
+			integral.compute(input);
+		});
+
+		for (int window : WINDOWS) {
+			if (window > options.width || window > options.height) {
+				continue;
+			}
+			benchWindow<WideSpatialWindow>(options, "integral-image-ring", bits, window);
+
+			std::vector<double> kSq(options.width - window + 1);
+			report(BenchCase("integral-image", bits, window), options, [&] {
+				integral.compute(input);
+				for (int y = 0; y + window <= options.height; y++) {
+					integral.computeRow(window, y, &kSq[0]);
+				}
+			});
+
+			double total = 0;
+			report(BenchCase("integral-image-query", bits, window), options, [&] {
+				for (int y = 0; y < options.height; y++) {
+					for (int x = 0; x < options.width; x++) {
+						total += integral.getKSquared(x, y, window);
+					}
+				}
+			});
+			// Keep the queries from being optimised away
+			if (total < 0) {
+				std::cout << total;
+			}
+		}
+	}
+}
+
+void benchCorrelationTime(const BenchOptions & options) {
+	CorrelationTime correlationTime(1024, 1.0);
+	std::vector<double> kSq = makeKSquared(options);
+	std::vector<double> x(kSq.size());
+
+	report(BenchCase("correlation-time-scalar"), options, [&] {
+		ComputePos pos;
+		for (size_t i = 0; i < kSq.size(); i++) {
+			x[i] = correlationTime.compute(pos, kSq[i]);
+		}
+	});
+	report(BenchCase("correlation-time-row"), options, [&] {
+		for (int y = 0; y < options.height; y++) {
+			size_t offset = (size_t)y * options.width;
+			correlationTime.computeRow(&kSq[offset], &x[offset], options.width);
+		}
+	});
+}
+
+void benchVisualize(const BenchOptions & options) {
+	Visualize visualize(40);
+	std::vector<double> x = makeKSquared(options);
+	for (double & value : x) {
+		value *= 100;
+	}
+	std::vector<cv::Vec4b> output(x.size());
+
+	report(BenchCase("visualize"), options, [&] {
+		for (int y = 0; y < options.height; y++) {
+			size_t offset = (size_t)y * options.width;
+			visualize.computeRow(&x[offset], &output[offset], options.width);
+		}
+	});
+}
+
+void benchColour(const BenchOptions & options) {
+	CorrelationTime correlationTime(1024, 1.0);
+	Visualize visualize(40);
+	std::vector<double> kSq = makeKSquared(options);
+	std::vector<double> x(options.width);
+	std::vector<cv::Vec4b> output(kSq.size());
+
+	report(BenchCase("colour-solve-visualize"), options, [&] {
+		for (int y = 0; y < options.height; y++) {
+			size_t offset = (size_t)y * options.width;
+			correlationTime.computeRow(&kSq[offset], &x[0], options.width);
+			visualize.computeRow(&x[0], &output[offset], options.width);
+		}
+	});
+
+	auto start = std::chrono::steady_clock::now();
+	ColourLookup colourLookup(correlationTime, visualize);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	if (!options.tsv) {
+		std::cout << "colour lookup construction: " << elapsed.count() * 1e3 << " ms\n";
+	}
+
+	report(BenchCase("colour-lookup"), options, [&] {
+		for (int y = 0; y < options.height; y++) {
+			size_t offset = (size_t)y * options.width;
+			colourLookup.computeRow(&kSq[offset], &output[offset], options.width);
+		}
+	});
+}
+
+void benchPipeline(const BenchOptions & options) {
+	struct Variant {
+		const char * name;
+		int threads;
+		bool displayOnly;
+	};
+	const Variant variants[] = {
+		{"pipeline", 1, false},
+		{"pipeline-display", 1, true},
+		{"pipeline-threaded", 0, false}
+	};
+
+	for (int bits : {10, 16}) {
+		std::vector<uint8_t> packed = pack(makeSpeckle(options, bits), bits);
+		for (int window : {5, 7, 11}) {
+			if (window > options.width || window > options.height) {
+				continue;
+			}
+			for (const Variant & variant : variants) {
+				ComputePipeline::Options pipelineOptions;
+				pipelineOptions.width = options.width;
+				pipelineOptions.height = options.height;
+				pipelineOptions.bitsPerPixel = bits;
+				pipelineOptions.frameSize = packed.size();
+				pipelineOptions.spatialWindow = window;
+				pipelineOptions.threads = variant.threads;
+				pipelineOptions.displayOnly = variant.displayOnly;
+				ComputePipeline pipeline(pipelineOptions);
+				cv::Mat output;
+				report(BenchCase(variant.name, bits, window), options, [&] {
+					pipeline.writeFrame(&packed[0], packed.size(), output, CV_8UC4);
+				});
+			}
+		}
+	}
+}
+
+/**
+ * Compare a window sweep with a separate pipeline for each window size. The
+ * window column is the largest size.
+ */
+void benchWindowSweep(const BenchOptions & options) {
+	const std::vector<int> windows = {5, 7, 9, 11};
+	if (windows.back() > options.width || windows.back() > options.height) {
+		return;
+	}
+	const int bits = 10;
+	std::vector<uint8_t> packed = pack(makeSpeckle(options, bits), bits);
+	ComputePipeline::Options pipelineOptions;
+	pipelineOptions.width = options.width;
+	pipelineOptions.height = options.height;
+	pipelineOptions.bitsPerPixel = bits;
+	pipelineOptions.frameSize = packed.size();
+	pipelineOptions.displayOnly = true;
+
+	std::vector<std::unique_ptr<ComputePipeline>> pipelines;
+	for (int window : windows) {
+		pipelineOptions.spatialWindow = window;
+		pipelines.emplace_back(new ComputePipeline(pipelineOptions));
+	}
+	std::vector<cv::Mat> outputs(windows.size());
+	report(BenchCase("window-sweep-separate", bits, windows.back()), options, [&] {
+		for (size_t i = 0; i < pipelines.size(); i++) {
+			pipelines[i]->writeFrame(&packed[0], packed.size(), outputs[i], CV_8UC4);
+		}
+	});
+
+	WindowSweep sweep(pipelineOptions, windows);
+	report(BenchCase("window-sweep", bits, windows.back()), options, [&] {
+		sweep.writeFrame(&packed[0], packed.size(), outputs, CV_8UC4);
+	});
+}
+
+struct Benchmark {
+	const char * name;
+	void (*func)(const BenchOptions & options);
+};
+
+const Benchmark benchmarks[] = {
+	{"unpack", benchUnpack},
+	{"spatial-window", benchSpatialWindow},
+	{"integral-image", benchIntegralImage},
+	{"correlation-time", benchCorrelationTime},
+	{"visualize", benchVisualize},
+	{"colour", benchColour},
+	{"pipeline", benchPipeline},
+	{"window-sweep", benchWindowSweep}
+};
+
+bool processCommandLine(int argc, char** argv,
+		BenchOptions & options,
+		std::vector<std::string> & names,
+		bool & defaultSizes)
+{
+	po::options_description visible;
+
+	visible.add_options()
+		("help",
+			"Show help message and exit")
+		("width", po::value<int>(&options.width),
+			"Frame width in pixels. By default, 640x488 and 1280x1024 frames are "
+			"both measured.")
+		("height", po::value<int>(&options.height),
+			"Frame height in pixels")
+		("iterations", po::value<int>(&options.iterations),
+			"Number of frames to time (default 50)")
+		("tsv",
+			"Write results as tab-separated values, for comparison between builds")
+		;
+
+	po::options_description invisible;
+	invisible.add_options()
+		("benchmark", po::value<std::vector<std::string>>(&names))
+		;
+
+	po::options_description allDesc;
+	allDesc.add(visible).add(invisible);
+
+	po::positional_options_description positionalDesc;
+	positionalDesc.add("benchmark", -1);
+
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv)
+			.options(allDesc)
+			.positional(positionalDesc)
+			.run(), vm);
+	po::notify(vm);
+
+	if (vm.count("help")) {
+		std::cout << "Usage: " << (argc >= 1 ? argv[0] : "bench")
+			<< " [options] [<benchmark>...]\n"
+			<< "Run all benchmarks, or the named ones, which may be:\n";
+		for (const Benchmark & benchmark : benchmarks) {
+			std::cout << "  " << benchmark.name << "\n";
+		}
+		std::cout << "Accepted options are:\n"
+			<< visible;
+		return false;
+	}
+
+	if (options.width < 1 || options.height < 1 || options.iterations < 1) {
+		std::cout << "The width, height and iterations must be positive\n";
+		return false;
+	}
+	options.tsv = vm.count("tsv");
+	defaultSizes = !vm.count("width") && !vm.count("height");
+	return true;
+}
+
+int main(int argc, char **argv) {
+	BenchOptions options;
+	std::vector<std::string> names;
+	bool defaultSizes;
+
+	if (!processCommandLine(argc, argv, options, names, defaultSizes)) {
+		return 1;
+	}
+
+	for (const std::string & name : names) {
+		bool found = false;
+		for (const Benchmark & benchmark : benchmarks) {
+			found = found || name == benchmark.name;
+		}
+		if (!found) {
+			std::cerr << "Unknown benchmark \"" << name << "\"\n";
+			return 1;
+		}
+	}
+
+	std::vector<std::pair<int, int>> sizes;
+	if (defaultSizes) {
+		sizes = {{640, 488}, {1280, 1024}};
+	} else {
+		sizes = {{options.width, options.height}};
+	}
+
+	reportHeader(options);
+	for (const std::pair<int, int> & size : sizes) {
+		options.width = size.first;
+		options.height = size.second;
+		for (const Benchmark & benchmark : benchmarks) {
+			bool selected = names.empty();
+			for (const std::string & name : names) {
+				selected = selected || name == benchmark.name;
+			}
+			if (selected) {
+				benchmark.func(options);
+			}
+		}
+	}
+	return 0;
+}
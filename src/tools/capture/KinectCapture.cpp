@@ -1,181 +1,198 @@
 #include "KinectCapture.h"
+#include "source/TiffFormat.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
 namespace Speckle {
 
 bool KinectCapture::capture() {
-	m_tif = TIFFOpen(m_options.fileName.c_str(), "w");
-	if (!m_tif) {
-		std::cerr << "Unable to open output file\n";
-		return false;
+	m_format = m_source.getFormat();
+
+	if (m_options.raw) {
+		try {
+			m_raw.reset(new RawCaptureWriter(m_options.fileName, m_format));
+		} catch (std::runtime_error & e) {
+			std::cerr << e.what() << "\n";
+			return false;
+		}
+	} else {
+		m_tif = TIFFOpen(m_options.fileName.c_str(), "w");
+		if (!m_tif) {
+			std::cerr << "Unable to open output file\n";
+			return false;
+		}
 	}
 
-	freenect_context *f_ctx;
-	freenect_device *f_dev;
-
-	if (freenect_init(&f_ctx, NULL) < 0) {
-		std::cerr << "Error: freenect_init() failed\n";
-		return false;
+	// Disk I/O and compression happen in the writer thread, so that a
+	// stall doesn't block the source
+	for (int i = 0; i < m_options.bufferFrames; i++) {
+		m_slots.emplace_back(new Slot);
+		m_slots.back()->data.resize(m_format.getFrameSize());
+		m_free.tryPush(m_slots.back().get());
 	}
-
-	freenect_set_log_level(f_ctx, FREENECT_LOG_SPEW);
-	freenect_set_log_callback(f_ctx, LogCallback);
-
-	freenect_select_subdevices(f_ctx, FREENECT_DEVICE_CAMERA);
-
-	if (freenect_num_devices(f_ctx) < 1) {
-		std::cerr << "Error: no Kinect devices found\n";
-		return false;
+	// The callback must not allocate, so the timestamps have a fixed
+	// capacity, with room for as many dropped frames as accepted ones
+	m_timestamps.reserve(2 * (size_t)m_options.frames);
+	m_writer = std::thread([this] { writerMain(); });
+
+	try {
+		m_source.run([this](const void * data, uint64_t timestamp) {
+			processFrame(data, timestamp);
+		});
+	} catch (std::runtime_error & e) {
+		std::cerr << "Error: " << e.what() << "\n";
+		m_success = false;
 	}
 
-	if (freenect_open_device(f_ctx, &f_dev, 0) < 0) {
-		std::cerr << "Error: could not open device\n";
-		return false;
+	// Write the remaining frames
+	m_writerStopping = true;
+	m_writer.join();
+	if (m_writeFailed) {
+		m_success = false;
+	}
+	report();
+
+	if (m_raw) {
+		try {
+			m_raw->close();
+		} catch (std::runtime_error & e) {
+			std::cerr << e.what() << "\n";
+			m_success = false;
+		}
+	} else {
+		TIFFClose(m_tif);
 	}
-
-	// FIXME: it's not possible to set the brightness in high-resolution mode.
-	// It is overridden when the video starts, and then attempts to set it
-	// after that respond with an error.
-	sendBrightness(f_dev);
-
-	freenect_set_video_callback(f_dev, VideoCallback);
-	freenect_set_video_mode(f_dev, freenect_find_video_mode(m_options.resolution, m_options.mode));
-	freenect_set_user(f_dev, (void*)this);
-	freenect_start_video(f_dev);
-
-	int res;
-	while (!m_done && (res = freenect_process_events(f_ctx)) >= 0);
-
-	freenect_stop_video(f_dev);
-	freenect_close_device(f_dev);
-	freenect_shutdown(f_ctx);
-
-	TIFFClose(m_tif);
 
 	return m_success;
 }
 
-void KinectCapture::sendBrightness(freenect_device *f_dev) {
-	if (m_options.mode == FREENECT_VIDEO_IR_8BIT
-			|| m_options.mode == FREENECT_VIDEO_IR_10BIT_PACKED
-			|| m_options.mode == FREENECT_VIDEO_IR_10BIT)
-	{
-		freenect_set_ir_brightness(f_dev, (uint16_t)m_options.brightness);
+void KinectCapture::processFrame(const void *data, uint64_t timestamp) {
+	if (m_frameIndex++ < m_options.skip || m_done) {
+		return;
+	}
+	if (m_timestamps.size() < m_timestamps.capacity()) {
+		m_timestamps.push_back(timestamp);
+	}
+
+	// If the writer has fallen behind, drop the frame rather than block
+	Slot * slot;
+	if (!m_free.tryPop(slot)) {
+		m_dropped++;
+		return;
 	}
-}
+	std::memcpy(&slot->data[0], data, slot->data.size());
+	slot->timestamp = timestamp;
+	slot->index = m_accepted++;
+	m_filled.tryPush(slot);
 
-void KinectCapture::LogCallback(freenect_context *dev, freenect_loglevel level, const char *msg) {
-	std::cerr << msg;
+	if (m_accepted >= m_options.frames) {
+		m_success = true;
+		m_done = true;
+		m_source.stop();
+	}
 }
 
-void KinectCapture::VideoCallback(freenect_device *dev, void *data, uint32_t timestamp) {
-	KinectCapture & capture = *(KinectCapture*)freenect_get_user(dev);
-	capture.processFrame(dev, data, timestamp);
+void KinectCapture::writerMain() {
+	int idleCount = 0;
+	while (true) {
+		Slot * slot;
+		if (!m_filled.tryPop(slot)) {
+			if (!m_writerStopping) {
+				backoff(idleCount);
+				continue;
+			}
+			// The callback has stopped, so an empty queue now means that
+			// all frames have been written
+			if (!m_filled.tryPop(slot)) {
+				break;
+			}
+		}
+		idleCount = 0;
+
+		if (!m_writeFailed) {
+			if (writeFrame(&slot->data[0], slot->timestamp, slot->index)) {
+				m_written++;
+				std::cerr << "Frame " << slot->index << "\n";
+			} else {
+				m_writeFailed = true;
+				m_done = true;
+				m_source.stop();
+			}
+		}
+		m_free.tryPush(slot);
+	}
 }
 
-void KinectCapture::processFrame(freenect_device *dev, void *data, uint32_t timestamp) {
-	std::cerr << "Frame " << m_frameIndex << std::endl;
-	if (m_frameIndex++ < m_options.skip) {
-		return;
+/**
+ * Report dropped frames, and gaps in the device timestamps which show that
+ * frames were lost before they reached us
+ */
+void KinectCapture::report() {
+	int late = 0;
+	long missing = 0;
+	if (m_timestamps.size() >= 3) {
+		std::vector<uint64_t> intervals;
+		for (size_t i = 1; i < m_timestamps.size(); i++) {
+			intervals.push_back(FrameSource::getInterval(m_timestamps[i - 1], m_timestamps[i]));
+		}
+		std::vector<uint64_t> sorted = intervals;
+		std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+		double period = sorted[sorted.size() / 2];
+		if (period > 0) {
+			for (uint64_t interval : intervals) {
+				if (interval > 1.5 * period) {
+					late++;
+					missing += std::lround(interval / period) - 1;
+				}
+			}
+		}
 	}
 
-	freenect_frame_mode frameMode = freenect_get_current_video_mode(dev);
-	TIFFSetField(m_tif, TIFFTAG_IMAGEWIDTH, frameMode.width);
-	TIFFSetField(m_tif, TIFFTAG_IMAGELENGTH, frameMode.height);
-
-	TIFFSetField(m_tif, TIFFTAG_ROWSPERSTRIP, frameMode.height);
-	TIFFSetField(m_tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
-	TIFFSetField(m_tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_UINT);
-	TIFFSetField(m_tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_NONE);
-	TIFFSetField(m_tif, TIFFTAG_XRESOLUTION, 1.0);
-	TIFFSetField(m_tif, TIFFTAG_YRESOLUTION, 1.0);
-
-	size_t bitsPerPixel;
-
-	switch (m_options.mode) {
-		case FREENECT_VIDEO_RGB:
-			TIFFSetField(m_tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
-			TIFFSetField(m_tif, TIFFTAG_SAMPLESPERPIXEL, 3);
-			TIFFSetField(m_tif, TIFFTAG_BITSPERSAMPLE, 8);
-			TIFFSetField(m_tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-			bitsPerPixel = 24;
-			break;
-		case FREENECT_VIDEO_BAYER:
-			// Let's pretend to be a DNG. We don't provide a baseline thumbnail
-			// but we do most other things correctly. These files can be read by
-			// ufraw.
-			static uint8_t version[] = {1, 4, 0, 0};
-			TIFFSetField(m_tif, TIFFTAG_DNGVERSION, version);
-			TIFFSetField(m_tif, TIFFTAG_SUBFILETYPE, 0);
-			TIFFSetField(m_tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_CFA);
-			TIFFSetField(m_tif, TIFFTAG_SAMPLESPERPIXEL, 1);
-			TIFFSetField(m_tif, TIFFTAG_BITSPERSAMPLE, 8);
-
-			// DNG does not allow LZW compression
-			TIFFSetField(m_tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
-
-			static uint16_t patternDim[] = {2, 2};
-			TIFFSetField(m_tif, TIFFTAG_CFAREPEATPATTERNDIM, patternDim);
-			static uint8_t pattern[] = {1, 0, 2, 1};
-			TIFFSetField(m_tif, TIFFTAG_CFAPATTERN, pattern);
-			bitsPerPixel = 8;
-			break;
-		case FREENECT_VIDEO_IR_8BIT:
-			TIFFSetField(m_tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
-			TIFFSetField(m_tif, TIFFTAG_SAMPLESPERPIXEL, 1);
-			TIFFSetField(m_tif, TIFFTAG_BITSPERSAMPLE, 8);
-			TIFFSetField(m_tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-			bitsPerPixel = 8;
-			break;
-		case FREENECT_VIDEO_IR_10BIT_PACKED:
-			TIFFSetField(m_tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
-			TIFFSetField(m_tif, TIFFTAG_SAMPLESPERPIXEL, 1);
-			TIFFSetField(m_tif, TIFFTAG_BITSPERSAMPLE, 10);
-
-			// LZW is not helpful for this format
-			TIFFSetField(m_tif, TIFFTAG_COMPRESSION, COMPRESSION_NONE);
-
-			bitsPerPixel = 10;
-			break;
-		case FREENECT_VIDEO_IR_10BIT:
-			TIFFSetField(m_tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
-			TIFFSetField(m_tif, TIFFTAG_SAMPLESPERPIXEL, 1);
-			TIFFSetField(m_tif, TIFFTAG_BITSPERSAMPLE, 16);
-			TIFFSetField(m_tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
-			bitsPerPixel = 16;
-			break;
-		default:
-			std::cerr << "Invalid mode\n";
-			m_done = true;
-			return;
+	std::cerr << "Wrote " << m_written << " frames, dropped " << m_dropped
+		<< " because the writer fell behind\n";
+	if (late) {
+		std::cerr << late << " frames arrived late, with about " << missing
+			<< " frames missing from the device stream\n";
+	}
+}
+
+/**
+ * Write a frame to the TIFF file or raw capture
+ */
+bool KinectCapture::writeFrame(void *data, uint64_t timestamp, int index) {
+	size_t size = m_format.getFrameSize();
+
+	if (m_raw) {
+		try {
+			m_raw->writeFrame(data, size, timestamp);
+		} catch (std::runtime_error & e) {
+			std::cerr << e.what() << "\n";
+			return false;
+		}
+		return true;
 	}
 
+	setTiffFormat(m_tif, m_format, timestamp);
 	TIFFSetField(m_tif, TIFFTAG_MAKE, "Microsoft");
 	TIFFSetField(m_tif, TIFFTAG_MODEL, "Kinect");
 	TIFFSetField(m_tif, TIFFTAG_SOFTWARE, "libspeckle");
 
 	if (m_options.frames > 1) {
-		TIFFSetField(m_tif, TIFFTAG_PAGENUMBER, m_frameIndex - m_options.skip, 0);
+		TIFFSetField(m_tif, TIFFTAG_PAGENUMBER, index, 0);
 		TIFFSetField(m_tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
 	}
 
-	size_t size = bitsPerPixel * frameMode.width * frameMode.height / 8;
-
 	if (TIFFWriteEncodedStrip(m_tif, 0, data, size) < 0) {
 		std::cerr << "Error writing encoded strip\n";
-		m_done = true;
-		return;
+		return false;
 	}
 	if (TIFFWriteDirectory(m_tif) == 0) {
 		std::cerr << "Error writing directory\n";
-		m_done = true;
-		return;
-	}
-
-	if (m_frameIndex >= m_options.frames + m_options.skip) {
-		m_success = true;
-		m_done = true;
+		return false;
 	}
+	return true;
 }
 
 } // namespace
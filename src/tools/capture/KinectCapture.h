@@ -1,47 +1,97 @@
-#include <libfreenect.h>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <thread>
 #include <tiffio.h>
+#include <vector>
+
+#include "common/RawCapture.h"
+#include "common/SpscQueue.h"
+#include "source/FrameSource.h"
 
 namespace Speckle {
 
+/**
+ * Write frames from a FrameSource to a TIFF file or raw capture
+ */
 class KinectCapture {
 public:
 
 	struct Options {
 		Options()
-			: resolution(FREENECT_RESOLUTION_MEDIUM),
-			mode(FREENECT_VIDEO_RGB),
-			brightness(10),
-			frames(1),
-			skip(1)
+			: frames(1),
+			skip(1),
+			raw(false),
+			bufferFrames(16)
 		{}
 
-		freenect_resolution resolution;
-		freenect_video_format mode;
-		int brightness;
 		std::string fileName;
 		int frames;
 		int skip;
+
+		// Write a raw capture instead of a TIFF file
+		bool raw;
+
+		// The number of frames which can wait to be written before frames
+		// are dropped
+		int bufferFrames;
 	};
 
-	KinectCapture(const Options & options)
-		: m_options(options), m_done(false), m_success(false), m_frameIndex(0)
+	KinectCapture(const Options & options, FrameSource & source)
+		: m_options(options), m_source(source), m_done(false), m_success(false), m_frameIndex(0),
+		m_tif(nullptr), m_free(options.bufferFrames), m_filled(options.bufferFrames),
+		m_accepted(0), m_dropped(0), m_written(0), m_writerStopping(false), m_writeFailed(false)
 	{}
 
 	bool capture();
 private:
-	static void VideoCallback(freenect_device *dev, void *data, uint32_t timestamp);
-	static void LogCallback(freenect_context *dev, freenect_loglevel level, const char *msg);
+	/**
+	 * A frame waiting to be written
+	 */
+	struct Slot {
+		std::vector<uint8_t> data;
+		uint64_t timestamp;
+		int index;
+	};
+
+	typedef SpscQueue<Slot*> SlotQueue;
 
-	void processFrame(freenect_device *dev, void *data, uint32_t timestamp);
-	void sendBrightness(freenect_device *f_dev);
+	void processFrame(const void *data, uint64_t timestamp);
+	bool writeFrame(void *data, uint64_t timestamp, int index);
+	void writerMain();
+	void report();
 
 	Options m_options;
-	bool m_done;
+	FrameSource & m_source;
+	std::atomic<bool> m_done;
 	bool m_success;
 
 	int m_frameIndex;
+	RawCaptureFormat m_format;
 	TIFF * m_tif;
+	std::unique_ptr<RawCaptureWriter> m_raw;
+
+	// The ring of frame slots. The libfreenect callback fills free slots,
+	// and the writer thread writes filled slots and returns them.
+	std::vector<std::unique_ptr<Slot>> m_slots;
+	SlotQueue m_free;
+	SlotQueue m_filled;
+	std::thread m_writer;
+
+	// Counters, owned by the callback thread
+	int m_accepted;
+	int m_dropped;
+
+	// Owned by the writer thread
+	int m_written;
+
+	// The device timestamps of the frames after the skipped ones,
+	// including dropped frames, up to the capacity reserved before
+	// capturing. Later timestamps are not recorded.
+	std::vector<uint64_t> m_timestamps;
+
+	std::atomic<bool> m_writerStopping;
+	std::atomic<bool> m_writeFailed;
 };
 
 } // namespace
@@ -1,11 +1,17 @@
 #include <boost/program_options.hpp>
 #include "tools/capture/KinectCapture.h"
+#include "source/KinectSource.h"
+#include "source/SyntheticSource.h"
 #include <iostream>
 
 namespace po = boost::program_options;
 using namespace Speckle;
 
-bool processCommandLine(int argc, char** argv, KinectCapture::Options & options) {
+bool processCommandLine(int argc, char** argv,
+		KinectCapture::Options & options,
+		KinectSource::Options & sourceOptions,
+		bool & synthetic)
+{
 	po::options_description visible;
 	int res;
 	std::string mode;
@@ -23,14 +29,21 @@ bool processCommandLine(int argc, char** argv, KinectCapture::Options & options)
 			"ir8: IR data saved as 8-bit greyscale.\n"
 			"ir10: IR data saved in 10-bit packed form.\n"
 			"ir16: IR data zero-padded to 16 bits per sample." )
-		("ir-brightness", po::value<int>(&options.brightness),
+		("ir-brightness", po::value<int>(&sourceOptions.brightness),
 			"The output power of the IR projector, between 0 and 50.")
 		("output,o", po::value<std::string>(&options.fileName),
-			"The output filename. Please give it a .tif or .dng extension.")
+			"The output filename. Please give it a .tif or .dng extension, or a .raw "
+			"extension to write an indexed raw capture with frame timestamps.")
 		("frames,f", po::value<int>(&options.frames),
 			"The number of frames to capture.")
 		("skip", po::value<int>(&options.skip),
 			"The number of frames to skip at the start of the stream.")
+		("buffer-frames", po::value<int>(&options.bufferFrames),
+			"The number of frames which may wait to be written. If the disk "
+			"falls further behind than this, frames are dropped.")
+		("synthetic",
+			"Capture generated frames of the given resolution and mode at 30 fps "
+			"instead of using a Kinect.")
 		;
 
 	po::variables_map vm;
@@ -50,13 +63,13 @@ bool processCommandLine(int argc, char** argv, KinectCapture::Options & options)
 	if (vm.count("res")) {
 		switch (res) {
 			case 320:
-				options.resolution = FREENECT_RESOLUTION_LOW;
+				sourceOptions.resolution = FREENECT_RESOLUTION_LOW;
 				break;
 			case 640:
-				options.resolution = FREENECT_RESOLUTION_MEDIUM;
+				sourceOptions.resolution = FREENECT_RESOLUTION_MEDIUM;
 				break;
 			case 1280:
-				options.resolution = FREENECT_RESOLUTION_HIGH;
+				sourceOptions.resolution = FREENECT_RESOLUTION_HIGH;
 				break;
 			default:
 				std::cout << "Invalid resolution, must be 320, 640 or 1280\n";
@@ -66,15 +79,15 @@ bool processCommandLine(int argc, char** argv, KinectCapture::Options & options)
 
 	if (vm.count("mode")) {
 		if (mode == "rgb") {
-			options.mode = FREENECT_VIDEO_RGB;
+			sourceOptions.mode = FREENECT_VIDEO_RGB;
 		} else if (mode == "bayer") {
-			options.mode = FREENECT_VIDEO_BAYER;
+			sourceOptions.mode = FREENECT_VIDEO_BAYER;
 		} else if (mode == "ir8") {
-			options.mode = FREENECT_VIDEO_IR_8BIT;
+			sourceOptions.mode = FREENECT_VIDEO_IR_8BIT;
 		} else if (mode == "ir10") {
-			options.mode = FREENECT_VIDEO_IR_10BIT_PACKED;
+			sourceOptions.mode = FREENECT_VIDEO_IR_10BIT_PACKED;
 		} else if (mode == "ir16") {
-			options.mode = FREENECT_VIDEO_IR_10BIT;
+			sourceOptions.mode = FREENECT_VIDEO_IR_10BIT;
 		} else {
 			std::cout << "Unknown mode \"" << mode << "\"\n";
 			return false;
@@ -82,19 +95,27 @@ bool processCommandLine(int argc, char** argv, KinectCapture::Options & options)
 	}
 
 	if (vm.count("ir-brightness")) {
-		if (options.brightness < 0) {
-			options.brightness = 0;
-		} else if (options.brightness > 50) {
-			options.brightness = 50;
+		if (sourceOptions.brightness < 0) {
+			sourceOptions.brightness = 0;
+		} else if (sourceOptions.brightness > 50) {
+			sourceOptions.brightness = 50;
 		}
 	}
+	synthetic = vm.count("synthetic");
 
 	if (!vm.count("output")) {
 		std::cout << "The -o option is required\n";
 		return false;
 	}
+	if (options.bufferFrames < 1) {
+		std::cout << "The buffer must hold at least one frame\n";
+		return false;
+	}
 
-	if (freenect_find_video_mode(options.resolution, options.mode).is_valid == 0) {
+	const std::string & name = options.fileName;
+	options.raw = name.size() >= 4 && name.compare(name.size() - 4, 4, ".raw") == 0;
+
+	if (freenect_find_video_mode(sourceOptions.resolution, sourceOptions.mode).is_valid == 0) {
 		std::cout << "Unable to set that combination of resolution and mode\n";
 		return false;
 	}
@@ -104,11 +125,28 @@ bool processCommandLine(int argc, char** argv, KinectCapture::Options & options)
 
 int main(int argc, char** argv) {
 	KinectCapture::Options options;
-	if (!processCommandLine(argc, argv, options)) {
+	KinectSource::Options sourceOptions;
+	sourceOptions.mode = FREENECT_VIDEO_RGB;
+	sourceOptions.logLevel = FREENECT_LOG_SPEW;
+	bool synthetic;
+	if (!processCommandLine(argc, argv, options, sourceOptions, synthetic)) {
+		return 1;
+	}
+
+	std::unique_ptr<FrameSource> source;
+	try {
+		source.reset(new KinectSource(sourceOptions));
+		if (synthetic) {
+			SyntheticSource::Options syntheticOptions;
+			syntheticOptions.format = source->getFormat();
+			source.reset(new SyntheticSource(syntheticOptions));
+		}
+	} catch (std::runtime_error & e) {
+		std::cerr << e.what() << "\n";
 		return 1;
 	}
 
-	KinectCapture kc(options);
+	KinectCapture kc(options, *source);
 	if (kc.capture()) {
 		return 0;
 	} else {
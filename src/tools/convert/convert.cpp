@@ -0,0 +1,139 @@
+#include <boost/program_options.hpp>
+#include <iostream>
+#include <stdexcept>
+#include <tiffio.h>
+#include <vector>
+
+#include "common/RawCapture.h"
+#include "source/TiffFormat.h"
+
+namespace po = boost::program_options;
+using namespace Speckle;
+
+bool processCommandLine(int argc, char** argv,
+		std::string & input,
+		std::string & output)
+{
+	po::options_description visible;
+	visible.add_options()
+		("help",
+			"Show help message and exit")
+		;
+
+	po::options_description invisible;
+	invisible.add_options()
+		("source", po::value<std::string>(&input))
+		("dest", po::value<std::string>(&output))
+		;
+
+	po::options_description allDesc;
+	allDesc.add(visible).add(invisible);
+
+	po::positional_options_description positionalDesc;
+	positionalDesc
+		.add("source", 1)
+		.add("dest", 1)
+		;
+
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv)
+			.options(allDesc)
+			.positional(positionalDesc)
+			.run(), vm);
+	po::notify(vm);
+
+	if (vm.count("help") || !vm.count("source") || !vm.count("dest")) {
+		std::cout << "Usage: " << (argc >= 1 ? argv[0] : "convert")
+			<< " [options] <source> <dest>\n"
+			<< "Convert a raw capture to a multi-page TIFF or DNG file, or a TIFF\n"
+			<< "or DNG capture to a raw capture. The direction is detected from\n"
+			<< "the source file.\n"
+			<< "Accepted options are:\n"
+			<< visible;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Write each frame of a raw capture as a page of a TIFF file
+ */
+size_t rawToTiff(const std::string & inputName, const std::string & outputName) {
+	RawCaptureReader reader(inputName);
+	const RawCaptureFormat & format = reader.getFormat();
+
+	TIFF * tif = TIFFOpen(outputName.c_str(), "w");
+	if (!tif) {
+		throw std::runtime_error("Unable to open output file");
+	}
+	size_t count = reader.getFrameCount();
+	for (size_t i = 0; i < count; i++) {
+		setTiffFormat(tif, format, reader.getTimestamp(i));
+		TIFFSetField(tif, TIFFTAG_SOFTWARE, "libspeckle");
+		if (count > 1) {
+			TIFFSetField(tif, TIFFTAG_PAGENUMBER, (int)i, 0);
+			TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+		}
+		// The data is not modified, since it is written in native byte order
+		void * data = const_cast<uint8_t*>(reader.getFrame(i));
+		if (TIFFWriteEncodedStrip(tif, 0, data, format.getFrameSize()) < 0
+			|| !TIFFWriteDirectory(tif))
+		{
+			TIFFClose(tif);
+			throw std::runtime_error("Error writing TIFF file");
+		}
+	}
+	TIFFClose(tif);
+	return count;
+}
+
+/**
+ * Write each page of a TIFF file as a frame of a raw capture
+ */
+size_t tiffToRaw(const std::string & inputName, const std::string & outputName) {
+	TIFF * tif = TIFFOpen(inputName.c_str(), "r");
+	if (!tif) {
+		throw std::runtime_error("Unable to open input file");
+	}
+
+	size_t count = 0;
+	try {
+		RawCaptureFormat format = getTiffFormat(tif);
+		RawCaptureWriter writer(outputName, format);
+		std::vector<uint8_t> buffer(format.getFrameSize());
+		do {
+			readTiffFrame(tif, format, &buffer[0]);
+			writer.writeFrame(&buffer[0], buffer.size(), getTiffTimestamp(tif));
+			count++;
+		} while (TIFFReadDirectory(tif));
+		writer.close();
+	} catch (...) {
+		TIFFClose(tif);
+		throw;
+	}
+	TIFFClose(tif);
+	return count;
+}
+
+int main(int argc, char **argv) {
+	std::string inputName;
+	std::string outputName;
+
+	if (!processCommandLine(argc, argv, inputName, outputName)) {
+		return 1;
+	}
+
+	try {
+		size_t count;
+		if (RawCaptureReader::isRawCapture(inputName)) {
+			count = rawToTiff(inputName, outputName);
+		} else {
+			count = tiffToRaw(inputName, outputName);
+		}
+		std::cerr << "Converted " << count << " frame(s)\n";
+	} catch (std::exception & e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
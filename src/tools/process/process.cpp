@@ -1,35 +1,114 @@
 #include <boost/program_options.hpp>
 #include <iostream>
 #include <tiffio.h>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
 #include <vector>
 #include <opencv2/highgui/highgui.hpp>
 #include <cstdint>
 
 #include "compute/ComputePipeline.h"
+#include "compute/WindowSweep.h"
+#include "common/MappedFile.h"
+#include "common/RawCapture.h"
+#include "common/SpscQueue.h"
 
 namespace po = boost::program_options;
 using namespace Speckle;
 
+bool isTiffName(const std::string & name) {
+	size_t dot = name.rfind('.');
+	if (dot == std::string::npos) {
+		return false;
+	}
+	std::string ext = name.substr(dot + 1);
+	for (auto & c : ext) {
+		c = std::tolower(c);
+	}
+	return ext == "tif" || ext == "tiff";
+}
+
 bool processCommandLine(int argc, char** argv,
 		std::string & input,
 		std::string & output,
+		bool & allPages,
+		std::string & maskName,
+		std::vector<int> & windows,
 		ComputePipeline::Options & options)
 {
 	po::options_description visible;
+	std::string contrast;
+	std::string average;
+	std::string roi;
+	std::string windowList;
+	std::string outputMode;
 	
 	visible.add_options()
 		("help",
 		 	"Show help message and exit")
+		("contrast", po::value<std::string>(&contrast),
+		 	"The contrast mode, which may be:\n"
+			"spatial: K² over a window of neighbouring pixels (default).\n"
+			"temporal: K² of each pixel over a window of frames, for multi-page input.\n"
+			"spatiotemporal: K² over the spatial window in each frame of the temporal window.")
 		("window", po::value<int>(&options.spatialWindow),
 		 	"Spatial window size, should be an odd number of pixels (default 7)")
+		("windows", po::value<std::string>(&windowList),
+			"Compute spatial contrast for several window sizes in one pass, given as "
+			"a comma-separated list. The result for each size is written separately, "
+			"with the size added to the output file name.")
+		("temporal-window", po::value<int>(&options.temporalWindow),
+		 	"Temporal window size, as a number of frames (default 25)")
 		("correlation-table-size", po::value<int>(&options.correlationTableSize),
 		 	"Table size used for solving the correlation time equation (default 1024)")
 		("beta", po::value<double>(&options.beta),
 		 	"Speckle contrast correction factor")
 		("scale", po::value<double>(&options.minX),
 		 	"Minimum correlation time as a proportion of exposure time, for visualization")
+		("average", po::value<std::string>(&average),
+			"Average the correlation time over the pages of the input, which may be:\n"
+			"exponential: Exponential moving average.\n"
+			"boxcar: Mean of the last N pages.")
+		("average-frames", po::value<int>(&options.averageFrames),
+			"The number of pages N to average over (default 10)")
+		("average-inverse",
+			"Average the reciprocal of the correlation time, which is proportional to flow")
+		("outlier-threshold", po::value<double>(&options.outlierThreshold),
+			"Leave pages out of the average if their mean K² differs from the average by\n"
+			"more than this proportion, or 0 to use all pages (default 0.25)")
+		("output", po::value<std::string>(&outputMode),
+			"What to write, which may be:\n"
+			"colour: An image of the correlation time (default).\n"
+			"contrast: K² as 32-bit floating point values.\n"
+			"correlation-time: The correlation time x as 32-bit floating point values.\n"
+			"flow: 1/x as 32-bit floating point values, which is proportional to flow.\n"
+			"Floating point values are written to TIFF files, with NaN for pixels "
+			"without a result.")
+		("all-pages",
+			"Write the result for every page of the input, rather than only the last. "
+			"If the output is a TIFF file, the results are its pages, otherwise the "
+			"page number is added to the output file name.")
+		("threads", po::value<int>(&options.threads),
+		 	"Number of threads to use, or 0 for one per CPU (default 1)")
+		("roi", po::value<std::string>(&roi),
+			"Only process a rectangle of the input, given as x,y,width,height. "
+			"The output is the size of the rectangle.")
+		("mask", po::value<std::string>(&maskName),
+			"An image the size of the input. Only pixels which are not black in "
+			"the mask are shown.")
+		("stats",
+			"Print the time spent in each stage of the computation, and how many "
+			"pixels used each method of solving for the correlation time")
 		;
 
 	po::options_description invisible;
@@ -62,6 +141,79 @@ bool processCommandLine(int argc, char** argv,
 		return false;
 	}
 
+	if (vm.count("contrast")) {
+		if (contrast == "spatial") {
+			options.contrastMode = ComputePipeline::SPATIAL_CONTRAST;
+		} else if (contrast == "temporal") {
+			options.contrastMode = ComputePipeline::TEMPORAL_CONTRAST;
+		} else if (contrast == "spatiotemporal") {
+			options.contrastMode = ComputePipeline::SPATIOTEMPORAL_CONTRAST;
+		} else {
+			std::cout << "Unknown contrast mode \"" << contrast << "\"\n";
+			return false;
+		}
+	}
+
+	if (vm.count("average")) {
+		if (average == "exponential") {
+			options.averageMode = ComputePipeline::EXPONENTIAL_AVERAGE;
+		} else if (average == "boxcar") {
+			options.averageMode = ComputePipeline::BOXCAR_AVERAGE;
+		} else {
+			std::cout << "Unknown average mode \"" << average << "\"\n";
+			return false;
+		}
+	}
+	if (vm.count("output")) {
+		if (outputMode == "colour") {
+			options.outputMode = ComputePipeline::COLOUR_OUTPUT;
+		} else if (outputMode == "contrast") {
+			options.outputMode = ComputePipeline::KSQUARED_OUTPUT;
+		} else if (outputMode == "correlation-time") {
+			options.outputMode = ComputePipeline::CORRELATION_TIME_OUTPUT;
+		} else if (outputMode == "flow") {
+			options.outputMode = ComputePipeline::RELATIVE_FLOW_OUTPUT;
+		} else {
+			std::cout << "Unknown output mode \"" << outputMode << "\"\n";
+			return false;
+		}
+		if (options.outputMode != ComputePipeline::COLOUR_OUTPUT && !isTiffName(output)) {
+			std::cout << "Floating point output must be written to a TIFF file\n";
+			return false;
+		}
+	}
+	options.averageInverse = vm.count("average-inverse") > 0;
+	allPages = vm.count("all-pages") > 0;
+	if (vm.count("roi")) {
+		cv::Rect & rect = options.roi;
+		char end;
+		if (std::sscanf(roi.c_str(), "%d,%d,%d,%d%c",
+			&rect.x, &rect.y, &rect.width, &rect.height, &end) != 4
+			|| rect.empty())
+		{
+			std::cout << "Invalid region of interest \"" << roi << "\"\n";
+			return false;
+		}
+	}
+	if (vm.count("windows")) {
+		std::istringstream list(windowList);
+		std::string item;
+		while (std::getline(list, item, ',')) {
+			int window;
+			char end;
+			if (std::sscanf(item.c_str(), "%d%c", &window, &end) != 1 || window < 1) {
+				windows.clear();
+				break;
+			}
+			windows.push_back(window);
+		}
+		if (windows.empty()) {
+			std::cout << "Invalid window sizes \"" << windowList << "\"\n";
+			return false;
+		}
+	}
+	options.stats = vm.count("stats") > 0;
+
 	return true;
 }
 
@@ -69,69 +221,589 @@ void getOrThrow(TIFF *tif, ttag_t tag, ...) {
 	va_list args;
 	va_start(args, tag);
 	int ret = TIFFVGetField(tif, tag, args);
+	va_end(args);
 	if (!ret) {
-		std::cerr << "Unable to read required TIFF tag\n";
-		std::exit(1);
+		throw std::runtime_error("Unable to read required TIFF tag");
 	}
-	va_end(args);
 }
 
-int main(int argc, char **argv) {
-	ComputePipeline::Options options;
-	std::string inputName;
-	std::string outputName;
+/**
+ * Add a number to a file name, before the extension
+ */
+std::string addFileNameNumber(const std::string & name, const char * format, int number) {
+	size_t dot = name.rfind('.');
+	size_t slash = name.rfind('/');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+		dot = name.size();
+	}
+	char suffix[16];
+	std::snprintf(suffix, sizeof(suffix), format, number);
+	return name.substr(0, dot) + suffix + name.substr(dot);
+}
 
-	if (!processCommandLine(argc, argv, inputName, outputName, options)) {
-		return 1;
+std::string getPageFileName(const std::string & name, int page) {
+	return addFileNameNumber(name, "-%04d", page);
+}
+
+std::string getWindowFileName(const std::string & name, int window) {
+	return addFileNameNumber(name, "-w%02d", window);
+}
+
+/**
+ * A page of the input and its result
+ */
+struct Page {
+	// The page data, which points either into the mapped input file or to
+	// the decoded data in input
+	const uint8_t * data;
+	std::vector<uint8_t> input;
+
+	// The results, one for each output file
+	std::vector<cv::Mat> outputs;
+
+	// True for the page after the last one, which has no data
+	bool end;
+};
+
+typedef SpscQueue<Page*> PageQueue;
+
+/**
+ * Stream the pages of a TIFF file or the frames of a raw capture through
+ * the compute pipeline or a window sweep. A reader thread decodes each page while the
+ * previous page is computed, and a writer thread writes the results. A
+ * fixed number of pages are passed between the threads, so memory use does
+ * not depend on the page count.
+ *
+ * Raw frames and uncompressed TIFF pages are not copied: the pipeline reads
+ * them directly from a mapping of the input file.
+ */
+class PageStream {
+public:
+	/**
+	 * A function which computes the results of a page, one for each output
+	 * file
+	 */
+	typedef std::function<void(const void * data, std::vector<cv::Mat> & outputs)>
+		ComputeFunction;
+
+	/**
+	 * @param tiffInput The TIFF input, or null
+	 * @param rawInput The raw capture input, used if tiffInput is null
+	 * @param outputNames The output file names, one for each result
+	 * @param outputFormat The format of the results, CV_8UC3 or CV_32FC1
+	 */
+	PageStream(TIFF * tiffInput, const RawCaptureReader * rawInput,
+		const std::vector<std::string> & outputNames, bool allPages,
+		const ComputePipeline::Options & options,
+		const cv::Size & outputSize, int outputFormat);
+
+	/**
+	 * Process all remaining pages of the input. If any thread fails, the
+	 * others are stopped and the exception is rethrown here.
+	 */
+	void run(const ComputeFunction & compute);
+
+private:
+	enum {
+		// The number of pages in flight. One is being read, one computed
+		// and one written, with one spare to absorb jitter.
+		DEPTH = 4
+	};
+
+	Page * popPage(PageQueue & queue);
+	void fail();
+	void readerMain();
+	bool readPage(Page & page);
+	void readTiffPage(Page & page);
+	const uint8_t * getMappedPage();
+	void writerMain();
+	void writeTiffPage(TIFF * tif, const cv::Mat & image, int index);
+	void writeOutputFile(const std::string & name, const cv::Mat & image);
+	cv::Mat createOutput(const cv::Size & size) const;
+
+	TIFF * m_input;
+	const RawCaptureReader * m_rawInput;
+	const std::vector<std::string> m_outputNames;
+	const bool m_allPages;
+	const ComputePipeline::Options & m_options;
+	const tsize_t m_lineSize;
+	const int m_outputFormat;
+	std::unique_ptr<MappedFile> m_mappedFile;
+
+	// The index of the next page to read
+	size_t m_pageIndex;
+
+	std::vector<std::unique_ptr<Page>> m_pages;
+	PageQueue m_free;
+	PageQueue m_read;
+	PageQueue m_computed;
+	std::atomic<bool> m_stopping;
+
+	// The exception of the first thread to fail
+	std::mutex m_errorMutex;
+	std::exception_ptr m_error;
+
+	// The results for the last page, when only that is written
+	std::vector<cv::Mat> m_lastResults;
+
+	// A row of a TIFF page being written
+	std::vector<uint8_t> m_row;
+};
+
+PageStream::PageStream(TIFF * tiffInput, const RawCaptureReader * rawInput,
+		const std::vector<std::string> & outputNames, bool allPages,
+		const ComputePipeline::Options & options,
+		const cv::Size & outputSize, int outputFormat)
+	: m_input(tiffInput),
+	m_rawInput(rawInput),
+	m_outputNames(outputNames),
+	m_allPages(allPages),
+	m_options(options),
+	m_lineSize(tiffInput ? TIFFScanlineSize(tiffInput) : 0),
+	m_outputFormat(outputFormat),
+	m_pageIndex(0),
+	m_free(DEPTH),
+	m_read(DEPTH),
+	m_computed(DEPTH),
+	m_stopping(false),
+	m_row(outputSize.width * 4)
+{
+	if (tiffInput) {
+		try {
+			m_mappedFile.reset(new MappedFile(TIFFFileno(tiffInput)));
+		} catch (std::runtime_error & e) {
+			// Decode all pages instead
+		}
 	}
 
-	TIFF *tiffInput = TIFFOpen(inputName.c_str(), "r");
-	if (!tiffInput) {
-		std::cerr << "Unable to open input file\n";
-		return 1;
+	for (int i = 0; i < DEPTH; i++) {
+		m_pages.emplace_back(new Page);
+		Page & page = *m_pages.back();
+		page.data = nullptr;
+		for (size_t j = 0; j < m_outputNames.size(); j++) {
+			page.outputs.push_back(createOutput(outputSize));
+		}
+		page.end = false;
+		m_free.tryPush(&page);
+	}
+	for (size_t j = 0; j < m_outputNames.size(); j++) {
+		m_lastResults.push_back(createOutput(outputSize));
 	}
+}
 
-	uint32_t width, height;
-	uint16_t samplesPerPixel, bitsPerSample;
+/**
+ * Make an output image. The pipeline does not write the border of the
+ * output or pixels outside the mask, so these are black, or NaN for
+ * floating point values.
+ */
+cv::Mat PageStream::createOutput(const cv::Size & size) const {
+	if (m_outputFormat == CV_32FC1) {
+		return cv::Mat(size, CV_32FC1,
+			cv::Scalar(std::numeric_limits<float>::quiet_NaN()));
+	}
+	return cv::Mat::zeros(size, m_outputFormat);
+}
 
-	getOrThrow(tiffInput, TIFFTAG_IMAGEWIDTH, &width);
-	getOrThrow(tiffInput, TIFFTAG_IMAGELENGTH, &height);
-	getOrThrow(tiffInput, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
-	getOrThrow(tiffInput, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
+void PageStream::run(const ComputeFunction & compute) {
+	std::thread reader([this] { readerMain(); });
+	std::thread writer([this] { writerMain(); });
 
-	if (samplesPerPixel != 1) {
-		std::cerr << "Colour input images are not yet supported\n";
-		return 1;
+	try {
+		while (true) {
+			Page * page = popPage(m_read);
+			if (!page) {
+				break;
+			}
+			if (!page->end) {
+				compute(page->data, page->outputs);
+			}
+			// There is room in every queue for every page, so this cannot fail
+			m_computed.tryPush(page);
+			if (page->end) {
+				break;
+			}
+		}
+	} catch (...) {
+		fail();
 	}
 
-	tsize_t lineSize = TIFFScanlineSize(tiffInput);
+	reader.join();
+	writer.join();
+	if (m_error) {
+		std::rethrow_exception(m_error);
+	}
+}
 
-	if (height > std::numeric_limits<int>::max() / lineSize) {
-		std::cerr << "Image too large\n";
-		return 1;
+/**
+ * Wait for a page from the given queue. Return null if another thread
+ * failed.
+ */
+Page * PageStream::popPage(PageQueue & queue) {
+	int idleCount = 0;
+	Page * page;
+	while (!queue.tryPop(page)) {
+		if (m_stopping) {
+			return nullptr;
+		}
+		backoff(idleCount);
 	}
+	return page;
+}
 
-	std::vector<uint8_t> buffer(height * lineSize);
+/**
+ * Record the current exception and stop the other threads
+ */
+void PageStream::fail() {
+	std::lock_guard<std::mutex> lock(m_errorMutex);
+	if (!m_error) {
+		m_error = std::current_exception();
+	}
+	m_stopping = true;
+}
 
-	for (uint32_t y = 0; y < height; y++) {
-		if (1 != TIFFReadScanline(tiffInput, &(buffer[y * lineSize]), y, 0)) {
-			std::cerr << "Error reading TIFF file\n";
-			return 1;
+void PageStream::readerMain() {
+	try {
+		bool end = false;
+		while (!end) {
+			Page * page = popPage(m_free);
+			if (!page) {
+				return;
+			}
+			end = page->end = !readPage(*page);
+			m_read.tryPush(page);
 		}
+	} catch (...) {
+		fail();
 	}
-	TIFFClose(tiffInput);
+}
 
-	options.width = width;
-	options.height = height;
-	options.bitsPerPixel = bitsPerSample;
-	options.frameSize = height * width * bitsPerSample / 8;
+/**
+ * Read the next page of the input. Return false if there are no more.
+ */
+bool PageStream::readPage(Page & page) {
+	if (m_rawInput) {
+		if (m_pageIndex >= m_rawInput->getFrameCount()) {
+			return false;
+		}
+		page.data = m_rawInput->getFrame(m_pageIndex++);
+		return true;
+	}
+	if (m_pageIndex++ > 0 && !TIFFReadDirectory(m_input)) {
+		return false;
+	}
+	readTiffPage(page);
+	return true;
+}
+
+void PageStream::readTiffPage(Page & page) {
+	uint32_t pageWidth, pageHeight;
+	uint16_t pageBitsPerSample;
+	getOrThrow(m_input, TIFFTAG_IMAGEWIDTH, &pageWidth);
+	getOrThrow(m_input, TIFFTAG_IMAGELENGTH, &pageHeight);
+	getOrThrow(m_input, TIFFTAG_BITSPERSAMPLE, &pageBitsPerSample);
+	if ((int)pageWidth != m_options.width
+		|| (int)pageHeight != m_options.height
+		|| pageBitsPerSample != m_options.bitsPerPixel)
+	{
+		throw std::runtime_error("All pages of the input must have the same size and format");
+	}
+
+	page.data = getMappedPage();
+	if (page.data) {
+		return;
+	}
+
+	// The buffer is only allocated if some page needs decoding
+	page.input.resize((size_t)m_lineSize * m_options.height);
+	for (int y = 0; y < m_options.height; y++) {
+		if (1 != TIFFReadScanline(m_input, &(page.input[y * m_lineSize]), y, 0)) {
+			throw std::runtime_error("Error reading TIFF file");
+		}
+	}
+	page.data = &page.input[0];
+}
+
+/**
+ * If the current page is stored in the file exactly as the pipeline needs
+ * it, return a pointer to it in the mapped file, otherwise return null.
+ */
+const uint8_t * PageStream::getMappedPage() {
+	if (!m_mappedFile || TIFFIsTiled(m_input)) {
+		return nullptr;
+	}
+
+	uint16_t compression, fillOrder;
+	TIFFGetFieldDefaulted(m_input, TIFFTAG_COMPRESSION, &compression);
+	TIFFGetFieldDefaulted(m_input, TIFFTAG_FILLORDER, &fillOrder);
+	if (compression != COMPRESSION_NONE || fillOrder != FILLORDER_MSB2LSB) {
+		return nullptr;
+	}
+	// libtiff swaps the bytes of 16-bit samples from a foreign-endian file
+	if (m_options.bitsPerPixel == 16 && TIFFIsByteSwapped(m_input)) {
+		return nullptr;
+	}
+	// The pipeline expects rows without padding
+	if ((int64_t)m_lineSize * 8 != (int64_t)m_options.width * m_options.bitsPerPixel) {
+		return nullptr;
+	}
+
+	// The strips must be contiguous
+	uint64_t * offsets;
+	uint64_t * byteCounts;
+	if (!TIFFGetField(m_input, TIFFTAG_STRIPOFFSETS, &offsets)
+		|| !TIFFGetField(m_input, TIFFTAG_STRIPBYTECOUNTS, &byteCounts))
+	{
+		return nullptr;
+	}
+	uint32_t numStrips = TIFFNumberOfStrips(m_input);
+	uint64_t length = 0;
+	for (uint32_t i = 0; i < numStrips; i++) {
+		if (offsets[i] != offsets[0] + length) {
+			return nullptr;
+		}
+		length += byteCounts[i];
+	}
+	if (length < m_options.frameSize) {
+		return nullptr;
+	}
+	return m_mappedFile->getRange(offsets[0], m_options.frameSize);
+}
+
+void PageStream::writerMain() {
+	std::vector<TIFF*> tifs(m_outputNames.size(), nullptr);
+	try {
+		for (size_t i = 0; i < m_outputNames.size(); i++) {
+			if (m_allPages && isTiffName(m_outputNames[i])) {
+				tifs[i] = TIFFOpen(m_outputNames[i].c_str(), "w");
+				if (!tifs[i]) {
+					throw std::runtime_error("Unable to open output file");
+				}
+			}
+		}
+
+		for (int index = 0; ; index++) {
+			Page * page = popPage(m_computed);
+			if (!page) {
+				break;
+			}
+			if (page->end) {
+				m_free.tryPush(page);
+				for (size_t i = 0; i < m_outputNames.size(); i++) {
+					if (!m_allPages && index > 0) {
+						writeOutputFile(m_outputNames[i], m_lastResults[i]);
+					}
+				}
+				break;
+			}
+
+			for (size_t i = 0; i < m_outputNames.size(); i++) {
+				cv::Mat & output = page->outputs[i];
+				if (tifs[i]) {
+					writeTiffPage(tifs[i], output, index);
+				} else if (m_allPages) {
+					writeOutputFile(getPageFileName(m_outputNames[i], index), output);
+				} else {
+					// Keep the result, and give the page the old one to reuse
+					std::swap(m_lastResults[i], output);
+				}
+			}
+			m_free.tryPush(page);
+		}
+	} catch (...) {
+		fail();
+	}
+	for (TIFF * tif : tifs) {
+		if (tif) {
+			TIFFClose(tif);
+		}
+	}
+}
+
+/**
+ * Write an image to a file of its own. Floating point images are written
+ * with libtiff, which unlike OpenCV keeps them as they are.
+ */
+void PageStream::writeOutputFile(const std::string & name, const cv::Mat & image) {
+	if (image.type() != CV_32FC1) {
+		if (!cv::imwrite(name, image)) {
+			throw std::runtime_error("Unable to write output file");
+		}
+		return;
+	}
+	TIFF * tif = TIFFOpen(name.c_str(), "w");
+	if (!tif) {
+		throw std::runtime_error("Unable to open output file");
+	}
+	try {
+		writeTiffPage(tif, image, 0);
+	} catch (...) {
+		TIFFClose(tif);
+		throw;
+	}
+	TIFFClose(tif);
+}
+
+/**
+ * Write a BGR image as a page of an RGB TIFF file, or a CV_32FC1 image as a
+ * page of floating point samples
+ */
+void PageStream::writeTiffPage(TIFF * tif, const cv::Mat & image, int index) {
+	const bool values = image.type() == CV_32FC1;
+	TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, image.cols);
+	TIFFSetField(tif, TIFFTAG_IMAGELENGTH, image.rows);
+	if (values) {
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+		TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 1);
+		TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 32);
+		TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, SAMPLEFORMAT_IEEEFP);
+	} else {
+		TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+		TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+		TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+	}
+	TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+	TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+	TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
+	TIFFSetField(tif, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+	TIFFSetField(tif, TIFFTAG_PAGENUMBER, index, 0);
+	TIFFSetField(tif, TIFFTAG_SOFTWARE, "libspeckle");
+
+	for (int y = 0; y < image.rows; y++) {
+		if (values) {
+			// libtiff may modify the row it is given, so copy it
+			std::memcpy(&m_row[0], image.ptr(y), image.cols * sizeof(float));
+		} else {
+			const cv::Vec3b * src = image.ptr<cv::Vec3b>(y);
+			for (int x = 0; x < image.cols; x++) {
+				m_row[x * 3] = src[x][2];
+				m_row[x * 3 + 1] = src[x][1];
+				m_row[x * 3 + 2] = src[x][0];
+			}
+		}
+		if (TIFFWriteScanline(tif, &m_row[0], y, 0) < 0) {
+			throw std::runtime_error("Error writing TIFF file");
+		}
+	}
+	if (!TIFFWriteDirectory(tif)) {
+		throw std::runtime_error("Error writing TIFF file");
+	}
+}
+
+int main(int argc, char **argv) {
+	ComputePipeline::Options options;
+	std::string inputName;
+	std::string outputName;
+	std::string maskName;
+	std::vector<int> windows;
+	bool allPages;
+
+	if (!processCommandLine(argc, argv, inputName, outputName, allPages, maskName,
+		windows, options))
+	{
+		return 1;
+	}
+
+	TIFF *tiffInput = nullptr;
+	try {
+		std::unique_ptr<RawCaptureReader> rawInput;
+		if (RawCaptureReader::isRawCapture(inputName)) {
+			rawInput.reset(new RawCaptureReader(inputName));
+			const RawCaptureFormat & format = rawInput->getFormat();
+			if (format.samplesPerPixel != 1) {
+				throw std::runtime_error("Colour input images are not yet supported");
+			}
+			options.width = format.width;
+			options.height = format.height;
+			options.bitsPerPixel = format.bitsPerSample;
+		} else {
+			tiffInput = TIFFOpen(inputName.c_str(), "r");
+			if (!tiffInput) {
+				throw std::runtime_error("Unable to open input file");
+			}
+
+			uint32_t width, height;
+			uint16_t samplesPerPixel, bitsPerSample;
+
+			getOrThrow(tiffInput, TIFFTAG_IMAGEWIDTH, &width);
+			getOrThrow(tiffInput, TIFFTAG_IMAGELENGTH, &height);
+			getOrThrow(tiffInput, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel);
+			getOrThrow(tiffInput, TIFFTAG_BITSPERSAMPLE, &bitsPerSample);
 
-	cv::Mat result;
+			if (samplesPerPixel != 1) {
+				throw std::runtime_error("Colour input images are not yet supported");
+			}
 
-	ComputePipeline compute(options);
-	compute.writeFrame(&(buffer[0]), options.frameSize, result, CV_8UC3);
+			tsize_t lineSize = TIFFScanlineSize(tiffInput);
 
-	cv::imwrite(outputName, result);
+			if (height > std::numeric_limits<int>::max() / lineSize) {
+				throw std::runtime_error("Image too large");
+			}
+
+			options.width = width;
+			options.height = height;
+			options.bitsPerPixel = bitsPerSample;
+		}
+		options.frameSize = (size_t)options.height * options.width * options.bitsPerPixel / 8;
+		// Only the colour image is written, if any
+		options.displayOnly = true;
+		const int format = options.outputMode == ComputePipeline::COLOUR_OUTPUT
+			? CV_8UC3 : CV_32FC1;
+
+		if (maskName.size()) {
+			options.mask = cv::imread(maskName, cv::IMREAD_GRAYSCALE);
+			if (options.mask.empty()) {
+				throw std::runtime_error("Unable to read the mask");
+			}
+		}
 
+		if (windows.size()) {
+			WindowSweep sweep(options, windows);
+			std::vector<std::string> outputNames;
+			for (int window : windows) {
+				outputNames.push_back(getWindowFileName(outputName, window));
+			}
+			PageStream stream(tiffInput, rawInput.get(), outputNames, allPages, options,
+				sweep.getOutputSize(), format);
+			stream.run([&](const void * data, std::vector<cv::Mat> & outputs) {
+				sweep.writeFrame(data, options.frameSize, outputs, format);
+			});
+
+			for (int i = 0; i < sweep.getWindowCount(); i++) {
+				if (sweep.getPipeline(i).getRejectedFrameCount()) {
+					std::cerr << "Window " << sweep.getWindow(i) << ": "
+						<< sweep.getPipeline(i).getRejectedFrameCount()
+						<< " page(s) were left out of the average as outliers\n";
+				}
+			}
+			if (options.stats) {
+				std::cerr << sweep.getStats().toString();
+			}
+		} else {
+			ComputePipeline compute(options);
+			PageStream stream(tiffInput, rawInput.get(), {outputName}, allPages, options,
+				compute.getOutputSize(), format);
+			stream.run([&](const void * data, std::vector<cv::Mat> & outputs) {
+				compute.writeFrame(data, options.frameSize, outputs[0], format);
+			});
+
+			if (compute.getRejectedFrameCount()) {
+				std::cerr << compute.getRejectedFrameCount()
+					<< " page(s) were left out of the average as outliers\n";
+			}
+			if (options.stats) {
+				std::cerr << compute.getStats().toString();
+			}
+		}
+	} catch (std::exception & e) {
+		std::cerr << e.what() << "\n";
+		if (tiffInput) {
+			TIFFClose(tiffInput);
+		}
+		return 1;
+	}
+
+	if (tiffInput) {
+		TIFFClose(tiffInput);
+	}
 	return 0;
 }
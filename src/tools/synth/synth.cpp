@@ -0,0 +1,137 @@
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "common/RawCapture.h"
+#include "source/FrameSource.h"
+#include "source/SpeckleGenerator.h"
+
+namespace po = boost::program_options;
+using namespace Speckle;
+
+bool processCommandLine(int argc, char** argv,
+		SpeckleGenerator::Options & options,
+		std::string & output,
+		int & frames)
+{
+	po::options_description visible;
+	std::string mode;
+	double exposure = options.exposure * 1000;
+	double correlationTime = options.correlationTime * 1000;
+
+	visible.add_options()
+		("help",
+			"Show help message and exit")
+		("width", po::value<int>(&options.width),
+			"The frame width in pixels (default 640)")
+		("height", po::value<int>(&options.height),
+			"The frame height in pixels (default 488)")
+		("mode", po::value<std::string>(&mode),
+			"The sample format, as in the capture tool, which may be:\n"
+			"ir8: 8-bit samples.\n"
+			"ir10: 10-bit packed samples (default).\n"
+			"ir16: 10-bit samples zero-padded to 16 bits.")
+		("speckle-size", po::value<int>(&options.speckleSize),
+			"The speckle diameter in pixels (default 1)")
+		("exposure", po::value<double>(&exposure),
+			"The exposure time in milliseconds (default 10)")
+		("correlation-time", po::value<double>(&correlationTime),
+			"The correlation time of the field in milliseconds (default 10)")
+		("frame-rate", po::value<double>(&options.frameRate),
+			"The frame rate, which determines the correlation between frames "
+			"(default 30)")
+		("mean", po::value<double>(&options.meanIntensity),
+			"The mean intensity as a proportion of the full scale (default 0.125)")
+		("sub-exposures", po::value<int>(&options.subExposures),
+			"The number of samples of the field in each exposure, or 0 to choose "
+			"automatically")
+		("frames,f", po::value<int>(&frames),
+			"The number of frames to write (default 100)")
+		("threads", po::value<int>(&options.threads),
+			"Number of threads to use, or 0 for one per CPU (default 1)")
+		("seed", po::value<uint32_t>(&options.seed),
+			"The random seed")
+		;
+
+	po::options_description invisible;
+	invisible.add_options()
+		("dest", po::value<std::string>(&output))
+		;
+
+	po::options_description allDesc;
+	allDesc.add(visible).add(invisible);
+
+	po::positional_options_description positionalDesc;
+	positionalDesc.add("dest", 1);
+
+	po::variables_map vm;
+	po::store(po::command_line_parser(argc, argv)
+			.options(allDesc)
+			.positional(positionalDesc)
+			.run(), vm);
+	po::notify(vm);
+
+	if (vm.count("help") || !vm.count("dest")) {
+		std::cout << "Usage: " << (argc >= 1 ? argv[0] : "synth")
+			<< " [options] <dest>\n"
+			<< "Write simulated speckle frames with a known correlation time to a\n"
+			<< "raw capture file.\n"
+			<< "Accepted options are:\n"
+			<< visible;
+		return false;
+	}
+
+	if (vm.count("mode")) {
+		if (mode == "ir8") {
+			options.bitsPerSample = 8;
+		} else if (mode == "ir10") {
+			options.bitsPerSample = 10;
+		} else if (mode == "ir16") {
+			options.bitsPerSample = 16;
+			options.depth = 10;
+		} else {
+			std::cout << "Unknown mode \"" << mode << "\"\n";
+			return false;
+		}
+	}
+	options.exposure = exposure / 1000;
+	options.correlationTime = correlationTime / 1000;
+	return true;
+}
+
+int main(int argc, char **argv) {
+	SpeckleGenerator::Options options;
+	std::string outputName;
+	int frames = 100;
+
+	if (!processCommandLine(argc, argv, options, outputName, frames)) {
+		return 1;
+	}
+
+	try {
+		SpeckleGenerator generator(options);
+		RawCaptureWriter writer(outputName, generator.getFormat());
+		std::vector<uint8_t> frame(generator.getFormat().getFrameSize());
+		const uint64_t interval = (uint64_t)(FrameSource::TIMESTAMP_RATE / options.frameRate);
+
+		typedef std::chrono::steady_clock Clock;
+		Clock::duration elapsed(0);
+		for (int i = 0; i < frames; i++) {
+			Clock::time_point start = Clock::now();
+			generator.generate(&frame[0]);
+			elapsed += Clock::now() - start;
+			writer.writeFrame(&frame[0], frame.size(), i * interval);
+		}
+		writer.close();
+
+		std::cerr << "Wrote " << frames << " frames with x = " << generator.getX()
+			<< ", generated at "
+			<< frames / std::chrono::duration<double>(elapsed).count() << " fps\n";
+	} catch (std::exception & e) {
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+	return 0;
+}
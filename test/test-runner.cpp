@@ -1,13 +1,31 @@
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <cstdio>
 #include <cstring>
+#include <limits>
 #include <cstdlib>
+#include <memory>
 #include <vector>
 #include <opencv2/core/core.hpp>
 
 #include "compute/SpatialWindow.h"
+#include "compute/IntegralImage.h"
 #include "compute/CorrelationTime.h"
+#include "compute/Unpack.h"
+#include "compute/TemporalWindow.h"
+#include "compute/SpatioTemporalWindow.h"
+#include "compute/RollingAverage.h"
+#include "compute/ColourLookup.h"
+#include "compute/ComputePipeline.h"
+#include "compute/FramePipeline.h"
+#include "compute/WindowSweep.h"
+#include "common/RawCapture.h"
+#include "source/ReplaySource.h"
+#include "source/SyntheticSource.h"
+#include "source/SpeckleGenerator.h"
 
 struct TestError : public std::runtime_error {
 	TestError(const char * msg)
@@ -80,6 +98,29 @@ void assertRoughlyEquals(double actual, double expected) {
 	assertApproxEquals(actual, expected, 1e-3);
 }
 
+std::vector<uint8_t> makeRandomFrame(size_t size, uint32_t seed) {
+	std::vector<uint8_t> data(size);
+	for (size_t i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = seed >> 24;
+	}
+	return data;
+}
+
+/**
+ * Make an image of random samples of the given depth
+ */
+cv::Mat makeRandomImage(int width, int height, int bpp, uint32_t seed) {
+	cv::Mat image(height, width, CV_16UC1);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			seed = seed * 1103515245 + 12345;
+			image.at<uint16_t>(y, x) = (seed >> 8) & ((1 << bpp) - 1);
+		}
+	}
+	return image;
+}
+
 bool testSpatialWindow(std::ifstream & f) {
 	while (true) {
 		int window = -1;
@@ -135,6 +176,7 @@ bool testSpatialWindow(std::ifstream & f) {
 		Speckle::SpatialWindow spatialWindow(window, input.cols);
 		spatialWindow.startFrame();
 		Speckle::ComputePos pos;
+		cv::Mat pixelResult(expected.rows, expected.cols, CV_64FC1);
 		for (pos.y = 0; pos.y < input.rows; pos.y++) {
 			for (pos.x = 0; pos.x < input.cols; pos.x++) {
 				pos.outX = pos.outY = -1;
@@ -148,6 +190,40 @@ bool testSpatialWindow(std::ifstream & f) {
 				assertEquals(pos.outX, pos.x - offset, "outY");
 				double k = expected.at<double>(pos.y - window + 1, pos.x - window + 1);
 				assertApproxEquals(value, k * k);
+				pixelResult.at<double>(pos.y - window + 1, pos.x - window + 1) = value;
+			}
+		}
+
+		// The row interface must give exactly the same result
+		Speckle::SpatialWindow rowWindow(window, input.cols);
+		rowWindow.startFrame();
+		assertEquals(rowWindow.getOutputWidth(), expected.cols, "output width");
+		std::vector<double> row(rowWindow.getOutputWidth());
+		for (int y = 0; y < input.rows; y++) {
+			int outY = rowWindow.computeRow(input.ptr<uint16_t>(y), &row[0]);
+			if (y < window - 1) {
+				assertEquals(outY, -1, "row outY");
+				continue;
+			}
+			assertEquals(outY, y - offset, "row outY");
+			for (int x = 0; x < expected.cols; x++) {
+				assertEquals(row[x], pixelResult.at<double>(y - window + 1, x), "row K^2");
+			}
+		}
+		assertEquals(rowWindow.getOffset(), window - 1 - offset, "row offset");
+
+		// So must the 64-bit variant
+		Speckle::WideSpatialWindow wideWindow(window, input.cols);
+		wideWindow.startFrame();
+		for (int y = 0; y < input.rows; y++) {
+			int outY = wideWindow.computeRow(input.ptr<uint16_t>(y), &row[0]);
+			if (y < window - 1) {
+				assertEquals(outY, -1, "wide outY");
+				continue;
+			}
+			assertEquals(outY, y - offset, "wide outY");
+			for (int x = 0; x < expected.cols; x++) {
+				assertEquals(row[x], pixelResult.at<double>(y - window + 1, x), "wide K^2");
 			}
 		}
 
@@ -155,6 +231,234 @@ bool testSpatialWindow(std::ifstream & f) {
 	}
 }
 
+/**
+ * Compute a row of K² with the given window type, and compare it against a
+ * direct calculation in long double, which is exact for the sums
+ */
+template <class Window>
+void checkSpatialWindowRows(const cv::Mat & input, int window) {
+	Window spatialWindow(window, input.cols);
+	spatialWindow.startFrame();
+	const int area = window * window;
+	std::vector<double> row(spatialWindow.getOutputWidth());
+	for (int y = 0; y < input.rows; y++) {
+		int outY = spatialWindow.computeRow(input.ptr<uint16_t>(y), &row[0]);
+		if (outY < 0) {
+			continue;
+		}
+		for (int x = 0; x < spatialWindow.getOutputWidth(); x++) {
+			long double sum = 0;
+			long double sumSq = 0;
+			for (int i = y - window + 1; i <= y; i++) {
+				for (int j = x; j < x + window; j++) {
+					long double value = input.at<uint16_t>(i, j);
+					sum += value;
+					sumSq += value * value;
+				}
+			}
+			long double kSq = (area * sumSq - sum * sum) / (area - 1) / sum / sum * area;
+			assertApproxEquals(row[x], (double)kSq, 1e-12);
+		}
+	}
+}
+
+/**
+ * Compare each window size of a multi-window with a single window of that
+ * size, which must give exactly the same rows
+ */
+template <class MultiWindow, class Window>
+void checkMultiSpatialWindowRows(const cv::Mat & input, const std::vector<int> & windows) {
+	MultiWindow multiWindow(windows, input.cols);
+	std::vector<std::unique_ptr<Window>> single;
+	for (int window : windows) {
+		single.emplace_back(new Window(window, input.cols));
+	}
+	// Two frames, so that the second starts with stale sums
+	for (int frame = 0; frame < 2; frame++) {
+		multiWindow.startFrame();
+		for (size_t i = 0; i < windows.size(); i++) {
+			single[i]->startFrame();
+		}
+		for (int y = 0; y < input.rows; y++) {
+			multiWindow.addRow(input.ptr<uint16_t>(y));
+			for (size_t i = 0; i < windows.size(); i++) {
+				const int width = single[i]->getOutputWidth();
+				assertEquals(multiWindow.getOutputWidth(i), width, "multi-window output width");
+				assertEquals(multiWindow.getOffset(i), single[i]->getOffset(), "multi-window offset");
+				std::vector<double> expected(width);
+				std::vector<double> actual(width);
+				int expectedY = single[i]->computeRow(input.ptr<uint16_t>(y), &expected[0]);
+				int actualY = multiWindow.computeRow(i, &actual[0]);
+				assertEquals(actualY, expectedY, "multi-window outY");
+				if (actualY >= 0 && std::memcmp(&actual[0], &expected[0], width * sizeof(double))) {
+					throw TestError("Failed assertion: \"multi-window K^2\": window "
+						+ std::to_string(windows[i]) + " row " + std::to_string(y) + " differs");
+				}
+			}
+		}
+	}
+}
+
+bool testSpatialWindowOverflow(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	cv::Mat cases = readMatrix<int>(f, CV_32SC1);
+	for (int i = 0; i < cases.rows; i++) {
+		int bpp = cases.at<int>(i, 0);
+		int window = cases.at<int>(i, 1);
+		int width = cases.at<int>(i, 2);
+		int height = cases.at<int>(i, 3);
+		int accumulator = cases.at<int>(i, 4);
+		std::cout << "SpatialWindow overflow " << bpp << "-bit w" << window << ": ";
+
+		assertEquals(Speckle::SpatialWindow::fits(bpp, window), accumulator == 32,
+			"32-bit sums fit");
+		assertEquals(Speckle::WideSpatialWindow::fits(bpp, window), accumulator != 0,
+			"64-bit sums fit");
+
+		Speckle::ComputePipeline::Options options;
+		options.width = width;
+		options.height = height;
+		options.bitsPerPixel = bpp;
+		options.spatialWindow = window;
+		options.frameSize = (size_t)width * height * bpp / 8;
+		if (accumulator == 0) {
+			bool thrown = false;
+			try {
+				Speckle::ComputePipeline pipeline(options);
+			} catch (std::runtime_error & e) {
+				thrown = true;
+			}
+			assertEquals(thrown, true, "pipeline rejects window");
+			std::cout << "OK\n";
+			continue;
+		}
+
+		// Mostly saturated input, so that the sums are close to their
+		// maximum, with enough noise for the variance to be non-zero. The
+		// top left window is fully saturated.
+		const int maxValue = (1 << bpp) - 1;
+		cv::Mat input = makeRandomImage(width, height, bpp, 1);
+		cv::Mat noise = makeRandomImage(width, height, 3, 2);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				if (noise.at<uint16_t>(y, x) != 0 || (x < window && y < window)) {
+					input.at<uint16_t>(y, x) = maxValue;
+				}
+			}
+		}
+
+		if (accumulator == 32) {
+			checkSpatialWindowRows<Speckle::SpatialWindow>(input, window);
+			checkMultiSpatialWindowRows<Speckle::MultiSpatialWindow, Speckle::SpatialWindow>(
+				input, {window, 3});
+		}
+		checkSpatialWindowRows<Speckle::WideSpatialWindow>(input, window);
+		checkMultiSpatialWindowRows<Speckle::WideMultiSpatialWindow, Speckle::WideSpatialWindow>(
+			input, {window, 3});
+		std::cout << "OK\n";
+	}
+	return true;
+}
+
+/**
+ * Compute K² over a rectangle directly, in long double
+ */
+double getDirectKSquared(const cv::Mat & input, const cv::Rect & rect) {
+	long double sum = 0;
+	long double sumSq = 0;
+	for (int y = rect.y; y < rect.y + rect.height; y++) {
+		for (int x = rect.x; x < rect.x + rect.width; x++) {
+			long double value = input.at<uint16_t>(y, x);
+			sum += value;
+			sumSq += value * value;
+		}
+	}
+	const long double area = rect.area();
+	if (sum == 0 || area < 2) {
+		return 0.0;
+	}
+	return (double)((area * sumSq - sum * sum) / (area - 1) / sum / sum * area);
+}
+
+bool testIntegralImage(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	cv::Mat cases = readMatrix<int>(f, CV_32SC1);
+	for (int i = 0; i < cases.rows; i++) {
+		const int width = cases.at<int>(i, 0);
+		const int height = cases.at<int>(i, 1);
+		const int bpp = cases.at<int>(i, 2);
+		const int window = cases.at<int>(i, 3);
+		std::cout << "IntegralImage " << width << "x" << height << " " << bpp
+			<< "-bit w" << window << ": ";
+
+		cv::Mat input = makeRandomImage(width, height, bpp, i + 1);
+		Speckle::IntegralImage integral(width, height);
+		integral.compute(input);
+
+		// Sums over random rectangles, including empty ones and the whole
+		// frame
+		cv::Mat corners = makeRandomImage(4, 200, 16, i + 101);
+		for (int j = 0; j < 200; j++) {
+			cv::Rect rect(0, 0, width, height);
+			if (j) {
+				rect.x = corners.at<uint16_t>(j, 0) % (width + 1);
+				rect.y = corners.at<uint16_t>(j, 1) % (height + 1);
+				rect.width = corners.at<uint16_t>(j, 2) % (width - rect.x + 1);
+				rect.height = corners.at<uint16_t>(j, 3) % (height - rect.y + 1);
+			}
+			uint64_t sum = 0;
+			uint64_t sumSq = 0;
+			for (int y = rect.y; y < rect.y + rect.height; y++) {
+				for (int x = rect.x; x < rect.x + rect.width; x++) {
+					uint64_t value = input.at<uint16_t>(y, x);
+					sum += value;
+					sumSq += value * value;
+				}
+			}
+			assertEquals(integral.getSum(rect), sum, "rectangle sum");
+			assertEquals(integral.getSumSq(rect), sumSq, "rectangle sum of squares");
+			assertApproxEquals(integral.getKSquared(rect), getDirectKSquared(input, rect),
+				1e-12);
+		}
+
+		// The rows must be identical to those of the ring buffer
+		Speckle::WideSpatialWindow spatialWindow(window, width);
+		spatialWindow.startFrame();
+		std::vector<double> expected(spatialWindow.getOutputWidth());
+		std::vector<double> actual(spatialWindow.getOutputWidth());
+		for (int y = 0; y < height; y++) {
+			int outY = spatialWindow.computeRow(input.ptr<uint16_t>(y), &expected[0]);
+			if (outY < 0) {
+				continue;
+			}
+			integral.computeRow(window, y - window + 1, &actual[0]);
+			if (std::memcmp(&actual[0], &expected[0], actual.size() * sizeof(double))) {
+				throw TestError("Failed assertion: \"integral image row\": row "
+					+ std::to_string(y) + " differs");
+			}
+		}
+
+		// Windows at a point are clipped to the frame at the edges
+		const int offset = window - 1 - window / 2;
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				const cv::Rect rect = cv::Rect(x - offset, y - offset, window, window)
+					& cv::Rect(0, 0, width, height);
+				assertApproxEquals(integral.getKSquared(x, y, window),
+					getDirectKSquared(input, rect), 1e-12);
+			}
+		}
+		std::cout << "OK\n";
+	}
+	return true;
+}
+
 bool testCorrelationTime(std::ifstream & f) {
 	// Header line
 	std::string line;
@@ -183,6 +487,1047 @@ bool testCorrelationTime(std::ifstream & f) {
 		assertRoughlyEquals(corr.compute(pos, ksq), x);
 	}
 	std::cout << "OK\n";
+
+	// The row interface is vectorised, and must agree with compute()
+	std::cout << "Compute x from k^2, row: ";
+	for (int i = 0; i < data.rows; i++) {
+		double x = data.at<double>(i, 0);
+		double beta = data.at<double>(i, 1);
+		double ksq = data.at<double>(i, 2);
+		Speckle::CorrelationTime corr(1024, beta);
+		Speckle::ComputePos pos;
+		std::vector<double> kSqRow(9, ksq);
+		std::vector<double> xRow(kSqRow.size());
+		corr.computeRow(&kSqRow[0], &xRow[0], kSqRow.size());
+		for (size_t j = 0; j < xRow.size(); j++) {
+			assertRoughlyEquals(xRow[j], x);
+			assertApproxEquals(xRow[j], corr.compute(pos, ksq));
+		}
+	}
+	Speckle::CorrelationTime corr(1024, 1.0);
+	Speckle::ComputePos pos;
+	std::vector<double> kSqRow(12001);
+	std::vector<double> xRow(kSqRow.size());
+	for (size_t j = 0; j < kSqRow.size(); j++) {
+		kSqRow[j] = j * 1e-4;
+	}
+	corr.computeRow(&kSqRow[0], &xRow[0], kSqRow.size());
+	for (size_t j = 0; j < kSqRow.size(); j++) {
+		assertApproxEquals(xRow[j], corr.compute(pos, kSqRow[j]));
+		// Each value is the same wherever it is in the row
+		double single;
+		corr.computeRow(&kSqRow[j], &single, 1);
+		assertEquals(single, xRow[j], "row value");
+	}
+	std::cout << "OK\n";
+	return true;
+}
+
+bool testUnpack(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	cv::Mat cases = readMatrix<int>(f, CV_32SC1);
+	for (int i = 0; i < cases.rows; i++) {
+		int bpp = cases.at<int>(i, 0);
+		int width = cases.at<int>(i, 1);
+		int height = cases.at<int>(i, 2);
+		std::cout << "Unpack " << bpp << "-bit " << width << "x" << height << ": ";
+
+		size_t frameSize = ((size_t)width * height * bpp + 7) / 8;
+		std::vector<uint8_t> data = makeRandomFrame(frameSize, 12345);
+
+		// The per-pixel interface is the reference
+		Speckle::Unpack pixelUnpack(frameSize, bpp);
+		Speckle::Unpack rowUnpack(frameSize, bpp);
+		pixelUnpack.startFrame(&data[0]);
+		rowUnpack.startFrame(&data[0]);
+		std::vector<uint16_t> row(width);
+		Speckle::ComputePos pos;
+		for (pos.y = 0; pos.y < height; pos.y++) {
+			rowUnpack.computeRow(&row[0], width);
+			for (pos.x = 0; pos.x < width; pos.x++) {
+				assertEquals((int)row[pos.x], pixelUnpack.compute(pos), "pixel value");
+			}
+		}
+		std::cout << "OK\n";
+	}
+	return true;
+}
+
+void assertMatEquals(const cv::Mat & actual, const cv::Mat & expected, const char * msg) {
+	assertEquals(actual.rows, expected.rows, msg);
+	assertEquals(actual.cols, expected.cols, msg);
+	assertEquals(actual.type(), expected.type(), msg);
+	for (int y = 0; y < actual.rows; y++) {
+		if (std::memcmp(actual.ptr(y), expected.ptr(y), actual.cols * actual.elemSize())) {
+			throw TestError(std::string("Failed assertion: \"") + msg +
+				"\": row " + std::to_string(y) + " differs");
+		}
+	}
+}
+
+/**
+ * Make a mask of stripes of various widths, so that rows have several spans
+ */
+cv::Mat makeStripeMask(int width, int height) {
+	cv::Mat mask(height, width, CV_8UC1);
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			mask.at<uint8_t>(y, x) = (x / 3 + y / 5) % 3 ? 255 : 0;
+		}
+	}
+	return mask;
+}
+
+bool testComputePipeline(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	cv::Mat cases = readMatrix<int>(f, CV_32SC1);
+	for (int i = 0; i < cases.rows; i++) {
+		Speckle::ComputePipeline::Options options;
+		options.width = cases.at<int>(i, 0);
+		options.height = cases.at<int>(i, 1);
+		options.bitsPerPixel = cases.at<int>(i, 2);
+		options.spatialWindow = cases.at<int>(i, 3);
+		options.frameSize = (size_t)options.width * options.height * options.bitsPerPixel / 8;
+		int threads = cases.at<int>(i, 4);
+		options.contrastMode = (Speckle::ComputePipeline::ContrastMode)cases.at<int>(i, 5);
+		options.averageMode = (Speckle::ComputePipeline::AverageMode)cases.at<int>(i, 6);
+		options.averageFrames = 3;
+		options.displayOnly = cases.at<int>(i, 7) != 0;
+		options.outputStride = cases.at<int>(i, 8);
+		options.roi = cv::Rect(cases.at<int>(i, 9), cases.at<int>(i, 10),
+			cases.at<int>(i, 11), cases.at<int>(i, 12));
+		if (cases.at<int>(i, 13)) {
+			options.mask = makeStripeMask(options.width, options.height);
+		}
+		std::cout << "ComputePipeline " << options.width << "x" << options.height
+			<< " " << options.bitsPerPixel << "-bit w" << options.spatialWindow
+			<< (options.contrastMode == Speckle::ComputePipeline::TEMPORAL_CONTRAST ? " temporal"
+				: options.contrastMode == Speckle::ComputePipeline::SPATIOTEMPORAL_CONTRAST
+				? " spatio-temporal" : "")
+			<< (options.averageMode != Speckle::ComputePipeline::NO_AVERAGE ? " averaged" : "")
+			<< (options.displayOnly ? " display-only" : "")
+			<< (options.outputStride > 1 ? " stride " + std::to_string(options.outputStride) : "")
+			<< (options.roi.empty() ? "" : " roi " + std::to_string(options.roi.width) + "x"
+				+ std::to_string(options.roi.height) + "+" + std::to_string(options.roi.x)
+				+ "+" + std::to_string(options.roi.y))
+			<< (options.mask.empty() ? "" : " masked")
+			<< ": ";
+
+		const int numFrames = 5;
+		std::vector<std::vector<uint8_t>> frames;
+		for (int j = 0; j < numFrames; j++) {
+			frames.push_back(makeRandomFrame(options.frameSize, j + 1));
+		}
+
+		// Single-threaded writeFrame() is the reference
+		Speckle::ComputePipeline reference(options);
+		const cv::Size size = reference.getOutputSize();
+		std::vector<cv::Mat> expected(numFrames);
+		for (int j = 0; j < numFrames; j++) {
+			expected[j].create(size, CV_8UC4);
+			expected[j].setTo(0);
+			reference.writeFrame(&frames[j][0], options.frameSize, expected[j], CV_8UC4);
+		}
+
+		// Without averaging, the colour lookup of displayOnly must give
+		// exactly the colours of solving and then visualizing
+		if (options.averageMode == Speckle::ComputePipeline::NO_AVERAGE) {
+			Speckle::ComputePipeline::Options otherOptions = options;
+			otherOptions.displayOnly = !options.displayOnly;
+			Speckle::ComputePipeline other(otherOptions);
+			for (int j = 0; j < numFrames; j++) {
+				cv::Mat result(size, CV_8UC4);
+				result.setTo(0);
+				other.writeFrame(&frames[j][0], options.frameSize, result, CV_8UC4);
+				assertMatEquals(result, expected[j], "display-only output");
+			}
+		}
+
+		// With a stride, a region of interest or a mask, each pixel which is
+		// written must match the full output for its input pixel, and the
+		// others must be left alone. The rolling average is not compared,
+		// since its outlier check uses the mean K² of the shown pixels.
+		const bool partial = options.outputStride > 1 || !options.roi.empty()
+			|| !options.mask.empty();
+		if (partial && options.averageMode == Speckle::ComputePipeline::NO_AVERAGE) {
+			Speckle::ComputePipeline::Options fullOptions = options;
+			fullOptions.outputStride = 1;
+			fullOptions.roi = cv::Rect();
+			fullOptions.mask = cv::Mat();
+			Speckle::ComputePipeline full(fullOptions);
+			const int s = options.outputStride;
+			const cv::Rect roi = options.roi.empty()
+				? cv::Rect(0, 0, options.width, options.height) : options.roi;
+			const int window = options.contrastMode == Speckle::ComputePipeline::TEMPORAL_CONTRAST
+				? 1 : options.spatialWindow;
+			const int offset = window - 1 - window / 2;
+			const uint8_t zero[4] = {0, 0, 0, 0};
+			for (int j = 0; j < numFrames; j++) {
+				cv::Mat result(options.height, options.width, CV_8UC4);
+				full.writeFrame(&frames[j][0], options.frameSize, result, CV_8UC4);
+				for (int y = 0; y < size.height; y++) {
+					for (int x = 0; x < size.width; x++) {
+						// The pixel in the region, and in the whole input
+						const int rx = x * s, ry = y * s;
+						const int ix = roi.x + rx, iy = roi.y + ry;
+						const bool written = rx >= offset && rx < roi.width - window + 1 + offset
+							&& ry >= offset && ry < roi.height - window + 1 + offset
+							&& (options.mask.empty() || options.mask.at<uint8_t>(iy, ix));
+						if (std::memcmp(expected[j].ptr(y) + x * 4,
+							written ? result.ptr(iy) + ix * 4 : zero, 4))
+						{
+							throw TestError("Failed assertion: \"partial output\": pixel "
+								+ std::to_string(x) + ", " + std::to_string(y) + " differs");
+						}
+					}
+				}
+			}
+		}
+
+		// Band-parallel output must be identical, with statistics collection
+		// having no effect on it
+		options.threads = threads;
+		options.stats = true;
+		Speckle::ComputePipeline parallel(options);
+		for (int j = 0; j < numFrames; j++) {
+			cv::Mat result(size, CV_8UC4);
+			result.setTo(0);
+			parallel.writeFrame(&frames[j][0], options.frameSize, result, CV_8UC4);
+			assertMatEquals(result, expected[j], "band-parallel output");
+		}
+
+		// So must the output of the frame pipeline, in order
+		Speckle::FramePipeline framePipeline(options, CV_8UC4, 2);
+		int pushed = 0;
+		int popped = 0;
+		while (popped < numFrames) {
+			if (pushed < numFrames
+				&& framePipeline.push(&frames[pushed][0], options.frameSize))
+			{
+				pushed++;
+			}
+			// pop() swaps buffers, so whatever is passed here is only used
+			// for a later frame. An empty one must be replaced by a cleared
+			// buffer, so that the border is still zero.
+			cv::Mat result;
+			if (framePipeline.pop(result)) {
+				assertMatEquals(result, expected[popped], "frame pipeline output");
+				popped++;
+			}
+		}
+
+		// Both see the same K² values, so the branch counts must agree
+		Speckle::PipelineStats stats = parallel.getStats();
+		Speckle::PipelineStats stageStats = framePipeline.getStats();
+		assertEquals((int)stats.frames, numFrames, "frame count");
+		assertEquals((int)stageStats.frames, numFrames, "frame pipeline frame count");
+		const uint64_t pixels = stats.asymptoticPixels + stats.zeroPixels + stats.newtonPixels;
+		assertEquals(pixels > 0 && pixels <= (uint64_t)numFrames * size.area(), true,
+			"branch count total");
+		assertEquals((int)stageStats.asymptoticPixels, (int)stats.asymptoticPixels,
+			"asymptotic count");
+		assertEquals((int)stageStats.zeroPixels, (int)stats.zeroPixels, "zero count");
+		assertEquals((int)stageStats.newtonPixels, (int)stats.newtonPixels, "Newton count");
+		std::cout << "OK\n";
+	}
+	return true;
+}
+
+/**
+ * Make a CV_32FC1 output with NaN in the pixels which are not written
+ */
+cv::Mat makeRawOutput(const cv::Size & size) {
+	return cv::Mat(size, CV_32FC1, cv::Scalar(std::numeric_limits<float>::quiet_NaN()));
+}
+
+bool testRawOutput(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	const Speckle::ComputePipeline::OutputMode modes[] = {
+		Speckle::ComputePipeline::KSQUARED_OUTPUT,
+		Speckle::ComputePipeline::CORRELATION_TIME_OUTPUT,
+		Speckle::ComputePipeline::RELATIVE_FLOW_OUTPUT
+	};
+	const char * modeNames[] = {"K²", "x", "1/x"};
+
+	cv::Mat cases = readMatrix<int>(f, CV_32SC1);
+	for (int i = 0; i < cases.rows; i++) {
+		Speckle::ComputePipeline::Options options;
+		options.width = cases.at<int>(i, 0);
+		options.height = cases.at<int>(i, 1);
+		options.bitsPerPixel = cases.at<int>(i, 2);
+		options.spatialWindow = cases.at<int>(i, 3);
+		options.frameSize = (size_t)options.width * options.height * options.bitsPerPixel / 8;
+		const int threads = cases.at<int>(i, 4);
+		options.contrastMode = (Speckle::ComputePipeline::ContrastMode)cases.at<int>(i, 5);
+		options.averageMode = (Speckle::ComputePipeline::AverageMode)cases.at<int>(i, 6);
+		options.averageFrames = 3;
+		options.outputStride = cases.at<int>(i, 7);
+		if (cases.at<int>(i, 8)) {
+			options.mask = makeStripeMask(options.width, options.height);
+		}
+		// Raw output ignores this
+		options.displayOnly = true;
+		const bool averaged = options.averageMode != Speckle::ComputePipeline::NO_AVERAGE;
+
+		const int numFrames = 3;
+		std::vector<std::vector<uint8_t>> frames;
+		for (int j = 0; j < numFrames; j++) {
+			frames.push_back(makeRandomFrame(options.frameSize, j + 1));
+		}
+
+		for (int m = 0; m < 3; m++) {
+			options.outputMode = modes[m];
+			std::cout << "RawOutput " << options.width << "x" << options.height
+				<< " " << options.bitsPerPixel << "-bit w" << options.spatialWindow
+				<< " mode " << options.contrastMode
+				<< (averaged ? " averaged" : "")
+				<< (options.outputStride > 1 ? " stride " + std::to_string(options.outputStride) : "")
+				<< (options.mask.empty() ? "" : " masked")
+				<< " " << modeNames[m] << ": ";
+
+			if (averaged && options.outputMode == Speckle::ComputePipeline::KSQUARED_OUTPUT) {
+				bool thrown = false;
+				try {
+					Speckle::ComputePipeline pipeline(options);
+				} catch (std::runtime_error & e) {
+					thrown = true;
+				}
+				assertEquals(thrown, true, "averaged K² output is rejected");
+				std::cout << "OK\n";
+				continue;
+			}
+
+			options.threads = 1;
+			Speckle::ComputePipeline pipeline(options);
+			const cv::Size size = pipeline.getOutputSize();
+			bool thrown = false;
+			try {
+				cv::Mat colour;
+				pipeline.writeFrame(&frames[0][0], options.frameSize, colour, CV_8UC4);
+			} catch (std::runtime_error & e) {
+				thrown = true;
+			}
+			assertEquals(thrown, true, "colour format is rejected");
+
+			// The stage interface gives K², and the correlation time which
+			// is written
+			Speckle::ComputePipeline stages(options);
+			options.threads = threads;
+			Speckle::ComputePipeline parallel(options);
+			Speckle::CorrelationTime correlationTime(options.correlationTableSize,
+				options.beta);
+			const int window = options.contrastMode == Speckle::ComputePipeline::TEMPORAL_CONTRAST
+				? 1 : options.spatialWindow;
+			const int offset = window - 1 - window / 2;
+			const int s = options.outputStride;
+			const int strideOffset = (offset + s - 1) / s;
+			for (int j = 0; j < numFrames; j++) {
+				cv::Mat expected = makeRawOutput(size);
+				pipeline.writeFrame(&frames[j][0], options.frameSize, expected, CV_32FC1);
+
+				cv::Mat unpacked, kSq, x;
+				cv::Mat result = makeRawOutput(size);
+				stages.unpackFrame(&frames[j][0], options.frameSize, unpacked);
+				stages.contrastFrame(unpacked, kSq);
+				stages.solveFrame(kSq, x);
+				stages.colouriseFrame(x, result, CV_32FC1);
+				assertMatEquals(result, expected, "stage output");
+
+				result = makeRawOutput(size);
+				parallel.writeFrame(&frames[j][0], options.frameSize, result, CV_32FC1);
+				assertMatEquals(result, expected, "band-parallel output");
+
+				// Without averaging, the values are those of K² and of the
+				// solver, and pixels outside the mask are not written
+				std::vector<double> solved(kSq.cols);
+				for (int y = 0; y < kSq.rows; y++) {
+					correlationTime.computeRow(kSq.ptr<double>(y), &solved[0], kSq.cols);
+					for (int xi = 0; xi < kSq.cols; xi++) {
+						const float value = expected.at<float>(y + strideOffset,
+							xi + strideOffset);
+						const int maskX = (xi + strideOffset) * s;
+						const int maskY = (y + strideOffset) * s;
+						if (!options.mask.empty() && !options.mask.at<uint8_t>(maskY, maskX)) {
+							assertEquals(std::isnan(value), true, "masked pixel");
+							continue;
+						}
+						if (averaged) {
+							assertEquals(std::isnan(value), false, "averaged pixel");
+							continue;
+						}
+						const double raw = modes[m] == Speckle::ComputePipeline::KSQUARED_OUTPUT
+							? kSq.at<double>(y, xi)
+							: modes[m] == Speckle::ComputePipeline::CORRELATION_TIME_OUTPUT
+							? solved[xi] : 1.0 / solved[xi];
+						assertEquals(value, (float)raw, "raw value");
+					}
+				}
+			}
+			std::cout << "OK\n";
+		}
+	}
+	return true;
+}
+
+bool testWindowSweep(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	cv::Mat cases = readMatrix<int>(f, CV_32SC1);
+	for (int i = 0; i < cases.rows; i++) {
+		Speckle::ComputePipeline::Options options;
+		options.width = cases.at<int>(i, 0);
+		options.height = cases.at<int>(i, 1);
+		options.bitsPerPixel = cases.at<int>(i, 2);
+		options.frameSize = (size_t)options.width * options.height * options.bitsPerPixel / 8;
+		std::vector<int> windows;
+		for (int j = 3; j < 7; j++) {
+			if (cases.at<int>(i, j)) {
+				windows.push_back(cases.at<int>(i, j));
+			}
+		}
+		options.threads = cases.at<int>(i, 7);
+		options.averageMode = (Speckle::ComputePipeline::AverageMode)cases.at<int>(i, 8);
+		options.averageFrames = 3;
+		options.displayOnly = cases.at<int>(i, 9) != 0;
+		options.outputStride = cases.at<int>(i, 10);
+		options.roi = cv::Rect(cases.at<int>(i, 11), cases.at<int>(i, 12),
+			cases.at<int>(i, 13), cases.at<int>(i, 14));
+		if (cases.at<int>(i, 15)) {
+			options.mask = makeStripeMask(options.width, options.height);
+		}
+		std::cout << "WindowSweep " << options.width << "x" << options.height
+			<< " " << options.bitsPerPixel << "-bit w";
+		for (size_t j = 0; j < windows.size(); j++) {
+			std::cout << (j ? "," : "") << windows[j];
+		}
+		std::cout << (options.averageMode != Speckle::ComputePipeline::NO_AVERAGE ? " averaged" : "")
+			<< (options.displayOnly ? " display-only" : "")
+			<< (options.outputStride > 1 ? " stride " + std::to_string(options.outputStride) : "")
+			<< (options.roi.empty() ? "" : " roi")
+			<< (options.mask.empty() ? "" : " masked")
+			<< ": ";
+
+		const int numFrames = 4;
+		std::vector<std::vector<uint8_t>> frames;
+		for (int j = 0; j < numFrames; j++) {
+			frames.push_back(makeRandomFrame(options.frameSize, j + 1));
+		}
+
+		// The K² rows must match those of a single window of each size
+		cv::Mat unpacked;
+		Speckle::ComputePipeline(options).unpackFrame(&frames[0][0], options.frameSize,
+			unpacked);
+		if (Speckle::SpatialWindow::fits(options.bitsPerPixel,
+			*std::max_element(windows.begin(), windows.end())))
+		{
+			checkMultiSpatialWindowRows<Speckle::MultiSpatialWindow, Speckle::SpatialWindow>(
+				unpacked, windows);
+		}
+		checkMultiSpatialWindowRows<Speckle::WideMultiSpatialWindow, Speckle::WideSpatialWindow>(
+			unpacked, windows);
+
+		// The output for each window size must be identical to that of a
+		// separate pipeline with that size
+		Speckle::WindowSweep sweep(options, windows);
+		std::vector<std::unique_ptr<Speckle::ComputePipeline>> references;
+		for (int window : windows) {
+			Speckle::ComputePipeline::Options windowOptions = options;
+			windowOptions.spatialWindow = window;
+			windowOptions.threads = 1;
+			references.emplace_back(new Speckle::ComputePipeline(windowOptions));
+		}
+		const cv::Size size = sweep.getOutputSize();
+		for (int j = 0; j < numFrames; j++) {
+			std::vector<cv::Mat> results(windows.size());
+			for (cv::Mat & result : results) {
+				result = cv::Mat::zeros(size, CV_8UC4);
+			}
+			sweep.writeFrame(&frames[j][0], options.frameSize, results, CV_8UC4);
+			assertEquals(results.size(), windows.size(), "output count");
+			for (size_t k = 0; k < windows.size(); k++) {
+				cv::Mat expected = cv::Mat::zeros(size, CV_8UC4);
+				references[k]->writeFrame(&frames[j][0], options.frameSize, expected, CV_8UC4);
+				assertMatEquals(results[k], expected, "window sweep output");
+			}
+		}
+		std::cout << "OK\n";
+	}
+	return true;
+}
+
+bool testTemporalWindow(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	cv::Mat cases = readMatrix<int>(f, CV_32SC1);
+	for (int i = 0; i < cases.rows; i++) {
+		int frames = cases.at<int>(i, 0);
+		int width = cases.at<int>(i, 1);
+		int height = cases.at<int>(i, 2);
+		int inputFrames = cases.at<int>(i, 3);
+		int bpp = cases.at<int>(i, 4);
+		std::cout << "TemporalWindow " << frames << " frames of " << width << "x" << height
+			<< " " << bpp << "-bit: ";
+
+		std::vector<cv::Mat> input;
+		for (int j = 0; j < inputFrames; j++) {
+			input.push_back(makeRandomImage(width, height, bpp, j + 1));
+		}
+
+		Speckle::TemporalWindow temporalWindow(frames, width, height);
+		std::vector<double> row(width);
+		for (int j = 0; j < inputFrames; j++) {
+			temporalWindow.startFrame();
+			int n = std::min(j + 1, frames);
+			assertEquals(temporalWindow.getFrameCount(), n, "frame count");
+			for (int y = 0; y < height; y++) {
+				temporalWindow.computeRow(y, input[j].ptr<uint16_t>(y), &row[0]);
+				for (int x = 0; x < width; x++) {
+					// Direct calculation of the sample variance over mean²
+					double mean = 0;
+					for (int k = j - n + 1; k <= j; k++) {
+						mean += input[k].at<uint16_t>(y, x);
+					}
+					mean /= n;
+					double variance = 0;
+					for (int k = j - n + 1; k <= j; k++) {
+						double d = input[k].at<uint16_t>(y, x) - mean;
+						variance += d * d;
+					}
+					double expected = (n < 2 || mean == 0) ? 0 : variance / (n - 1) / mean / mean;
+					assertApproxEquals(row[x], expected);
+				}
+			}
+		}
+		std::cout << "OK\n";
+	}
+	return true;
+}
+
+bool testSpatioTemporalWindow(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	cv::Mat cases = readMatrix<int>(f, CV_32SC1);
+	for (int i = 0; i < cases.rows; i++) {
+		int window = cases.at<int>(i, 0);
+		int frames = cases.at<int>(i, 1);
+		int width = cases.at<int>(i, 2);
+		int height = cases.at<int>(i, 3);
+		int inputFrames = cases.at<int>(i, 4);
+		int bpp = cases.at<int>(i, 5);
+		std::cout << "SpatioTemporalWindow w" << window << " " << frames << " frames of "
+			<< width << "x" << height << " " << bpp << "-bit: ";
+
+		std::vector<cv::Mat> input;
+		for (int j = 0; j < inputFrames; j++) {
+			input.push_back(makeRandomImage(width, height, bpp, j + 1));
+		}
+
+		Speckle::TemporalWindow temporalWindow(frames, width, height);
+		Speckle::SpatioTemporalWindow window3d(window, frames, width);
+		assertEquals(window3d.getOutputWidth(), width - window + 1, "output width");
+		std::vector<double> row(window3d.getOutputWidth());
+		for (int j = 0; j < inputFrames; j++) {
+			temporalWindow.startFrame();
+			int n = temporalWindow.getFrameCount();
+			window3d.startFrame(n);
+			for (int y = 0; y < height; y++) {
+				temporalWindow.addRow(y, input[j].ptr<uint16_t>(y));
+				int outY = window3d.computeRow(temporalWindow.getSumRow(y),
+					temporalWindow.getSumSqRow(y), &row[0]);
+				if (y < window - 1) {
+					assertEquals(outY, -1, "outY");
+					continue;
+				}
+				assertEquals(outY, y - window / 2, "outY");
+				for (int x = 0; x < window3d.getOutputWidth(); x++) {
+					// Direct calculation of the sample variance over mean²
+					// of the samples in the volume
+					std::vector<double> samples;
+					for (int k = j - n + 1; k <= j; k++) {
+						for (int wy = y - window + 1; wy <= y; wy++) {
+							for (int wx = x; wx < x + window; wx++) {
+								samples.push_back(input[k].at<uint16_t>(wy, wx));
+							}
+						}
+					}
+					double mean = 0;
+					for (size_t k = 0; k < samples.size(); k++) {
+						mean += samples[k];
+					}
+					mean /= samples.size();
+					double variance = 0;
+					for (size_t k = 0; k < samples.size(); k++) {
+						variance += (samples[k] - mean) * (samples[k] - mean);
+					}
+					double expected = mean == 0 ? 0
+						: variance / (samples.size() - 1) / mean / mean;
+					assertApproxEquals(row[x], expected);
+				}
+			}
+		}
+		std::cout << "OK\n";
+	}
+	return true;
+}
+
+bool testRollingAverage(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	cv::Mat cases = readMatrix<double>(f, CV_64FC1);
+	for (int i = 0; i < cases.rows; i++) {
+		bool boxcar = cases.at<double>(i, 0) != 0;
+		int frames = (int)cases.at<double>(i, 1);
+		int width = (int)cases.at<double>(i, 2);
+		int height = (int)cases.at<double>(i, 3);
+		int inputFrames = (int)cases.at<double>(i, 4);
+		bool inverse = cases.at<double>(i, 5) != 0;
+		double threshold = cases.at<double>(i, 6);
+		int changeFrame = (int)cases.at<double>(i, 7);
+		int zeroFrames = (int)cases.at<double>(i, 8);
+		std::cout << "RollingAverage " << (boxcar ? "boxcar " : "exponential ")
+			<< frames << " frames of " << width << "x" << height
+			<< (inverse ? " inverse" : "") << " threshold " << threshold
+			<< (zeroFrames ? ", " + std::to_string(zeroFrames) + " zero-mean frames" : "")
+			<< ": ";
+
+		// Every 7th frame is a spike, and from changeFrame onwards, the
+		// level changes. The first pixel is always infinite. The first
+		// zeroFrames frames are given a mean of zero.
+		std::vector<cv::Mat> input;
+		std::vector<double> means;
+		for (int j = 0; j < inputFrames; j++) {
+			double scale = (j % 7 == 5 || (changeFrame >= 0 && j >= changeFrame)) ? 10 : 1;
+			cv::Mat samples = makeRandomImage(width, height, 10, j + 1);
+			cv::Mat frame(height, width, CV_64FC1);
+			for (int y = 0; y < height; y++) {
+				for (int x = 0; x < width; x++) {
+					frame.at<double>(y, x) = scale * (1 + samples.at<uint16_t>(y, x));
+				}
+			}
+			frame.at<double>(0, 0) = INFINITY;
+			input.push_back(frame);
+			means.push_back(j < zeroFrames ? 0 : scale * 512);
+		}
+
+		// The accepted frames since the last restart
+		std::vector<int> run;
+		int rejected = 0;
+
+		Speckle::RollingAverage average(
+			boxcar ? Speckle::RollingAverage::BOXCAR : Speckle::RollingAverage::EXPONENTIAL,
+			frames, width, height, inverse, threshold);
+		const double alpha = 2.0 / (frames + 1);
+		std::vector<double> row(width);
+		for (int j = 0; j < inputFrames; j++) {
+			bool accept = true;
+			if (!run.empty() && threshold > 0 && rejected < frames) {
+				double reference = 0;
+				size_t start = boxcar && run.size() > (size_t)frames ? run.size() - frames : 0;
+				for (size_t k = start; k < run.size(); k++) {
+					if (boxcar) {
+						reference += means[run[k]] / (run.size() - start);
+					} else {
+						reference = k == 0 ? means[run[k]]
+							: reference + alpha * (means[run[k]] - reference);
+					}
+				}
+				accept = std::fabs(means[j] - reference) <= threshold * reference;
+				if (reference <= 0 && means[j] != reference) {
+					// Restart rather than reject relative to zero
+					run.clear();
+					accept = true;
+				}
+			}
+			if (accept) {
+				if (rejected >= frames) {
+					run.clear();
+				}
+				rejected = 0;
+				run.push_back(j);
+			} else {
+				rejected++;
+			}
+			assertEquals(average.startFrame(means[j]), accept, "accepted");
+
+			size_t start = boxcar && run.size() > (size_t)frames ? run.size() - frames : 0;
+			for (int y = 0; y < height; y++) {
+				average.computeRow(y, input[j].ptr<double>(y), &row[0]);
+				for (int x = 0; x < width; x++) {
+					double expected = 0;
+					for (size_t k = start; k < run.size(); k++) {
+						double value = input[run[k]].at<double>(y, x);
+						value = inverse ? 1 / value : std::min(value, 1e9);
+						if (boxcar) {
+							expected += value / (run.size() - start);
+						} else {
+							expected = k == 0 ? value : expected + alpha * (value - expected);
+						}
+					}
+					if (inverse) {
+						expected = 1 / expected;
+					}
+					assertApproxEquals(row[x], expected, 1e-6);
+				}
+			}
+		}
+		std::cout << "OK\n";
+	}
+	return true;
+}
+
+bool testColourLookup(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	cv::Mat cases = readMatrix<double>(f, CV_64FC1);
+	for (int i = 0; i < cases.rows; i++) {
+		int tableSize = (int)cases.at<double>(i, 0);
+		double beta = cases.at<double>(i, 1);
+		double minX = cases.at<double>(i, 2);
+		std::cout << "ColourLookup table size " << tableSize << " beta " << beta
+			<< " scale " << minX << ": ";
+
+		Speckle::CorrelationTime correlationTime(tableSize, beta);
+		Speckle::Visualize visualize(minX);
+		Speckle::ColourLookup lookup(correlationTime, visualize);
+
+		// A dense sweep of K² up to beyond beta, followed by random values
+		std::vector<double> kSq;
+		const int steps = 200000;
+		for (int j = 0; j <= steps; j++) {
+			kSq.push_back(j * 1.3 * beta / steps);
+		}
+		cv::Mat samples = makeRandomImage(steps, 1, 16, 1);
+		for (int j = 0; j < steps; j++) {
+			kSq.push_back(samples.at<uint16_t>(0, j) / 65536.0 * 1.3 * beta);
+		}
+
+		std::vector<cv::Vec3b> colours3(kSq.size());
+		std::vector<cv::Vec4b> colours4(kSq.size());
+		lookup.computeRow(&kSq[0], &colours3[0], kSq.size());
+		lookup.computeRow(&kSq[0], &colours4[0], kSq.size());
+
+		// The reference is the pipeline's path without the lookup
+		std::vector<double> x(kSq.size());
+		std::vector<cv::Vec3b> expectedColours(kSq.size());
+		correlationTime.computeRow(&kSq[0], &x[0], kSq.size());
+		visualize.computeRow(&x[0], &expectedColours[0], kSq.size());
+		for (size_t j = 0; j < kSq.size(); j++) {
+			const cv::Vec3b & expected = expectedColours[j];
+			if (colours3[j] != expected
+				|| colours4[j] != cv::Vec4b(expected[0], expected[1], expected[2], 0xff))
+			{
+				throw TestError("Colour lookup differs at K^2 = " + std::to_string(kSq[j]));
+			}
+		}
+		std::cout << "OK\n";
+	}
+	return true;
+}
+
+bool testRawCapture(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	const char * fileName = "RawCapture-test.raw";
+	cv::Mat cases = readMatrix<int>(f, CV_32SC1);
+	for (int i = 0; i < cases.rows; i++) {
+		Speckle::RawCaptureFormat format;
+		format.width = cases.at<int>(i, 0);
+		format.height = cases.at<int>(i, 1);
+		format.samplesPerPixel = cases.at<int>(i, 2);
+		format.bitsPerSample = cases.at<int>(i, 3);
+		format.bayer = cases.at<int>(i, 4) != 0;
+		int numFrames = cases.at<int>(i, 5);
+		const bool corrupt = cases.at<int>(i, 6) != 0;
+		std::cout << "RawCapture " << format.width << "x" << format.height
+			<< "x" << format.samplesPerPixel << " " << format.bitsPerSample << "-bit"
+			<< (format.bayer ? " bayer" : "") << ", " << numFrames << " frames"
+			<< (corrupt ? ", corrupt frame count" : "") << ": ";
+
+		std::vector<std::vector<uint8_t>> frames;
+		{
+			Speckle::RawCaptureWriter writer(fileName, format);
+			for (int j = 0; j < numFrames; j++) {
+				frames.push_back(makeRandomFrame(format.getFrameSize(), j + 1));
+				writer.writeFrame(&frames[j][0], frames[j].size(), 1000 + 33 * j);
+			}
+			assertEquals(writer.getFrameCount(), (size_t)numFrames, "writer frame count");
+			writer.close();
+		}
+
+		if (corrupt) {
+			// Make the index size wrap around to its true size, so that
+			// only a check of the frame count itself finds the problem.
+			// The frame count is at offset 56 in the header.
+			const uint64_t frameCount = ((uint64_t)1 << 60) + numFrames;
+			std::FILE * file = std::fopen(fileName, "r+b");
+			bool written = file && !std::fseek(file, 56, SEEK_SET)
+				&& std::fwrite(&frameCount, sizeof(frameCount), 1, file) == 1;
+			if (file && std::fclose(file)) {
+				written = false;
+			}
+			if (!written) {
+				throw TestError("Unable to corrupt the raw capture file");
+			}
+			bool thrown = false;
+			try {
+				Speckle::RawCaptureReader reader(fileName);
+			} catch (std::runtime_error & e) {
+				thrown = true;
+			}
+			assertEquals(thrown, true, "corrupt frame count is rejected");
+			std::cout << "OK\n";
+			continue;
+		}
+
+		assertEquals(Speckle::RawCaptureReader::isRawCapture(fileName), true, "magic");
+		Speckle::RawCaptureReader reader(fileName);
+		const Speckle::RawCaptureFormat & actual = reader.getFormat();
+		assertEquals(actual.width, format.width, "width");
+		assertEquals(actual.height, format.height, "height");
+		assertEquals(actual.samplesPerPixel, format.samplesPerPixel, "samples per pixel");
+		assertEquals(actual.bitsPerSample, format.bitsPerSample, "bits per sample");
+		assertEquals(actual.bayer, format.bayer, "bayer");
+		assertEquals(reader.hasIndex(), true, "has index");
+		assertEquals(reader.getFrameCount(), (size_t)numFrames, "reader frame count");
+
+		// Seek backwards, to check that frames are found by the index
+		for (int j = numFrames - 1; j >= 0; j--) {
+			const uint8_t * data = reader.getFrame(j);
+			assertEquals((uintptr_t)data % 4096, (uintptr_t)0, "frame alignment");
+			if (std::memcmp(data, &frames[j][0], frames[j].size())) {
+				throw TestError("Frame " + std::to_string(j) + " differs");
+			}
+			assertEquals(reader.getTimestamp(j), (uint64_t)(1000 + 33 * j), "timestamp");
+		}
+		std::cout << "OK\n";
+	}
+	std::remove(fileName);
+	return true;
+}
+
+/**
+ * Run frames from a source through the frame pipeline, blocking the source
+ * whenever the pipeline is full. Return the frames and timestamps which were
+ * delivered, and the time taken in seconds.
+ */
+double runFrameSource(Speckle::FrameSource & source,
+	std::vector<std::vector<uint8_t>> & frames,
+	std::vector<uint64_t> & timestamps)
+{
+	Speckle::RawCaptureFormat format = source.getFormat();
+	Speckle::ComputePipeline::Options options;
+	options.width = format.width;
+	options.height = format.height;
+	options.bitsPerPixel = format.bitsPerSample;
+	options.frameSize = format.getFrameSize();
+	options.displayOnly = true;
+	Speckle::FramePipeline pipeline(options, CV_8UC4);
+
+	size_t popped = 0;
+	cv::Mat output;
+	auto start = std::chrono::steady_clock::now();
+	source.run([&](const void * data, uint64_t timestamp) {
+		const uint8_t * bytes = (const uint8_t*)data;
+		frames.emplace_back(bytes, bytes + format.getFrameSize());
+		timestamps.push_back(timestamp);
+		while (!pipeline.push(data, format.getFrameSize())) {
+			if (pipeline.pop(output)) {
+				popped++;
+			}
+		}
+	});
+	while (popped < frames.size()) {
+		if (pipeline.pop(output)) {
+			popped++;
+		}
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	assertEquals(output.cols, format.width, "output width");
+	return elapsed.count();
+}
+
+bool testFrameSource(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	const char * fileName = "FrameSource-test.raw";
+	cv::Mat cases = readMatrix<int>(f, CV_32SC1);
+	for (int i = 0; i < cases.rows; i++) {
+		Speckle::SyntheticSource::Options options;
+		options.format.width = cases.at<int>(i, 0);
+		options.format.height = cases.at<int>(i, 1);
+		options.format.bitsPerSample = cases.at<int>(i, 2);
+		options.frames = cases.at<int>(i, 3);
+		options.frameRate = cases.at<int>(i, 4);
+		std::cout << "FrameSource " << options.format.width << "x" << options.format.height
+			<< " " << options.format.bitsPerSample << "-bit, " << options.frames << " frames";
+		if (options.frameRate) {
+			std::cout << " at " << options.frameRate << " fps";
+		}
+		std::cout << ": ";
+
+		// Synthetic frames through the pipeline, headless
+		Speckle::SyntheticSource synthetic(options);
+		std::vector<std::vector<uint8_t>> frames;
+		std::vector<uint64_t> timestamps;
+		double elapsed = runFrameSource(synthetic, frames, timestamps);
+		assertEquals(frames.size(), (size_t)options.frames, "synthetic frame count");
+		if (options.frameRate) {
+			assertEquals(elapsed >= (options.frames - 1) / options.frameRate, true,
+				"synthetic frame rate");
+		}
+		std::cout << options.frames / elapsed << " fps, ";
+
+		// Replay of a recording of them must give the same frames
+		{
+			Speckle::RawCaptureWriter writer(fileName, options.format);
+			for (size_t j = 0; j < frames.size(); j++) {
+				writer.writeFrame(&frames[j][0], frames[j].size(), timestamps[j]);
+			}
+			writer.close();
+		}
+		Speckle::ReplaySource::Options replayOptions;
+		replayOptions.realTime = options.frameRate != 0;
+		Speckle::ReplaySource replay(fileName, replayOptions);
+		std::vector<std::vector<uint8_t>> replayed;
+		std::vector<uint64_t> replayedTimestamps;
+		elapsed = runFrameSource(replay, replayed, replayedTimestamps);
+		assertEquals(replayed.size(), frames.size(), "replayed frame count");
+		for (size_t j = 0; j < frames.size(); j++) {
+			if (replayed[j] != frames[j]) {
+				throw TestError("Replayed frame " + std::to_string(j) + " differs");
+			}
+			assertEquals(replayedTimestamps[j], timestamps[j], "replayed timestamp");
+		}
+		if (options.frameRate) {
+			assertEquals(elapsed >= (options.frames - 1) / options.frameRate, true,
+				"replay frame rate");
+		}
+		std::cout << "replay " << options.frames / elapsed << " fps, OK\n";
+	}
+	std::remove(fileName);
+	return true;
+}
+
+bool testSpeckleGenerator(std::ifstream & f) {
+	// Header line
+	std::string line;
+	std::getline(f, line);
+
+	cv::Mat cases = readMatrix<double>(f, CV_64FC1);
+	for (int i = 0; i < cases.rows; i++) {
+		Speckle::SpeckleGenerator::Options options;
+		options.width = cases.at<double>(i, 0);
+		options.height = cases.at<double>(i, 1);
+		options.bitsPerSample = cases.at<double>(i, 2);
+		options.depth = cases.at<double>(i, 3);
+		options.speckleSize = cases.at<double>(i, 4);
+		const double x = cases.at<double>(i, 5);
+		options.correlationTime = 0.001;
+		options.exposure = x * options.correlationTime;
+		const int mode = cases.at<double>(i, 6);
+		const int numFrames = cases.at<double>(i, 7);
+		const double tolerance = cases.at<double>(i, 8);
+		std::cout << "SpeckleGenerator " << options.width << "x" << options.height
+			<< " " << options.bitsPerSample << "-bit speckle " << options.speckleSize
+			<< " x=" << x
+			<< (mode == Speckle::ComputePipeline::TEMPORAL_CONTRAST ? " temporal" : "")
+			<< ": ";
+
+		Speckle::SpeckleGenerator generator(options);
+		const Speckle::RawCaptureFormat format = generator.getFormat();
+		std::vector<uint8_t> frame(format.getFrameSize());
+
+		// The same samples, unpacked, as a reference for the packing
+		Speckle::SpeckleGenerator::Options referenceOptions = options;
+		referenceOptions.bitsPerSample = 16;
+		referenceOptions.depth = options.depth ? options.depth : options.bitsPerSample;
+		Speckle::SpeckleGenerator reference(referenceOptions);
+		std::vector<uint16_t> samples((size_t)options.width * options.height);
+
+		Speckle::ComputePipeline::Options pipelineOptions;
+		pipelineOptions.width = format.width;
+		pipelineOptions.height = format.height;
+		pipelineOptions.bitsPerPixel = format.bitsPerSample;
+		pipelineOptions.frameSize = format.getFrameSize();
+		pipelineOptions.contrastMode = (Speckle::ComputePipeline::ContrastMode)mode;
+		Speckle::ComputePipeline pipeline(pipelineOptions);
+
+		double elapsed = 0;
+		double sum = 0, sumSq = 0;
+		double kSqSum = 0;
+		size_t kSqCount = 0;
+		cv::Mat unpacked, kSq;
+		for (int j = 0; j < numFrames; j++) {
+			auto start = std::chrono::steady_clock::now();
+			generator.generate(&frame[0]);
+			elapsed += std::chrono::duration<double>(
+				std::chrono::steady_clock::now() - start).count();
+
+			reference.generate(&samples[0]);
+			pipeline.unpackFrame(&frame[0], frame.size(), unpacked);
+			for (int y = 0; y < options.height; y++) {
+				const uint16_t * row = unpacked.ptr<uint16_t>(y);
+				if (std::memcmp(row, &samples[(size_t)y * options.width],
+					options.width * sizeof(uint16_t)))
+				{
+					throw TestError("Failed assertion: \"packed samples\": row "
+						+ std::to_string(y) + " differs");
+				}
+				for (int x = 0; x < options.width; x++) {
+					sum += row[x];
+					sumSq += (double)row[x] * row[x];
+				}
+			}
+
+			// In temporal mode, only the last frame has a full window
+			pipeline.contrastFrame(unpacked, kSq);
+			if (mode == Speckle::ComputePipeline::SPATIAL_CONTRAST || j == numFrames - 1) {
+				for (int y = 0; y < kSq.rows; y++) {
+					for (int x = 0; x < kSq.cols; x++) {
+						kSqSum += kSq.at<double>(y, x);
+					}
+				}
+				kSqCount += kSq.total();
+			}
+		}
+
+		// The generated intensity must have the K² of the model
+		const double n = (double)numFrames * options.width * options.height;
+		const double mean = sum / n;
+		assertApproxEquals((sumSq / n - mean * mean) / (mean * mean),
+			Speckle::getKSquared(x), 0.02);
+
+		// The pipeline's K² estimates are slightly biased by the small
+		// number of samples in each window, hence the tolerance
+		Speckle::CorrelationTime correlationTime(pipelineOptions.correlationTableSize, 1.0);
+		Speckle::ComputePos pos;
+		const double result = correlationTime.compute(pos, kSqSum / kSqCount);
+		assertApproxEquals(result, x, tolerance);
+		std::cout << "x=" << result << ", " << numFrames / elapsed << " fps, OK\n";
+	}
 	return true;
 }
 
@@ -203,8 +1548,34 @@ int main(int argc, char **argv) {
 	try {
 		if (!std::strcmp(cmd, "SpatialWindow")) {
 			success = testSpatialWindow(file);
+		} else if (!std::strcmp(cmd, "SpatialWindowOverflow")) {
+			success = testSpatialWindowOverflow(file);
+		} else if (!std::strcmp(cmd, "RawOutput")) {
+			success = testRawOutput(file);
+		} else if (!std::strcmp(cmd, "IntegralImage")) {
+			success = testIntegralImage(file);
 		} else if (!std::strcmp(cmd, "CorrelationTime")) {
 			success = testCorrelationTime(file); 
+		} else if (!std::strcmp(cmd, "Unpack")) {
+			success = testUnpack(file);
+		} else if (!std::strcmp(cmd, "TemporalWindow")) {
+			success = testTemporalWindow(file);
+		} else if (!std::strcmp(cmd, "SpatioTemporalWindow")) {
+			success = testSpatioTemporalWindow(file);
+		} else if (!std::strcmp(cmd, "RollingAverage")) {
+			success = testRollingAverage(file);
+		} else if (!std::strcmp(cmd, "ColourLookup")) {
+			success = testColourLookup(file);
+		} else if (!std::strcmp(cmd, "ComputePipeline")) {
+			success = testComputePipeline(file);
+		} else if (!std::strcmp(cmd, "WindowSweep")) {
+			success = testWindowSweep(file);
+		} else if (!std::strcmp(cmd, "RawCapture")) {
+			success = testRawCapture(file);
+		} else if (!std::strcmp(cmd, "FrameSource")) {
+			success = testFrameSource(file);
+		} else if (!std::strcmp(cmd, "SpeckleGenerator")) {
+			success = testSpeckleGenerator(file);
 		} else {
 			std::cout << "Unrecognised command\n";
 			success = false;